@@ -34,5 +34,12 @@ namespace events {
         DECLARE_EVENT(SceneActivated, "scene/activated") {
             entt::hashed_string::hash_type id;
         };
+
+        // Emitted each frame that a batch of a loading scene's entities is created. Counts entities, prototypes included.
+        DECLARE_EVENT(SceneLoadProgress, "scene/load-progress") {
+            entt::hashed_string::hash_type id;
+            std::uint32_t loaded;
+            std::uint32_t total;
+        };
     }
 }
@@ -7,6 +7,8 @@
 #include "game_systems.hpp"
 
 #include <spdlog/spdlog.h>
+#include <string_view>
+#include <type_traits>
 
 namespace components::core {
     struct Named;
@@ -27,6 +29,99 @@ namespace million {
 
     using GameHandler = void (*)(const million::events::EventIterable events, million::events::Stream& stream, million::events::Publisher& publisher);
     using SceneHandler = void (*)(const million::events::EventIterable events, million::events::Stream& stream, million::events::Publisher& publisher);
+
+    /// An entity that an EntityCommands will create, which that same EntityCommands can use as the target of later commands
+    struct DeferredEntity {
+        std::uint32_t index;
+    };
+
+    /// Entity changes recorded by systems and applied after the update systems have run, so that systems running in parallel can create and
+    /// destroy entities and add or remove components. Each thread has its own EntityCommands, which must not be passed to another thread.
+    /// Commands are applied in a deterministic order: spawns, then component changes one component type at a time, then destroys. Within each,
+    /// commands from systems are applied in the order the systems are scheduled in, and in the order each system recorded them.
+    /// Commands targeting entities that no longer exist are skipped. Recorded components are copied bytewise, so must be trivially copyable.
+    class EntityCommands
+    {
+    public:
+        /// An existing entity or a DeferredEntity
+        struct Target {
+            static constexpr std::uint32_t NotDeferred = ~std::uint32_t(0);
+            Target (entt::entity entity) : entity(entity), deferred(NotDeferred) {}
+            Target (DeferredEntity entity) : entity{}, deferred(entity.index) {}
+            entt::entity entity;
+            std::uint32_t deferred;
+        };
+
+        /// Applies one kind of command for one component type to a batch of entities. values is null for removals.
+        using ApplyFn = void (*)(entt::registry& registry, const entt::entity* entities, const void* const* values, std::uint32_t count);
+
+        virtual ~EntityCommands () {}
+
+        /** Create an entity from a prototype */
+        virtual DeferredEntity spawn (entt::hashed_string prototype) = 0;
+
+        /** Destroy an entity */
+        virtual void destroy (Target target) = 0;
+
+        /** Add a component to an entity, replacing it if the entity already has it */
+        template <typename Component>
+        void set (Target target, const Component& value = {})
+        {
+            static_assert(std::is_trivially_copyable_v<Component>, "EntityCommands can only record trivially copyable components");
+            record(target, entt::type_hash<Component>::value(), &applySet<Component>, &value, sizeof(Component), alignof(Component));
+        }
+
+        /** Add a component to an entity, unless the entity already has it */
+        template <typename Component>
+        void add (Target target, const Component& value = {})
+        {
+            static_assert(std::is_trivially_copyable_v<Component>, "EntityCommands can only record trivially copyable components");
+            record(target, entt::type_hash<Component>::value(), &applyAdd<Component>, &value, sizeof(Component), alignof(Component));
+        }
+
+        /** Remove a component from an entity */
+        template <typename Component>
+        void remove (Target target)
+        {
+            record(target, entt::type_hash<Component>::value(), &applyRemove<Component>, nullptr, 0, 1);
+        }
+
+    protected:
+        virtual void record (Target target, entt::id_type component, ApplyFn apply, const void* value, std::size_t size, std::size_t alignment) = 0;
+
+    private:
+        // Commands are applied through the component's storage, so that its construct, update and destroy signals are sent
+        template <typename Component>
+        static void applySet (entt::registry& registry, const entt::entity* entities, const void* const* values, std::uint32_t count)
+        {
+            auto& storage = registry.template storage<Component>();
+            for (std::uint32_t index = 0; index < count; ++index) {
+                const auto& value = *static_cast<const Component*>(values[index]);
+                if (! storage.contains(entities[index])) {
+                    storage.emplace(entities[index], value);
+                } else if constexpr (! std::is_empty_v<Component>) {
+                    storage.patch(entities[index], [&value](Component& component){ component = value; });
+                }
+            }
+        }
+
+        template <typename Component>
+        static void applyAdd (entt::registry& registry, const entt::entity* entities, const void* const* values, std::uint32_t count)
+        {
+            auto& storage = registry.template storage<Component>();
+            for (std::uint32_t index = 0; index < count; ++index) {
+                if (! storage.contains(entities[index])) {
+                    storage.emplace(entities[index], *static_cast<const Component*>(values[index]));
+                }
+            }
+        }
+
+        template <typename Component>
+        static void applyRemove (entt::registry& registry, const entt::entity* entities, const void* const*, std::uint32_t count)
+        {
+            registry.template storage<Component>().remove(entities, entities + count);
+        }
+    };
 }
 
 // The engine-provided API to modules
@@ -117,6 +212,9 @@ namespace million::api {
 
         virtual void registerResourceLoader (million::api::resources::Loader* loader) = 0;
 
+        /** Declare a message type as coalescing (last-writer-wins), only the last one posted to each target is delivered. For idempotent state updates. */
+        virtual void registerCoalescingMessage (entt::hashed_string message_type) = 0;
+
         virtual void readBinaryFile (const std::string& filename, std::string& buffer) const = 0;
 
         // Retrieve a resource handle by name
@@ -150,20 +248,50 @@ namespace million::api {
         /** Find a named entity. Returns entt::null if no such entity exists */
         virtual entt::entity findEntity (entt::hashed_string) const = 0;
 
-        /** Get the string name of a named entity */
-        virtual const std::string& findEntityName (const components::core::Named& named) const = 0;
-        virtual const std::string& findEntityName (entt::entity entity) const = 0;
+        /** Get the string name of a named entity, empty if it has none. The name remains valid until the entity's scene is unloaded */
+        virtual std::string_view findEntityName (const components::core::Named& named) const = 0;
+        virtual std::string_view findEntityName (entt::entity entity) const = 0;
+
+        /** Find the entities with a Position within `radius` of `center`, replacing the contents of `entities`. Spatial queries see
+            positions as of the end of the previous frame, and only see Position changes made through patch, replace or emplace */
+        virtual void entitiesInRadius (const glm::vec3& center, float radius, std::vector<entt::entity>& entities) const = 0;
+        /** Find the entities with a Position inside the box between `min` and `max`, replacing the contents of `entities` */
+        virtual void entitiesInBox (const glm::vec3& min, const glm::vec3& max, std::vector<entt::entity>& entities) const = 0;
+        /** Find the (up to) `count` entities with a Position closest to `point`, closest first, replacing the contents of `entities` */
+        virtual void nearestEntities (const glm::vec3& point, std::uint32_t count, std::vector<entt::entity>& entities) const = 0;
 
-        /** Load an entity into specified registry from a prototype */
+        /** Load an entity into specified registry from a prototype. Systems should use commands() instead */
         // NOT Thread Safe!
-        // TODO: make thread safe by making asynchronous and dispatching event when done.
         virtual entt::entity loadEntity (entt::hashed_string) = 0;
 
+        /** Create many entities from a prototype at once, much faster than calling loadEntity for each. If `entities` is not null, it
+            must have room for `count` entities and receives the new entities. Returns the number of entities created */
+        // NOT Thread Safe!
+        virtual std::uint32_t spawnMany (entt::hashed_string prototype, std::uint32_t count, entt::entity* entities = nullptr) = 0;
+
+        /** Serialize the current scene's entities and components (quick-save, resetting a scene, rollback). Snapshots are only valid in
+            the process that took them. A delta snapshot only holds the changes since the previous snapshot taken or restored */
+        // NOT Thread Safe!
+        virtual std::vector<std::byte> snapshot (bool delta = false) = 0;
+
+        /** Restore a snapshot into the current scene. A delta can only be restored on top of the state its base snapshot was taken or
+            restored from. Returns false if the snapshot could not be restored */
+        // NOT Thread Safe!
+        virtual bool restore (const std::vector<std::byte>& snapshot) = 0;
+
         /** Merge a prototype into an entity in the specified registry which */
         // NOT Thread Safe!
         // TODO: make thread safe by making asynchronous and dispatching event when done.
         virtual void mergeEntity (entt::entity, entt::hashed_string, bool) = 0;
 
+        /** Add an entity to (or remove it from) a named entity set, which can be used as a message target */
+        // NOT Thread Safe!
+        virtual void setInEntitySet (entt::hashed_string, entt::entity, bool) = 0;
+
+        /** Define a composite message target from two groups, entity sets or composites. Returns the id to post messages to, or uint32_t(-1) if an operand is invalid */
+        // NOT Thread Safe!
+        virtual std::uint32_t defineComposite (million::events::CompositeOp, million::events::Target, million::events::Target) = 0;
+
         // Retrieve a resource handle by name
         virtual million::resources::Handle findResource (entt::hashed_string::hash_type) const = 0;
 
@@ -184,6 +312,13 @@ namespace million::api {
         /** Retrieve events from a named event stream  */
         virtual const million::events::EventIterable events (entt::hashed_string) const = 0;
 
+        /** Get the calling thread's scratch memory arena, which is reset at the start of every frame */
+        virtual million::memory::FrameArena& frameArena() = 0;
+
+        /** Get the calling thread's entity command buffer, through which systems and event handlers can create and destroy entities and add or remove components.
+         *  Commands are only accepted from the thread running the system or handler, not from worker tasks that it spawns */
+        virtual million::EntityCommands& commands() = 0;
+
         /** Retrieve the payload from an individual event */
         template <typename EventT, typename Envelope>
         static const EventT& eventData (const Envelope& envelope) {
@@ -210,16 +345,34 @@ namespace million::api {
         }
 
         /** Get the string name of a named entity */
-        const std::string& findEntityName (const components::core::Named& named) const
+        std::string_view findEntityName (const components::core::Named& named) const
         {
             return m_runtime->findEntityName(named);
         }
 
-        const std::string& findEntityName (entt::entity entity) const
+        std::string_view findEntityName (entt::entity entity) const
         {
             return m_runtime->findEntityName(entity);
         }
 
+        /** Find the entities with a Position within `radius` of `center`, as of the end of the previous frame */
+        void entitiesInRadius (const glm::vec3& center, float radius, std::vector<entt::entity>& entities) const
+        {
+            m_runtime->entitiesInRadius(center, radius, entities);
+        }
+
+        /** Find the entities with a Position inside the box between `min` and `max`, as of the end of the previous frame */
+        void entitiesInBox (const glm::vec3& min, const glm::vec3& max, std::vector<entt::entity>& entities) const
+        {
+            m_runtime->entitiesInBox(min, max, entities);
+        }
+
+        /** Find the (up to) `count` entities with a Position closest to `point`, closest first, as of the end of the previous frame */
+        void nearestEntities (const glm::vec3& point, std::uint32_t count, std::vector<entt::entity>& entities) const
+        {
+            m_runtime->nearestEntities(point, count, entities);
+        }
+
         // Retrieve a resource handle by name
         million::resources::Handle findResource (entt::hashed_string::hash_type name) const
         {
@@ -244,6 +397,25 @@ namespace million::api {
             return m_runtime->events(stream_name);
         }
 
+        /** Get the calling thread's scratch memory arena, which is reset at the start of every frame. Must not be passed to another thread */
+        million::memory::FrameArena& frameArena() const
+        {
+            return m_runtime->frameArena();
+        }
+
+        /** Get the calling thread's entity command buffer, applied after the update systems have run. Must not be passed to another thread */
+        million::EntityCommands& commands() const
+        {
+            return m_runtime->commands();
+        }
+
+        /** Get an STL allocator that allocates from the calling thread's frame arena, for containers that only live for the current frame */
+        template <typename T>
+        million::memory::FrameAllocator<T> frameAllocator() const
+        {
+            return million::memory::FrameAllocator<T>(m_runtime->frameArena());
+        }
+
         /** Retrieve the payload from an individual event */
         template <typename EventT, typename Envelope>
         const EventT& eventData (const Envelope& envelope) const {
@@ -4,6 +4,10 @@
 #include <entt/core/hashed_string.hpp>
 #include <glm/glm.hpp>
 
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
 using namespace entt::literals;
 
 namespace timing {
@@ -67,6 +71,27 @@ namespace million {
     }
 
     namespace events {
+        // The kind of audience a message is targetted at (stored in the top two bits of the message metadata)
+        enum class TargetType : std::uint8_t {
+            Entity = 0,
+            Group = 1,
+            EntitySet = 2,
+            Composite = 3,
+        };
+
+        // Set operation used to compute a composite target from two other targets
+        enum class CompositeOp : std::uint8_t {
+            Union = 0,
+            Intersection = 1,
+            Difference = 2,
+        };
+
+        // A group, entity set or composite, used as an operand when defining composite targets
+        struct Target {
+            TargetType type;
+            std::uint32_t id;
+        };
+
         /// Internal type: not expected to be used directly.
         struct EventEnvelope { // Event envelope is not targetted
             entt::hashed_string::hash_type type;
@@ -113,6 +138,37 @@ namespace million {
                 return *(new (push(Message::ID, entt::to_integral(target), 0x600000 | categories, sizeof(Message))) Message{});
             }
             template <typename Message, typename Function> void postFiltered (entt::hashed_string::hash_type target, std::uint16_t categories, Function fn) { fn(post<Message>(target, categories)); }
+            // Post to an entity set, no categories filter
+            template <typename Message> Message& postToSet (entt::hashed_string::hash_type target) {
+                return *(new (push(Message::ID, target, 0x800000, sizeof(Message))) Message{});
+            }
+            template <typename Message, typename Function> void postToSet (entt::hashed_string::hash_type target, Function fn) { fn(postToSet<Message>(target)); }
+            // Post to a composite target (as returned by defineComposite), no categories filter
+            template <typename Message> Message& postToComposite (std::uint32_t target) {
+                return *(new (push(Message::ID, target, 0xc00000, sizeof(Message))) Message{});
+            }
+            template <typename Message, typename Function> void postToComposite (std::uint32_t target, Function fn) { fn(postToComposite<Message>(target)); }
+
+            // Post to an entity, delivered once `frames` frames have passed
+            template <typename Message> Message& postAfter (entt::entity target, std::uint32_t frames) {
+                return *(new (pushDelayed(Message::ID, entt::to_integral(target), 0x000000, sizeof(Message), frames, true)) Message{});
+            }
+            template <typename Message, typename Function> void postAfter (entt::entity target, std::uint32_t frames, Function fn) { fn(postAfter<Message>(target, frames)); }
+            // Post to a group, delivered once `frames` frames have passed
+            template <typename Message> Message& postAfter (entt::hashed_string::hash_type target, std::uint32_t frames) {
+                return *(new (pushDelayed(Message::ID, target, 0x400000, sizeof(Message), frames, true)) Message{});
+            }
+            template <typename Message, typename Function> void postAfter (entt::hashed_string::hash_type target, std::uint32_t frames, Function fn) { fn(postAfter<Message>(target, frames)); }
+            // Post to an entity, delivered on the given frame (or as soon as possible, if that frame has already passed)
+            template <typename Message> Message& postAt (entt::entity target, std::uint64_t frame) {
+                return *(new (pushDelayed(Message::ID, entt::to_integral(target), 0x000000, sizeof(Message), frame, false)) Message{});
+            }
+            template <typename Message, typename Function> void postAt (entt::entity target, std::uint64_t frame, Function fn) { fn(postAt<Message>(target, frame)); }
+            // Post to a group, delivered on the given frame (or as soon as possible, if that frame has already passed)
+            template <typename Message> Message& postAt (entt::hashed_string::hash_type target, std::uint64_t frame) {
+                return *(new (pushDelayed(Message::ID, target, 0x400000, sizeof(Message), frame, false)) Message{});
+            }
+            template <typename Message, typename Function> void postAt (entt::hashed_string::hash_type target, std::uint64_t frame, Function fn) { fn(postAt<Message>(target, frame)); }
 
             // Push a data-less message by name
             void post (entt::entity target, entt::hashed_string::hash_type type_name) {
@@ -120,7 +176,10 @@ namespace million {
             }
 
             // Internal! Even though this is public, it should not be used directly.
-            virtual std::byte* push (entt::hashed_string::hash_type message_type, std::uint32_t target_entity, std::uint32_t flags, std::uint8_t size) = 0;
+            // Payloads larger than 255 bytes are stored out-of-line, in the message blob arena.
+            virtual std::byte* push (entt::hashed_string::hash_type message_type, std::uint32_t target_entity, std::uint32_t flags, std::uint32_t size) = 0;
+            // Internal! Frame is relative to the current frame if `relative` is true, otherwise it is an absolute frame number.
+            virtual std::byte* pushDelayed (entt::hashed_string::hash_type message_type, std::uint32_t target_entity, std::uint32_t flags, std::uint32_t size, std::uint64_t frame, bool relative) = 0;
         };
 
         /// Internal type: not expected to be used directly.
@@ -175,4 +234,57 @@ namespace million {
 
         using EventIterable = Iterable<EventEnvelope>;
     }
+
+    namespace memory {
+
+        /// Scratch memory for the current thread that is released all at once at the start of the next frame.
+        /// Allocation is a pointer bump, individual allocations are never freed. Must not be shared between threads.
+        class FrameArena
+        {
+        public:
+            virtual ~FrameArena () {}
+
+            void* allocate (std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+                const std::uintptr_t ptr = (m_next + alignment - 1) & ~std::uintptr_t(alignment - 1);
+                if (ptr + bytes <= m_end) {
+                    m_next = ptr + bytes;
+                    return reinterpret_cast<void*>(ptr);
+                }
+                return overflow(bytes, alignment);
+            }
+
+            template <typename T, typename... Args> T* emplace (Args&&... args) {
+                return new (allocate(sizeof(T), alignof(T))) T{args...};
+            }
+
+        protected:
+            // Called when the current block is full, must make a new block current and allocate from it
+            virtual void* overflow (std::size_t, std::size_t) = 0;
+            std::uintptr_t m_next = 0;
+            std::uintptr_t m_end = 0;
+        };
+
+        /// STL compatible allocator that allocates from a frame arena, so that containers can be used as transient per-frame scratch space.
+        /// Containers using it must not outlive the frame.
+        template <typename T>
+        class FrameAllocator
+        {
+        public:
+            using value_type = T;
+
+            FrameAllocator (FrameArena& arena) : m_arena(&arena) {}
+            template <typename U> FrameAllocator (const FrameAllocator<U>& other) : m_arena(other.arena()) {}
+
+            T* allocate (std::size_t count) { return reinterpret_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T))); }
+            void deallocate (T*, std::size_t) {}
+
+            FrameArena* arena () const { return m_arena; }
+
+            template <typename U> bool operator== (const FrameAllocator<U>& other) const { return m_arena == other.arena(); }
+            template <typename U> bool operator!= (const FrameAllocator<U>& other) const { return m_arena != other.arena(); }
+
+        private:
+            FrameArena* m_arena;
+        };
+    }
 }
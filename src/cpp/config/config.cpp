@@ -2,10 +2,13 @@
 #include "scripting/scripting.hpp"
 #include "utils/parser.hpp"
 #include <filesystem>
+#include <algorithm>
+#include <cctype>
 
 #include <cxxopts.hpp>
 
 #include "modules/modules.hpp"
+#include "memory/budget.hpp"
 
 helpers::hashed_string_flat_map<std::uint32_t> g_stream_sizes;
 
@@ -40,6 +43,7 @@ bool config::readUserConfig (int argc, char* argv[])
         ("g,gamefiles", "Add override path(s) to game files", cxxopts::value<std::vector<std::string>>())
         ("m,modules", "Modules list file", cxxopts::value<std::string>())
         ("modulepath", "Path to Module files", cxxopts::value<std::string>())
+        ("bake-scenes", "Bake all scenes into the given directory, then exit", cxxopts::value<std::string>())
         ("i,init", "Initialisation file", cxxopts::value<std::string>()->default_value("config.toml"));
     auto cli = options.parse(argc, argv);
 
@@ -57,6 +61,12 @@ bool config::readUserConfig (int argc, char* argv[])
 
          std::filesystem::path base_path = std::filesystem::path{config_file}.parent_path();
 
+         if (cli["bake-scenes"].count() != 0) {
+             entt::monostate<"dev/bake-scenes"_hs>{} = cli["bake-scenes"].as<std::string>();
+         } else {
+             entt::monostate<"dev/bake-scenes"_hs>{} = std::string{};
+         }
+
 #ifdef DEBUG_BUILD
          if (cli["export-tasks"].count() != 0) {
              entt::monostate<"dev/export-task-graph"_hs>{} = cli["export-tasks"].as<std::string>();
@@ -68,6 +78,11 @@ bool config::readUserConfig (int argc, char* argv[])
         //******************************************************//
         // TELEMETRY
         //******************************************************//
+        // Default settings for [telemetry] section
+        entt::monostate<"telemetry/message-stats"_hs>{} = false;
+        entt::monostate<"telemetry/message-stats/report-interval"_hs>{} = std::uint32_t{600};
+        entt::monostate<"telemetry/message-stats/top-count"_hs>{} = std::uint32_t{10};
+
         if (config.contains("telemetry")) {
             const auto& telemetry = config.at("telemetry");
             maybe_set<"telemetry/log-level"_hs, std::string>(telemetry, "logging");
@@ -76,6 +91,12 @@ bool config::readUserConfig (int argc, char* argv[])
                 maybe_set<"telemetry/profiling"_hs, bool>(profiling, "enabled");
                 maybe_set<"telemetry/profiling-dump-file"_hs, std::string>(profiling, "dump-file");
             }
+            if (telemetry.contains("message-stats")) {
+                const auto& message_stats = telemetry.at("message-stats");
+                maybe_set<"telemetry/message-stats"_hs, bool>(message_stats, "enabled");
+                maybe_set<"telemetry/message-stats/report-interval"_hs, std::uint32_t>(message_stats, "report-interval");
+                maybe_set<"telemetry/message-stats/top-count"_hs, std::uint32_t>(message_stats, "top-count");
+            }
         } else {
             entt::monostate<"telemetry/log-level"_hs>{} = "info";
         }
@@ -269,6 +290,9 @@ bool config::readEngineConfig ()
         entt::monostate<"memory/events/pool-size"_hs>{} = std::uint32_t{1024};
         entt::monostate<"memory/events/stream-size"_hs>{} = std::uint32_t{1024};
         entt::monostate<"memory/events/scripts-pool-size"_hs>{} = std::uint32_t{2048};
+        entt::monostate<"memory/events/blob-arena-size"_hs>{} = std::uint32_t{65536};
+        entt::monostate<"memory/events/global-pool-reserve"_hs>{} = std::uint32_t{256 * 1024 * 1024};
+        entt::monostate<"memory/frame-arena-size"_hs>{} = std::uint32_t{262144};
 
         // Overwrite with settings
         if (config.contains("memory")) {
@@ -277,12 +301,31 @@ bool config::readEngineConfig ()
                 maybe_set<"memory/events/pool-size"_hs, std::uint32_t>(memory.at("events"), "per-thread-pool-size");
                 maybe_set<"memory/events/scripts-pool-size"_hs, std::uint32_t>(memory.at("events"), "scripts-pool-size");
                 maybe_set<"memory/events/stream-size"_hs, std::uint32_t>(memory.at("events"), "per-stream-pool-size");
+                maybe_set<"memory/events/blob-arena-size"_hs, std::uint32_t>(memory.at("events"), "message-blob-arena-size");
+                maybe_set<"memory/events/global-pool-reserve"_hs, std::uint32_t>(memory.at("events"), "global-pool-reserve-size");
             }
+            maybe_set<"memory/frame-arena-size"_hs, std::uint32_t>(memory, "per-thread-frame-arena-size");
             if (memory.contains("streams")) {
                 for (const auto& [key, value] : memory.at("streams").as_table()) {
                     g_stream_sizes[entt::hashed_string::value(key.c_str())] = value.as_integer();
                 }
             }
+            if (memory.contains("budget")) {
+                for (const auto& [key, value] : memory.at("budget").as_table()) {
+                    // Subsystems are named in lowercase in the config file
+                    bool found = false;
+                    for (auto subsystem : magic_enum::enum_values<memory::budget::Subsystem>()) {
+                        const auto name = magic_enum::enum_name(subsystem);
+                        if (std::equal(name.begin(), name.end(), key.begin(), key.end(), [](char a, char b){ return std::tolower(a) == std::tolower(b); })) {
+                            memory::budget::setBudget(subsystem, value.as_integer());
+                            found = true;
+                        }
+                    }
+                    if (! found) {
+                        spdlog::warn("Ignoring memory budget for unknown subsystem: {}", key);
+                    }
+                }
+            }
         }
     } catch (const std::exception& e) {
         spdlog::critical("Could not load engine configuration: {}", e.what());
@@ -354,6 +397,10 @@ bool config::readGameConfig (scripting::Context* scripting_ctx, helpers::hashed_
         const auto& scenes = config.at("scenes");
         entt::monostate<"scenes/path"_hs>{} = toml::find<std::string>(scenes, "path");
         entt::monostate<"scenes/initial"_hs>{} = toml::find<std::string>(scenes, "initial");
+        // Number of scene entities and prototypes to create per frame while a scene is loading, 0 for no limit
+        entt::monostate<"scenes/entities-per-frame"_hs>{} = toml::find_or<std::uint32_t>(scenes, "entities-per-frame", 1000);
+        // Size of the spatial index's grid cells, ideally around the radius of typical queries
+        entt::monostate<"scenes/spatial-cell-size"_hs>{} = toml::find_or<float>(scenes, "spatial-cell-size", 16.0f);
 
         //******************************************************//
         // ECS
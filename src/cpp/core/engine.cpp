@@ -2,6 +2,9 @@
 
 #include "utils/timekeeping.hpp"
 #include "config/config.hpp"
+#include "memory/heaps.hpp"
+#include "memory/budget.hpp"
+#include "memory/frame_arena.hpp"
 
 #include "events/events.hpp"
 #include "messages/messages.hpp"
@@ -78,6 +81,8 @@ void Engine::shutdown ()
 {
     EASY_BLOCK("Engine::shutdown", Engine::COLOR(1));
     SPDLOG_DEBUG("[Engine] Shutdown");
+    memory::heaps::report();
+    memory::budget::report();
     // Terminate game and world before unloading modules
     if (m_game_ctx) {
         game::term(m_game_ctx);
@@ -112,6 +117,13 @@ void Engine::shutdown ()
     if (m_events_ctx) {
         events::term(m_events_ctx);
     }
+    memory::releaseFrameArenas();
+}
+
+void Engine::bakeScenes (const std::string& output_path)
+{
+    spdlog::info("Baking scenes...");
+    world::bakeScenes(m_world_ctx, output_path);
 }
 
 void Engine::execute ()
@@ -127,6 +139,9 @@ void Engine::execute ()
         auto delta = frame_timer.frameTime();
         auto frame_count = frame_timer.totalFrames();
 
+        // Release last frame's scratch memory
+        memory::resetFrameArenas();
+
         scripting::call(m_scripting_ctx, "set_game_time", delta, current_time);
 
         // Check if any resources are loaded
@@ -135,6 +150,9 @@ void Engine::execute ()
         // Check if a new scene has loaded
         world::update(m_world_ctx);
 
+        // Release any delayed messages that are due this frame
+        messages::update(m_messages_ctx, frame_count);
+
         // Process system commands
         if EXPECT_NOT_TAKEN(! handle_commands()) {
             return;
@@ -6,6 +6,7 @@ class Engine {
 public:
     bool init (std::shared_ptr<spdlog::logger> logger);
     void execute ();
+    void bakeScenes (const std::string& output_path);
     void shutdown ();
 
 private:
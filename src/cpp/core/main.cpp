@@ -91,8 +91,13 @@ int game_main (int argc, char** argv)
     bool clean_exit = true;
     try {
         Engine engine;
+        const std::string& bake_path = entt::monostate<"dev/bake-scenes"_hs>();
         if (engine.init(logger)) {
-            engine.execute();
+            if (bake_path.empty()) {
+                engine.execute();
+            } else {
+                engine.bakeScenes(bake_path);
+            }
         } else {
             spdlog::critical("Could not start engine");
             spdlog::critical("Terminating.");
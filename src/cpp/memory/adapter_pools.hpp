@@ -1,64 +1,204 @@
 #pragma once
 
 namespace adapter {
-    
+
+    // Two pools, one written to (front) and one holding what was written before the last swap (back).
+    // The writer is the only thread that may call swap, emplace, discard and reset. Other threads may read the back pool while the
+    // writer works on the front by holding a ReadGuard: swap counts readers per pool and only resets a pool once its readers are done.
+    // Readers must therefore release their guard as soon as they are done reading, and in any case before the writer's next swap, which
+    // waits for them (backing off from spinning to sleeping while it does). A reader must never wait for the writer while holding a guard.
     template <typename PoolType>
     class DoubleBuffered {
     public:
+        // Keeps the back pool it was acquired for alive (not reset) until destroyed
+        class ReadGuard {
+        public:
+            ReadGuard (DoubleBuffered& buffered, std::uint32_t index, std::uint64_t epoch) : buffered(&buffered), index(index), swap_epoch(epoch) {}
+            ReadGuard (ReadGuard&& other) : buffered(other.buffered), index(other.index), swap_epoch(other.swap_epoch) { other.buffered = nullptr; }
+            ~ReadGuard () {
+                if (buffered) {
+                    buffered->readers[index].count.fetch_sub(1, std::memory_order_release);
+                }
+            }
+            ReadGuard (const ReadGuard&) = delete;
+            ReadGuard& operator= (const ReadGuard&) = delete;
+
+            const PoolType& pool () const { return buffered->pools[index]; }
+            const PoolType* operator-> () const { return &pool(); }
+
+            // Number of swaps made before this pool was published, to tell whether a reader has seen it before
+            std::uint64_t epoch () const { return swap_epoch; }
+
+        private:
+            DoubleBuffered* buffered;
+            std::uint32_t index;
+            std::uint64_t swap_epoch;
+        };
+
         DoubleBuffered (uint32_t size) :
             pools{PoolType{size}, PoolType{size}},
-            index(0) {
+            swaps(0) {
 
         }
 
         template <typename... Args>
         [[nodiscard]] auto emplace (Args&&... args) {
-            return pools[index].emplace(std::forward<Args>(args)...);
+            return front().emplace(std::forward<Args>(args)...);
         }
-        
+
         void discard (typename PoolType::Type* object) {
-            pools[index].discard(object);
+            front().discard(object);
         }
 
+        // Publish the front pool to readers and start writing to the other pool, once any readers still holding it are done
         void swap () {
-            index = 1 - index;
-            pools[index].reset();
+            const std::uint64_t next = swaps.load(std::memory_order_relaxed) + 1;
+            swaps.store(next);
+            auto& readers_of_next = readers[next & 1].count;
+            // Readers are normally done within a few iterations, but one that was descheduled may take a whole time slice
+            for (std::uint32_t attempt = 0; readers_of_next.load() != 0; ++attempt) {
+                if (attempt < 64) {
+                    __builtin_ia32_pause();
+                } else if (attempt < 1024) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+            pools[next & 1].reset();
         }
 
         void reset () {
-            pools[index].reset();
+            front().reset();
+        }
+
+        // Acquire the back pool for reading. May be called from any thread.
+        ReadGuard read () {
+            while (true) {
+                const std::uint64_t epoch = swaps.load();
+                const std::uint32_t back_index = 1 - std::uint32_t(epoch & 1);
+                readers[back_index].count.fetch_add(1);
+                // If a swap happened in between, the pool may already be getting reset, so try again
+                if (swaps.load() == epoch) {
+                    return ReadGuard{*this, back_index, epoch};
+                }
+                readers[back_index].count.fetch_sub(1, std::memory_order_release);
+            }
         }
 
         std::uint32_t count () const {
-            return pools[index].count();
+            return cfront().count();
         }
 
         std::uint32_t remaining () const {
-            return pools[index].remaining();
+            return cfront().remaining();
         }
 
         std::uint32_t capacity () const {
-            return pools[index].capacity();
+            return cfront().capacity();
         }
 
         PoolType& front() {
-            return pools[index];
+            return pools[index()];
         }
 
+        // Unguarded access to the back pool, only safe from the writer thread
         PoolType& back() {
-            return pools[1 - index];
+            return pools[1 - index()];
         }
 
         const PoolType& cfront() const {
-            return pools[index];
+            return pools[index()];
         }
 
         const PoolType& cback() const {
-            return pools[1 - index];
+            return pools[1 - index()];
         }
+
     private:
+        struct alignas(alignment::AlignCacheLine::Bountary) ReaderCount {
+            std::atomic_uint32_t count{0};
+        };
+
         PoolType pools[2];
-        std::uint32_t index;
+        std::atomic_uint64_t swaps; // The front pool is pools[swaps & 1]
+        ReaderCount readers[2];
+
+        std::uint32_t index () const {
+            return std::uint32_t(swaps.load(std::memory_order_relaxed) & 1);
+        }
+    };
+
+    // Three pools, so that the writer and a reader never wait for each other: the writer fills one pool while the reader holds another,
+    // and the third holds the most recently published pool. publish() hands the filled pool over and takes back whichever pool the reader
+    // is not using; acquire() picks up the newest published pool, if there is one. Intended for one writer thread and one reader thread.
+    template <typename PoolType>
+    class TripleBuffered {
+    public:
+        TripleBuffered (uint32_t size) :
+            pools{PoolType{size}, PoolType{size}, PoolType{size}},
+            writing(0),
+            published(1),
+            reading(2) {
+
+        }
+
+        template <typename... Args>
+        [[nodiscard]] auto emplace (Args&&... args) {
+            return pools[writing].emplace(std::forward<Args>(args)...);
+        }
+
+        void discard (typename PoolType::Type* object) {
+            pools[writing].discard(object);
+        }
+
+        // Make everything written so far available to the reader, and start writing to an empty pool (writer thread only)
+        void publish () {
+            writing = published.exchange(writing | NEW, std::memory_order_acq_rel) & INDEX;
+            pools[writing].reset();
+        }
+
+        void reset () {
+            pools[writing].reset();
+        }
+
+        // Newest published pool, which the reader may use until its next call to acquire (reader thread only)
+        const PoolType& acquire () {
+            if (published.load(std::memory_order_relaxed) & NEW) {
+                reading = published.exchange(reading, std::memory_order_acq_rel) & INDEX;
+            }
+            return pools[reading];
+        }
+
+        // True if a pool was published since the reader last called acquire
+        bool available () const {
+            return published.load(std::memory_order_relaxed) & NEW;
+        }
+
+        std::uint32_t count () const {
+            return pools[writing].count();
+        }
+
+        std::uint32_t remaining () const {
+            return pools[writing].remaining();
+        }
+
+        std::uint32_t capacity () const {
+            return pools[writing].capacity();
+        }
+
+        PoolType& front() {
+            return pools[writing];
+        }
+
+    private:
+        static constexpr std::uint8_t INDEX = 0x3;
+        static constexpr std::uint8_t NEW = 0x4; // Set in `published` when the reader has not picked up the pool yet
+
+        PoolType pools[3];
+        std::uint8_t writing;
+        alignas(alignment::AlignCacheLine::Bountary) std::atomic_uint8_t published;
+        alignas(alignment::AlignCacheLine::Bountary) std::uint8_t reading;
     };
 
-}
\ No newline at end of file
+}
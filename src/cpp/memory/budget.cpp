@@ -0,0 +1,166 @@
+#include "budget.hpp"
+
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+namespace {
+    struct Entry {
+        const char* type = nullptr; // nullptr if entry is not in use
+        std::string name;
+        memory::budget::Subsystem subsystem;
+        std::uint64_t reserved;
+        std::uint64_t committed;
+        std::uint64_t peak_used;
+    };
+
+    thread_local memory::budget::Subsystem g_current_subsystem = memory::budget::Subsystem::General;
+    thread_local const char* g_current_name = "unnamed";
+
+    // Pools are created and destroyed rarely, so a lock is fine
+    std::mutex g_mutex;
+    std::vector<Entry> g_entries;
+    std::vector<std::uint32_t> g_free_entries;
+    memory::budget::Stats g_stats[memory::budget::NUM_SUBSYSTEMS] = {};
+
+    inline memory::budget::Stats& statsFor (memory::budget::Subsystem subsystem)
+    {
+        return g_stats[std::size_t(subsystem)];
+    }
+
+    std::string describeEntry (const Entry& entry)
+    {
+        return fmt::format("{} '{}' ({})", entry.type, entry.name, magic_enum::enum_name(entry.subsystem));
+    }
+
+    void checkBudget (const Entry& entry, std::uint64_t additional)
+    {
+        const auto& stats = statsFor(entry.subsystem);
+        if (stats.budget > 0 && stats.committed + additional > stats.budget) {
+            const auto message = fmt::format("{} needs {} more bytes, but {} already has {} of its {} byte budget committed",
+                describeEntry(entry), additional, magic_enum::enum_name(entry.subsystem), stats.committed, stats.budget);
+            spdlog::error("[memory] Budget exceeded: {}", message);
+            throw std::runtime_error("Memory budget exceeded: " + message);
+        }
+    }
+}
+
+memory::budget::Scope::Scope (memory::budget::Subsystem subsystem, const char* name) :
+    m_previous_subsystem(g_current_subsystem),
+    m_previous_name(g_current_name)
+{
+    g_current_subsystem = subsystem;
+    g_current_name = name != nullptr ? name : "unnamed";
+}
+
+memory::budget::Scope::~Scope ()
+{
+    g_current_subsystem = m_previous_subsystem;
+    g_current_name = m_previous_name;
+}
+
+memory::budget::Tracker::Tracker (const char* type, std::size_t reserved, std::size_t committed) :
+    m_id(INVALID),
+    m_peak(0)
+{
+    std::lock_guard<std::mutex> guard(g_mutex);
+    Entry entry{type, g_current_name, g_current_subsystem, reserved, committed, 0};
+    checkBudget(entry, committed);
+    if (g_free_entries.empty()) {
+        m_id = std::uint32_t(g_entries.size());
+        g_entries.push_back(std::move(entry));
+    } else {
+        m_id = g_free_entries.back();
+        g_free_entries.pop_back();
+        g_entries[m_id] = std::move(entry);
+    }
+    auto& stats = statsFor(g_current_subsystem);
+    stats.reserved += reserved;
+    stats.committed += committed;
+    ++stats.pools;
+}
+
+memory::budget::Tracker::~Tracker ()
+{
+    if (m_id != INVALID) {
+        std::lock_guard<std::mutex> guard(g_mutex);
+        auto& entry = g_entries[m_id];
+        auto& stats = statsFor(entry.subsystem);
+        stats.reserved -= entry.reserved;
+        stats.committed -= entry.committed;
+        stats.peak_used -= entry.peak_used;
+        --stats.pools;
+        entry.type = nullptr;
+        g_free_entries.push_back(m_id);
+    }
+}
+
+void memory::budget::Tracker::commit (std::size_t committed)
+{
+    std::lock_guard<std::mutex> guard(g_mutex);
+    auto& entry = g_entries[m_id];
+    if (committed > entry.committed) {
+        checkBudget(entry, committed - entry.committed);
+    }
+    auto& stats = statsFor(entry.subsystem);
+    stats.committed = stats.committed - entry.committed + committed;
+    entry.committed = committed;
+    if (committed > entry.reserved) {
+        // Pools that grow on the heap have no separate reservation
+        stats.reserved += committed - entry.reserved;
+        entry.reserved = committed;
+    }
+}
+
+void memory::budget::Tracker::updatePeak ()
+{
+    if (m_id != INVALID) {
+        std::lock_guard<std::mutex> guard(g_mutex);
+        auto& entry = g_entries[m_id];
+        statsFor(entry.subsystem).peak_used += m_peak - entry.peak_used;
+        entry.peak_used = m_peak;
+    }
+}
+
+std::string memory::budget::Tracker::describe () const
+{
+    std::lock_guard<std::mutex> guard(g_mutex);
+    if (m_id == INVALID) {
+        return "unregistered pool";
+    }
+    const auto& entry = g_entries[m_id];
+    return fmt::format("{}, {} of {} bytes committed", describeEntry(entry), entry.committed, entry.reserved);
+}
+
+void memory::budget::setBudget (memory::budget::Subsystem subsystem, std::uint64_t bytes)
+{
+    std::lock_guard<std::mutex> guard(g_mutex);
+    statsFor(subsystem).budget = bytes;
+}
+
+memory::budget::Stats memory::budget::stats (memory::budget::Subsystem subsystem)
+{
+    std::lock_guard<std::mutex> guard(g_mutex);
+    return statsFor(subsystem);
+}
+
+void memory::budget::report ()
+{
+    std::lock_guard<std::mutex> guard(g_mutex);
+    for (auto subsystem : magic_enum::enum_values<memory::budget::Subsystem>()) {
+        const auto& stats = statsFor(subsystem);
+        if (stats.pools == 0) {
+            continue;
+        }
+        if (stats.budget > 0) {
+            spdlog::info("[memory] {}: {} pools, {} bytes reserved, {} bytes committed (budget {}), {} bytes peak used", magic_enum::enum_name(subsystem), stats.pools, stats.reserved, stats.committed, stats.budget, stats.peak_used);
+        } else {
+            spdlog::info("[memory] {}: {} pools, {} bytes reserved, {} bytes committed, {} bytes peak used", magic_enum::enum_name(subsystem), stats.pools, stats.reserved, stats.committed, stats.peak_used);
+        }
+        for (const auto& entry : g_entries) {
+            if (entry.type != nullptr && entry.subsystem == subsystem) {
+                spdlog::debug("[memory]   {}: {} reserved, {} committed, {} peak used", describeEntry(entry), entry.reserved, entry.committed, entry.peak_used);
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Central accounting of the memory held by the engine's pools. Every pool registers itself on construction, reporting how many bytes
+// it has reserved (address space or up-front allocation), committed (backed by memory) and the most it has used, attributed to the
+// subsystem and name of the budget::Scope active on the constructing thread. Subsystems may be given a hard budget on committed memory,
+// exceeding it throws with a description of the pool and the budget instead of failing later with a generic out of space error.
+namespace memory::budget {
+
+    enum class Subsystem : std::uint8_t {
+        General = 0,
+        Messages,
+        Events,
+        Frame,
+    };
+    constexpr std::size_t NUM_SUBSYSTEMS = 4;
+
+    struct Stats {
+        std::uint64_t reserved;
+        std::uint64_t committed;
+        std::uint64_t peak_used; // Sum of the peak usage of each pool
+        std::uint64_t budget;    // 0 if unlimited
+        std::uint32_t pools;
+    };
+
+    // Attribute pools created by the current thread to a subsystem and name, for the lifetime of the scope. Scopes may be nested.
+    class Scope {
+    public:
+        Scope (Subsystem subsystem, const char* name);
+        ~Scope ();
+        Scope (const Scope&) = delete;
+        Scope& operator= (const Scope&) = delete;
+
+    private:
+        Subsystem m_previous_subsystem;
+        const char* m_previous_name;
+    };
+
+    // Registration of a single pool, held by the pool for as long as it exists. Construction throws if the pool takes its subsystem over
+    // budget, so pools declare their tracker before the members that own their memory, allocating nothing until the budget allows it.
+    class Tracker {
+    public:
+        static constexpr std::uint32_t INVALID = 0xffffffff;
+
+        Tracker (const char* type, std::size_t reserved, std::size_t committed);
+        Tracker (Tracker&& other) : m_id(other.m_id), m_peak(other.m_peak) { other.m_id = INVALID; }
+        ~Tracker ();
+        Tracker (const Tracker&) = delete;
+        Tracker& operator= (const Tracker&) = delete;
+
+        // Update the number of bytes backed by memory, throwing if this takes the subsystem over its budget
+        void commit (std::size_t committed);
+
+        // Report how much of the pool is in use, typically called before reset. Only touches shared state when a new peak is reached.
+        void used (std::size_t bytes)
+        {
+            if (bytes > m_peak) {
+                m_peak = bytes;
+                updatePeak();
+            }
+        }
+
+        // Human readable description of the pool, for diagnostics
+        std::string describe () const;
+
+    private:
+        std::uint32_t m_id;
+        std::size_t m_peak;
+
+        void updatePeak ();
+    };
+
+    // Set a hard limit on the memory committed by a subsystem's pools, 0 for unlimited
+    void setBudget (Subsystem subsystem, std::uint64_t bytes);
+
+    // Current totals for a subsystem
+    Stats stats (Subsystem subsystem);
+
+    // Log the totals for each subsystem and each pool
+    void report ();
+}
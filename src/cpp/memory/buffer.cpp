@@ -0,0 +1,58 @@
+#include <monkeys.hpp>
+#include "buffer.hpp"
+
+#include <chrono>
+
+// Benchmarks for the MemoryManager in buffer.hpp, in the `benchmarks` test suite (see pools.cpp)
+
+namespace {
+    // Shaped like an event envelope followed by a small payload
+    struct Envelope {
+        std::uint32_t type;
+        std::uint32_t size;
+    };
+    constexpr std::size_t PayloadSize = 16;
+
+    // Not inlined, so that each allocator is measured as the event streams call it rather than optimised into the benchmark loop
+    template <typename Allocator>
+    [[gnu::noinline]] void writeEvents (Allocator& allocator, std::uint32_t count)
+    {
+        for (std::uint32_t index = 0; index < count; ++index) {
+            new (allocator.allocate(sizeof(Envelope) + PayloadSize)) Envelope{index, std::uint32_t(PayloadSize)};
+        }
+    }
+
+    template <typename Allocator>
+    double framesMs (Allocator& allocator, std::uint32_t frames, std::uint32_t events_per_frame)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::uint32_t frame = 0; frame < frames; ++frame) {
+            writeEvents(allocator, events_per_frame);
+            allocator.reset();
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+}
+
+TEST_CASE("MemoryManager allocation benchmark" * doctest::test_suite("benchmarks") * doctest::skip()) {
+    constexpr std::uint32_t Frames = 20000;
+    constexpr std::uint32_t EventsPerFrame = 1000;
+    constexpr std::uint32_t Size = EventsPerFrame * (sizeof(Envelope) + PayloadSize);
+    using Align = memory::alignment::AlignCacheLine;
+
+    memory::heterogeneous::StackPool<Align> stack_pool(Size);
+    memory::heterogeneous::AtomicStackPool<Align> atomic_stack_pool(Size);
+    memory::SingleWriterSingleBuffer single_writer(Size);
+    memory::MultiWriterSingleBuffer multi_writer(Size);
+
+    // A few rounds, as the first touches every page for the first time
+    for (int round = 0; round < 3; ++round) {
+        spdlog::info("[memory] {} frames of {} events: StackPool {:.1f}ms, SingleWriter {:.1f}ms, AtomicStackPool {:.1f}ms, MultiWriter {:.1f}ms",
+            Frames, EventsPerFrame,
+            framesMs(stack_pool, Frames, EventsPerFrame),
+            framesMs(single_writer, Frames, EventsPerFrame),
+            framesMs(atomic_stack_pool, Frames, EventsPerFrame),
+            framesMs(multi_writer, Frames, EventsPerFrame));
+    }
+}
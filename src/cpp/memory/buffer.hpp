@@ -1,110 +1,199 @@
 #pragma once
 
-// WIP: try to come up with a modular solution for paged allocation system for use by event streams, command stream and messages. Perhaps also for storing resources.
-// Needs more thought.
-// Basic requirements:
-//      1. Event streams need a double buffered single writer multiple reader stack allocator
-//      2. Command stream needs a multiple writer single reader stack allocator. Doesn't matter if single or double buffered
-//      3. Messages need a multiple writer single reader stack allocator that supports both single and doulble buffered modes, with remaining messages persisting between buffer swaps
-//      4. Resources probably need a pool allocator
+// Paged allocation layer used by event streams, the command stream and messages.
 //
-// Should support multiple "pages" of buffers, so if a buffer runs out of space, another one is taken from a pool, and used to expand the size of the previous.
-// This would require allocation to switch to a new buffer (possibly atomically) and iteration to handle switching from one buffer to the next
+// A MemoryManager combines a buffering policy with an allocator policy:
+//      1. Event streams use a double buffered single writer or multiple writer stack allocator, so that last frame's events can be read while this frame's are written
+//      2. The command stream uses a double buffered multiple writer stack allocator
+//      3. Messages use single buffered single writer stack allocators per thread, which are gathered into the global message pool each pump
+//      4. Engine streams use single buffered stack allocators, so their events are visible as soon as they are written
+//
+// Each buffer reserves a large range of address space and commits pages to it as allocations cross into them, chaining new
+// pages directly onto the end of the previous ones. A buffer that runs out of committed space therefore grows without moving,
+// pointers into it remain valid and readers always see one contiguous range of memory (which the event iterators and Lua rely on).
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <utility>
 #include <stdexcept>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "budget.hpp"
+
 namespace memory {
 
+    // A contiguous range of reserved address space, of which the first `committed()` bytes are backed by memory
     class Buffer {
     public:
-        Buffer () : m_size(0), m_memory(nullptr) {}
-        Buffer (std::size_t capacity) : m_size(capacity), m_memory(new std::byte[capacity]) {}
-        Buffer (Buffer&& other) : m_size(other.m_size), m_memory(other.m_memory) {other.m_memory = nullptr; }
-        ~Buffer() { if (m_memory) {delete [] m_memory;} }
+        // Commit `capacity` bytes up front, reserving space for the buffer to grow up to `reserve` bytes
+        Buffer (std::size_t capacity, std::size_t reserve) :
+            m_page_size(roundUp(capacity, systemPageSize())),
+            m_reserved(roundUp(std::max(reserve, capacity), systemPageSize())),
+            m_memory(nullptr),
+            m_committed(0),
+            m_tracker("memory::Buffer", m_reserved, 0)
+        {
+            void* ptr = mmap(nullptr, m_reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (ptr == MAP_FAILED) {
+                throw std::runtime_error("memory::Buffer could not reserve address space");
+            }
+            m_memory = reinterpret_cast<std::byte*>(ptr);
+            try {
+                commit(capacity);
+            } catch (...) {
+                // The destructor won't run for a buffer that failed to construct
+                munmap(m_memory, m_reserved);
+                throw;
+            }
+        }
+        Buffer (Buffer&& other) :
+            m_page_size(other.m_page_size),
+            m_reserved(other.m_reserved),
+            m_memory(other.m_memory),
+            m_committed(other.m_committed.load()),
+            m_tracker(std::move(other.m_tracker))
+        {
+            other.m_memory = nullptr;
+        }
+        ~Buffer() { if (m_memory) { munmap(m_memory, m_reserved); } }
 
-        bool valid () const { return m_memory != nullptr; }
-        std::size_t size () const { return m_size; }
-        std::byte* data () { return m_memory; }
+        std::byte* data () const { return m_memory; }
+        std::size_t committed () const { return m_committed.load(std::memory_order_acquire); }
+        std::size_t capacity () const { return m_reserved; }
 
-        std::byte& operator[](std::size_t index)
+        // Make sure the first `size` bytes are backed by memory, chaining on as many pages as are needed. Safe to call from multiple threads.
+        void commit (std::size_t size)
         {
-            if (index < m_size) {
-                return m_memory[index];
-            } else {
-                throw std::out_of_range("Buffer index out of range");
+            std::lock_guard<std::mutex> guard(m_commit_mutex);
+            const std::size_t committed = m_committed.load(std::memory_order_relaxed);
+            if (size <= committed) {
+                return; // Another thread already committed the pages
+            }
+            if (size > m_reserved) {
+                throw std::runtime_error(m_tracker.describe() + " allocated more than reserved space");
+            }
+            const std::size_t new_committed = std::min(roundUp(size, m_page_size), m_reserved);
+            m_tracker.commit(new_committed); // Check the budget before touching the pages
+            if (mprotect(m_memory + committed, new_committed - committed, PROT_READ | PROT_WRITE) != 0) {
+                m_tracker.commit(committed);
+                throw std::runtime_error(m_tracker.describe() + " could not commit memory");
             }
+            m_committed.store(new_committed, std::memory_order_release);
         }
 
-        Buffer view (std::size_t start_index, std::size_t size)
+        // Return all but the first page to the OS. Must not be called while the buffer is being used.
+        void trim ()
         {
-            if (start_index + size <= m_size) {
-                return Buffer(m_memory + start_index, start_index + size);
-            } else {
-                return Buffer();
+            const std::size_t committed = m_committed.load(std::memory_order_relaxed);
+            if (committed > m_page_size) {
+                madvise(m_memory + m_page_size, committed - m_page_size, MADV_DONTNEED);
+                mprotect(m_memory + m_page_size, committed - m_page_size, PROT_NONE);
+                m_committed.store(m_page_size, std::memory_order_release);
+                m_tracker.commit(m_page_size);
             }
         }
 
+        // Report how many bytes were written before the buffer is reused
+        void used (std::size_t bytes) { m_tracker.used(bytes); }
+
+        // Size of the first page, which is never trimmed
+        std::size_t pageSize () const { return m_page_size; }
+
     private:
-        Buffer(std::byte* memory, std::size_t size) : m_size(size), m_memory(memory) {}
+        static std::size_t systemPageSize ()
+        {
+            static const std::size_t page_size = std::size_t(sysconf(_SC_PAGESIZE));
+            return page_size;
+        }
+        static std::size_t roundUp (std::size_t size, std::size_t granularity)
+        {
+            return std::max(((size + granularity - 1) / granularity) * granularity, granularity);
+        }
 
-        const std::size_t m_size;
+        const std::size_t m_page_size;
+        const std::size_t m_reserved;
         std::byte* m_memory;
+        std::atomic_size_t m_committed;
+        std::mutex m_commit_mutex;
+        budget::Tracker m_tracker;
     };
 
+    // Allocator for a single writer, which does not need to synchronize with anything
     class StackAllocator {
     public:
+        StackAllocator () : m_next(0) {}
+        StackAllocator (StackAllocator&& other) : m_next(other.m_next) {}
+
         std::size_t allocate (std::size_t amount)
         {
-            auto ptr = m_next;
+            auto offset = m_next;
             m_next += amount;
-            return ptr;
-        }
-
-        void reset ()
-        {
-            m_next = 0;
+            return offset;
         }
 
+        void reset () { m_next = 0; }
+        void rewind (std::size_t offset) { m_next = offset; }
         std::size_t used () const { return m_next; }
-        std::size_t free () const { return m_max - m_next; }
+
     private:
-        std::size_t m_max;
         std::size_t m_next;
     };
 
-    class SingleBuffer {
+    // Allocator for multiple concurrent writers, at the cost of an atomic add per allocation
+    class AtomicStackAllocator {
     public:
-        SingleBuffer (std::size_t capacity) : m_buffer(capacity) {}
-        ~SingleBuffMemoryManager() {}
+        AtomicStackAllocator () : m_next(0) {}
+        AtomicStackAllocator (AtomicStackAllocator&& other) : m_next(other.m_next.load()) {}
 
-        Buffer view (std::size_t start_index, std::size_t size)
+        std::size_t allocate (std::size_t amount)
         {
-            return m_buffer.view(start_index, size);
+            return m_next.fetch_add(amount);
         }
 
-        void swap (std::size_t) {}
+        void reset () { m_next.store(0); }
+        void rewind (std::size_t offset) { m_next.store(offset); }
+        std::size_t used () const { return m_next.load(); }
 
-        Buffer data (std::size_t size)
-        {
-            return m_buffer.view(0, size);
-        }
+    private:
+        std::atomic_size_t m_next;
+    };
+
+    // Writers and readers share one buffer: data can be read as soon as it is written, and is discarded on swap
+    class SingleBuffer {
+    public:
+        SingleBuffer (std::size_t capacity, std::size_t reserve) : m_buffer(capacity, reserve) {}
+        SingleBuffer (SingleBuffer&& other) : m_buffer(std::move(other.m_buffer)) {}
+        ~SingleBuffer() {}
+
+        Buffer& front () { return m_buffer; }
+        const Buffer& back () const { return m_buffer; }
+
+        // Data is read from the same buffer as is being written, so only `used` bytes of the front are ever readable
+        std::size_t readable (std::size_t used) const { return used; }
+
+        void swap (std::size_t) {}
 
     private:
         Buffer m_buffer;
     };
 
+    // Writers write to the front buffer while readers read what was written before the last swap from the back buffer
     class DoubleBuffer {
     public:
-        DoubleBuffer (std::size_t capacity) : m_buffers{{capacity}, {capacity}}, m_current(0), m_used(0) {}
+        DoubleBuffer (std::size_t capacity, std::size_t reserve) : m_buffers{{capacity, reserve}, {capacity, reserve}}, m_current(0), m_used(0) {}
+        DoubleBuffer (DoubleBuffer&& other) : m_buffers{std::move(other.m_buffers[0]), std::move(other.m_buffers[1])}, m_current(other.m_current), m_used(other.m_used) {}
         ~DoubleBuffer() {}
 
-        Buffer view (std::size_t start_index, std::size_t size)
-        {
-            return m_buffers[m_current].view(start_index, size);
-        }
+        Buffer& front () { return m_buffers[m_current]; }
+        const Buffer& back () const { return m_buffers[1 - m_current]; }
+
+        std::size_t readable (std::size_t) const { return m_used; }
 
         void swap (std::size_t used)
         {
@@ -112,43 +201,96 @@ namespace memory {
             m_used = used;
         }
 
-        Buffer data (std::size_t)
-        {
-            return m_buffers[1 - m_current].view(0, m_used);
-        }
-
     private:
         Buffer m_buffers[2];
-        std::size_t m_current;
+        int m_current;
         std::size_t m_used;
     };
 
+    // Stack allocation from paged buffers. Allocation only touches the buffer when it crosses into a page that has not been committed yet.
+    // If a swap finds that less than the first page has been used for `TrimAfterSwaps` swaps in a row, the extra pages are returned to the OS.
     template <typename BufferT, typename AllocatorT>
     class MemoryManager {
     public:
-        MemoryManager (std::size_t capacity) : m_memory(capacity) {}
+        static constexpr std::uint32_t TrimAfterSwaps = 256;
+        // Unless otherwise specified, buffers may grow to this multiple of their initial size
+        static constexpr std::size_t DefaultReserveFactor = 64;
+
+        MemoryManager (std::size_t capacity) : MemoryManager(capacity, capacity * DefaultReserveFactor) {}
+        MemoryManager (std::size_t capacity, std::size_t reserve) : m_memory(capacity, reserve), m_low_usage_swaps(0) {}
+        MemoryManager (MemoryManager&& other) : m_memory(std::move(other.m_memory)), m_allocator(std::move(other.m_allocator)), m_low_usage_swaps(other.m_low_usage_swaps) {}
         ~MemoryManager() {}
 
-        Buffer allocate (std::size_t amount)
+        std::byte* allocate (std::size_t amount)
         {
-            return m_memory.view(m_allocator.allocate(amount), amount);
+            auto& buffer = m_memory.front();
+            const std::size_t offset = m_allocator.allocate(amount);
+            if (offset + amount > buffer.committed()) {
+                buffer.commit(offset + amount);
+            }
+            return buffer.data() + offset;
         }
 
-        void reset ()
+        // Make everything written so far readable (double buffered) or discard it (single buffered), then start writing from the beginning
+        void swap ()
         {
-            m_memory.swap(m_allocator.used());
+            auto& buffer = m_memory.front();
+            const std::size_t used = m_allocator.used();
+            buffer.used(used);
+            if (used <= buffer.pageSize()) {
+                if (++m_low_usage_swaps >= TrimAfterSwaps) {
+                    buffer.trim();
+                    m_low_usage_swaps = 0;
+                }
+            } else {
+                m_low_usage_swaps = 0;
+            }
+            m_memory.swap(used);
             m_allocator.reset();
         }
 
-        Buffer data ()
+        void reset ()
+        {
+            swap();
+        }
+
+        // Discard everything allocated past `offset` bytes from the start of the front buffer
+        void rewind (std::size_t offset)
+        {
+            m_allocator.rewind(offset);
+        }
+
+        // Readable data
+        std::byte* begin () const
+        {
+            return m_memory.back().data();
+        }
+
+        std::byte* end () const
         {
-            return m_memory.data(m_allocator.used());
+            // Multiple writers may have claimed space that is not committed yet, which must not be read
+            const auto& buffer = m_memory.back();
+            return buffer.data() + std::min(m_memory.readable(m_allocator.used()), buffer.committed());
+        }
+
+        // Copy the readable data of another pool or memory manager into this one
+        template <typename Other>
+        void pushAll (const Other& other)
+        {
+            const std::size_t size = other.end() - other.begin();
+            if (size > 0) { // Only copy if there is data to copy
+                std::memcpy(allocate(size), other.begin(), size);
+            }
         }
 
     private:
         BufferT m_memory;
         AllocatorT m_allocator;
+        std::uint32_t m_low_usage_swaps;
     };
 
-    using StackDblBuff = MemoryManager<DoubleBuffer, StackAllocator>;
-}
\ No newline at end of file
+    using SingleWriterSingleBuffer = MemoryManager<SingleBuffer, StackAllocator>;
+    using SingleWriterDoubleBuffer = MemoryManager<DoubleBuffer, StackAllocator>;
+    using MultiWriterSingleBuffer = MemoryManager<SingleBuffer, AtomicStackAllocator>;
+    using MultiWriterDoubleBuffer = MemoryManager<DoubleBuffer, AtomicStackAllocator>;
+}
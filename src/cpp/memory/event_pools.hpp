@@ -1,19 +1,20 @@
 #pragma once
 
-// TODO: Replace with better modular design
-
 #include <monkeys.hpp>
+#include "buffer.hpp"
 
 namespace memory {
-    template <typename PoolT, typename Envelope>
+    template <typename AllocatorT, typename Envelope>
     class BasePool {
     public:
-        using PoolType = PoolT;
+        using AllocatorType = AllocatorT;
+        template <typename PoolT>
         static million::events::Iterable<Envelope> iter (const PoolT& pool)
         {
             return {pool.begin(), pool.end()};
         }
     protected:
+        template <typename PoolT>
         static std::byte* push (PoolT& pool, entt::hashed_string::hash_type event_id, uint32_t payload_size)
         {
             using EnvelopeT = million::events::EventEnvelope;
@@ -23,53 +24,159 @@ namespace memory {
         }
     };
 
-    // A simple event pool used for the global event system
-    class MessagePool
+    // Reference to a message payload stored out-of-line in a MessageBlobArena
+    struct MessageBlob {
+        std::uint32_t offset; // Offset from the start of the arena
+        std::uint32_t size;   // Size of payload in bytes
+    };
+
+    // Storage for message payloads that are too big to fit inline in a message pool (more than 255 bytes).
+    // Double buffered: blobs for messages posted since the last pump are written to the front arena, while blobs for the
+    // messages currently being processed are read from the back arena. Each pump frees the old back arena in bulk.
+    class MessageBlobArena
     {
     public:
-        using PoolType = memory::heterogeneous::StackPool<memory::alignment::AlignCacheLine>;
+        using PoolType = heterogeneous::AtomicStackPool<alignment::AlignCacheLine, alignment::AlignSIMD>;
 
-        MessagePool (uint32_t size) :
-            m_pool{size}
-        {}
-        MessagePool (MessagePool&& other)
-            : m_pool(std::move(other.m_pool))
+        MessageBlobArena (std::uint32_t size) :
+            m_pools{{size}, {size}},
+            m_current(0)
         {}
-        ~MessagePool () {}
+        ~MessageBlobArena () {}
 
-        void reset ()
+        // Allocate a blob in the front arena, returning a pointer to it and writing its offset into `offset`
+        std::byte* allocate (std::uint32_t size, std::uint32_t& offset)
         {
-            m_pool.reset();
+            auto& pool = m_pools[m_current];
+            std::byte* ptr = pool.allocate(size);
+            offset = std::uint32_t(ptr - pool.begin());
+            return ptr;
         }
 
-        template <typename OtherPool>
-        void copyInto (OtherPool& destination) const
+        // Base address of the blobs referenced by the messages currently being processed
+        const std::byte* blobs () const
         {
-            destination.template pushAll<PoolType>(m_pool);
+            return m_pools[1 - m_current].begin();
         }
 
-        std::byte* push (entt::hashed_string::hash_type message_id, std::uint32_t target, std::uint32_t flags, std::uint8_t payload_size)
+        void swap ()
         {
-            std::byte* ptr = m_pool.allocate(sizeof(MessageEnvelope) + payload_size);
-            new (ptr) MessageEnvelope{message_id, target, (std::uint32_t(flags) << 8) | payload_size};
-            return ptr + sizeof(MessageEnvelope);
+            m_current = 1 - m_current;
+            m_pools[m_current].reset();
         }
 
     private:
-        PoolType m_pool;
+        PoolType m_pools[2];
+        int m_current;
+    };
+
+    // Header for a message that is held back until a later frame, followed by `size` bytes of payload
+    struct DelayedMessage {
+        std::uint64_t frame; // Frame on which the message is due
+        entt::hashed_string::hash_type type;
+        std::uint32_t target;
+        std::uint32_t flags;
+        std::uint32_t size;
+    };
+
+    // A simple event pool used for the global event system
+    class MessagePool
+    {
+    public:
+        using PoolType = memory::SingleWriterSingleBuffer;
+        // Pool that the per-thread pools are gathered into each pump, reserves address space so that it can grow as needed
+        using GatherPoolType = memory::heterogeneous::VirtualStackPool<>;
 
         struct MessageEnvelope { // Message envelope is targetted at a specific entity
             entt::hashed_string::hash_type type;
             std::uint32_t target; // Entity ID or Group ID
             /* Metadata, 32 bits
-             * T = 2bits flag, Mask: 0xd0000000, Target type. 00 => target entity, 01 => target group, 10 => target entity set, 11 => target composite
+             * T = 2bits flag, Mask: 0xc0000000, Target type. 00 => target entity, 01 => target group, 10 => target entity set, 11 => target composite
              * F = 1bit flag, Mask: 0x20000000, Filter. 0 => not filtered by category, 1 => filtered by category (only target entities with specified category will receive message)
+             * E = 1bit flag, Mask: 0x10000000, Extended payload. 0 => payload is inline, 1 => inline payload is a MessageBlob referencing the payload in the blob arena
              * x = reserved
              * C = 16bit bitfield, Mask: 0x00ffff00, Category bitfield, each bit represents one of 14 total possible categories. 0 => Category not filtered by, 1 => category filtered by
-             * S = 8bit number, Mask: 0x000000ff, Size of payload in bytes
+             * S = 8bit number, Mask: 0x000000ff, Size of (inline) payload in bytes
              */
             std::uint32_t metadata;
         };
+
+        // Largest payload that can be stored inline, as the payload size is packed into 8 bits of the envelope metadata
+        static constexpr std::uint32_t MaxInlinePayloadSize = 0xff;
+        // Metadata flag marking the inline payload as a MessageBlob, referencing the real payload in the MessageBlobArena
+        static constexpr std::uint32_t ExtendedPayloadFlag = 0x10000000;
+
+        MessagePool (uint32_t size, MessageBlobArena* blobs=nullptr) :
+            m_pool{size},
+            m_delayed_pool{size},
+            m_blobs{blobs}
+        {}
+        MessagePool (MessagePool&& other)
+            : m_pool(std::move(other.m_pool)),
+              m_delayed_pool(std::move(other.m_delayed_pool)),
+              m_blobs(other.m_blobs)
+        {}
+        ~MessagePool () {}
+
+        void reset ()
+        {
+            m_pool.reset();
+        }
+
+        template <typename OtherPool>
+        void copyInto (OtherPool& destination) const
+        {
+            destination.pushAll(m_pool);
+        }
+
+        std::byte* push (entt::hashed_string::hash_type message_id, std::uint32_t target, std::uint32_t flags, std::uint32_t payload_size)
+        {
+            if EXPECT_TAKEN(payload_size <= MaxInlinePayloadSize) {
+                std::byte* ptr = m_pool.allocate(sizeof(MessageEnvelope) + payload_size);
+                new (ptr) MessageEnvelope{message_id, target, (std::uint32_t(flags) << 8) | payload_size};
+                return ptr + sizeof(MessageEnvelope);
+            } else {
+                return pushExtended(message_id, target, flags, payload_size);
+            }
+        }
+
+        // Messages to deliver on a later frame are stored separately, until they are drained into the timing wheel at the next pump
+        std::byte* pushDelayed (entt::hashed_string::hash_type message_id, std::uint32_t target, std::uint32_t flags, std::uint32_t payload_size, std::uint64_t frame)
+        {
+            std::byte* ptr = m_delayed_pool.allocate(sizeof(DelayedMessage) + payload_size);
+            new (ptr) DelayedMessage{frame, message_id, target, flags, payload_size};
+            return ptr + sizeof(DelayedMessage);
+        }
+
+        // Call `fn(const DelayedMessage&, const std::byte* payload)` for each delayed message, then reset the delayed messages
+        template <typename Function>
+        void drainDelayed (Function fn)
+        {
+            const std::byte* ptr = m_delayed_pool.begin();
+            const std::byte* end = m_delayed_pool.end();
+            while (ptr < end) {
+                const auto& header = *reinterpret_cast<const DelayedMessage*>(ptr);
+                fn(header, ptr + sizeof(DelayedMessage));
+                ptr += sizeof(DelayedMessage) + header.size;
+            }
+            m_delayed_pool.reset();
+        }
+
+    private:
+        PoolType m_pool;
+        PoolType m_delayed_pool;
+        MessageBlobArena* m_blobs;
+
+        std::byte* pushExtended (entt::hashed_string::hash_type message_id, std::uint32_t target, std::uint32_t flags, std::uint32_t payload_size)
+        {
+            if (m_blobs == nullptr) {
+                throw std::runtime_error("MessagePool has no blob arena for large message payloads");
+            }
+            std::byte* ptr = m_pool.allocate(sizeof(MessageEnvelope) + sizeof(MessageBlob));
+            new (ptr) MessageEnvelope{message_id, target, (std::uint32_t(flags) << 8) | ExtendedPayloadFlag | std::uint32_t(sizeof(MessageBlob))};
+            auto blob = new (ptr + sizeof(MessageEnvelope)) MessageBlob{0, payload_size};
+            return m_blobs->allocate(payload_size, blob->offset);
+        }
     };
 
     class IterableStream {
@@ -79,53 +186,48 @@ namespace memory {
         virtual void swap () = 0;
     };
 
-    // A double buffered pool.
-    using SingleWriterBase = BasePool<heterogeneous::StackPool<alignment::AlignCacheLine>, million::events::EventEnvelope>;
-    using MultiWriterBase = BasePool<heterogeneous::AtomicStackPool<alignment::AlignCacheLine>, million::events::EventEnvelope>;
+    using SingleWriterBase = BasePool<StackAllocator, million::events::EventEnvelope>;
+    using MultiWriterBase = BasePool<AtomicStackAllocator, million::events::EventEnvelope>;
 
+    // A double buffered pool.
     template <typename StreamPoolBase>
     class StreamPool : public StreamPoolBase, public IterableStream
     {
         using Base = StreamPoolBase;
     public:
+        using PoolType = MemoryManager<DoubleBuffer, typename Base::AllocatorType>;
+
         StreamPool (uint32_t size) :
-            m_pools{{size}, {size}},
-            m_current(0)
+            m_pool{size}
         {}
         StreamPool (StreamPool&& other)
-            : m_pools{std::move(other.m_pools[0]), std::move(other.m_pools[1])}
+            : m_pool{std::move(other.m_pool)}
         {}
         virtual ~StreamPool () {}
 
         million::events::EventIterable iter () const final
         {
-            return Base::iter(back());
+            return Base::iter(m_pool);
         }
 
         template <typename OtherPool>
         void copyInto (OtherPool& destination) const
         {
-            using Pool = typename Base::PoolType;
-            destination.template pushAll<Pool>(back());
+            destination.pushAll(m_pool);
         }
 
         void swap () final
         {
-            m_current = 1 - m_current;
-            front().reset();
+            m_pool.swap();
         }
 
         std::byte* push (entt::hashed_string::hash_type event_id, uint32_t payload_size)
         {
-            return Base::push(front(), event_id, payload_size);
+            return Base::push(m_pool, event_id, payload_size);
         }
 
     private:
-        typename Base::PoolType m_pools[2];
-        int m_current;
-
-        typename Base::PoolType& front () { return m_pools[m_current]; }
-        const typename Base::PoolType& back () const { return m_pools[1 - m_current]; }
+        PoolType m_pool;
     };
 
     template <typename StreamPoolBase>
@@ -133,11 +235,13 @@ namespace memory {
     {
         using Base = StreamPoolBase;
     public:
+        using PoolType = MemoryManager<SingleBuffer, typename Base::AllocatorType>;
+
         SingleBufferStreamPool (uint32_t size) :
             m_pool{size}
         {}
         SingleBufferStreamPool (SingleBufferStreamPool&& other)
-            : m_pool{std::move(other.m_pool[0])}
+            : m_pool{std::move(other.m_pool)}
         {}
         virtual ~SingleBufferStreamPool () {}
 
@@ -154,8 +258,7 @@ namespace memory {
         template <typename OtherPool>
         void copyInto (OtherPool& destination) const
         {
-            using Pool = typename Base::PoolType;
-            destination.template pushAll<Pool>(m_pool);
+            destination.pushAll(m_pool);
         }
 
         std::byte* push (entt::hashed_string::hash_type event_id, uint32_t payload_size)
@@ -164,7 +267,7 @@ namespace memory {
         }
 
     private:
-        typename Base::PoolType m_pool;
+        PoolType m_pool;
     };
 
     template <typename Pool>
@@ -209,20 +312,29 @@ namespace memory {
     class MessagePublisher : public million::events::Publisher
     {
     public:
-        MessagePublisher () : m_pool{nullptr} {}
-        MessagePublisher (Pool* pool) : m_pool{pool} {}
-        MessagePublisher(MessagePublisher<Pool>&& other) : m_pool(other.m_pool) { other.m_pool = nullptr; }
+        MessagePublisher () : m_pool{nullptr}, m_current_frame{nullptr} {}
+        MessagePublisher (Pool* pool, const std::atomic_uint64_t* current_frame) : m_pool{pool}, m_current_frame{current_frame} {}
+        MessagePublisher(MessagePublisher<Pool>&& other) : m_pool(other.m_pool), m_current_frame(other.m_current_frame) { other.m_pool = nullptr; }
         virtual ~MessagePublisher () {}
 
-        void operator= (MessagePublisher<Pool>&& other) { m_pool = other.m_pool; other.m_pool = nullptr; }
+        void operator= (MessagePublisher<Pool>&& other) { m_pool = other.m_pool; m_current_frame = other.m_current_frame; other.m_pool = nullptr; }
 
         bool valid () const { return m_pool != nullptr; }
 
-        std::byte* push (entt::hashed_string::hash_type event_id, std::uint32_t target, std::uint32_t flags, std::uint8_t payload_size)
+        std::byte* push (entt::hashed_string::hash_type event_id, std::uint32_t target, std::uint32_t flags, std::uint32_t payload_size)
         {
             return m_pool->push(event_id, target, flags, payload_size);
         }
+
+        std::byte* pushDelayed (entt::hashed_string::hash_type event_id, std::uint32_t target, std::uint32_t flags, std::uint32_t payload_size, std::uint64_t frame, bool relative)
+        {
+            if (relative) {
+                frame += m_current_frame->load(std::memory_order_relaxed);
+            }
+            return m_pool->pushDelayed(event_id, target, flags, payload_size, frame);
+        }
         
         Pool* m_pool;
+        const std::atomic_uint64_t* m_current_frame;
     };
 }
@@ -0,0 +1,117 @@
+#include "frame_arena.hpp"
+#include "budget.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace {
+    // A frame arena made of a chain of blocks. Once a frame overflows the first block, the chain is replaced by a
+    // single block large enough to hold everything, so that in steady state each frame allocates from one block.
+    class BlockFrameArena : public million::memory::FrameArena {
+    public:
+        BlockFrameArena (std::size_t block_size) : m_block_size(block_size), m_current(0), m_tracker("memory::FrameArena", block_size, block_size) {
+            m_blocks.push_back(Block{new std::byte[block_size], block_size});
+            activate(0);
+        }
+        virtual ~BlockFrameArena () {
+            for (auto& block : m_blocks) {
+                delete [] block.memory;
+            }
+        }
+
+        void reset () {
+            std::size_t used = m_next - reinterpret_cast<std::uintptr_t>(m_blocks[m_current].memory);
+            for (std::size_t index = 0; index < m_current; ++index) {
+                used += m_blocks[index].size;
+            }
+            m_tracker.used(used);
+            if (m_current > 0) {
+                // Last frame needed more than one block, combine them into one
+                std::size_t total = 0;
+                for (auto& block : m_blocks) {
+                    total += block.size;
+                    delete [] block.memory;
+                }
+                m_blocks.clear();
+                m_blocks.push_back(Block{new std::byte[total], total});
+                m_tracker.commit(total);
+                SPDLOG_DEBUG("[memory] Frame arena grown to {} bytes", total);
+            }
+            activate(0);
+        }
+
+    protected:
+        void* overflow (std::size_t bytes, std::size_t alignment) final {
+            const std::size_t required = bytes + alignment;
+            // Move on to the next block that is large enough, allocating one if there isn't one
+            std::size_t index = m_current + 1;
+            while (index < m_blocks.size() && m_blocks[index].size < required) {
+                ++index;
+            }
+            if (index == m_blocks.size()) {
+                const std::size_t size = std::max(m_block_size, required);
+                m_blocks.push_back(Block{new std::byte[size], size});
+                std::size_t total = 0;
+                for (auto& block : m_blocks) {
+                    total += block.size;
+                }
+                m_tracker.commit(total);
+            }
+            activate(index);
+            return allocate(bytes, alignment);
+        }
+
+    private:
+        struct Block {
+            std::byte* memory;
+            std::size_t size;
+        };
+        std::vector<Block> m_blocks;
+        const std::size_t m_block_size;
+        std::size_t m_current;
+        memory::budget::Tracker m_tracker;
+
+        void activate (std::size_t index) {
+            m_current = index;
+            m_next = reinterpret_cast<std::uintptr_t>(m_blocks[index].memory);
+            m_end = m_next + m_blocks[index].size;
+        }
+    };
+
+    std::mutex g_arenas_mutex;
+    std::vector<BlockFrameArena*> g_arenas;
+    thread_local BlockFrameArena* g_frame_arena = nullptr;
+}
+
+million::memory::FrameArena& memory::frameArena ()
+{
+    if EXPECT_NOT_TAKEN(g_frame_arena == nullptr) {
+        EASY_BLOCK("memory::frameArena", profiler::colors::Grey500);
+        // Lazily created, so that config has been read before the first arena is made
+        const std::uint32_t block_size = entt::monostate<"memory/frame-arena-size"_hs>();
+        memory::budget::Scope budget_scope(memory::budget::Subsystem::Frame, "per-thread frame arena");
+        std::lock_guard<std::mutex> guard(g_arenas_mutex);
+        g_frame_arena = new BlockFrameArena(block_size);
+        g_arenas.push_back(g_frame_arena);
+    }
+    return *g_frame_arena;
+}
+
+void memory::resetFrameArenas ()
+{
+    EASY_FUNCTION(profiler::colors::Grey500);
+    std::lock_guard<std::mutex> guard(g_arenas_mutex);
+    for (auto arena : g_arenas) {
+        arena->reset();
+    }
+}
+
+void memory::releaseFrameArenas ()
+{
+    std::lock_guard<std::mutex> guard(g_arenas_mutex);
+    for (auto arena : g_arenas) {
+        delete arena;
+    }
+    g_arenas.clear();
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <million/types.hpp>
+
+// Per-thread scratch arenas, released in bulk at the start of every frame.
+// Each thread gets its own arena the first time it asks for one, so allocation needs no synchronisation.
+namespace memory {
+
+    // Get the calling thread's frame arena
+    million::memory::FrameArena& frameArena ();
+
+    // Release everything allocated from every thread's arena. Must only be called while no other thread is using its arena.
+    void resetFrameArenas ();
+
+    // Free all arenas, called on shutdown
+    void releaseFrameArenas ();
+}
@@ -0,0 +1,130 @@
+#include "heaps.hpp"
+
+#ifdef WITH_MIMALLOC
+
+#include <mimalloc.h>
+
+#include <atomic>
+#include <new>
+
+namespace {
+    thread_local memory::heaps::Subsystem g_current_subsystem = memory::heaps::Subsystem::General;
+    thread_local mi_heap_t* g_heaps[memory::heaps::NUM_SUBSYSTEMS] = {};
+
+    std::atomic_uint64_t g_allocations[memory::heaps::NUM_SUBSYSTEMS];
+    std::atomic_uint64_t g_bytes[memory::heaps::NUM_SUBSYSTEMS];
+
+    inline mi_heap_t* currentHeap ()
+    {
+        const auto index = std::size_t(g_current_subsystem);
+        mi_heap_t* heap = g_heaps[index];
+        if (heap == nullptr) {
+            // General allocations use the thread's default heap, subsystems get their own heap the first time this thread uses them
+            heap = index == 0 ? mi_heap_get_default() : mi_heap_new();
+            g_heaps[index] = heap;
+        }
+        return heap;
+    }
+
+    inline void* allocate (std::size_t size, bool nothrow)
+    {
+        void* ptr = mi_heap_malloc(currentHeap(), size);
+        if (ptr == nullptr && ! nothrow) {
+            throw std::bad_alloc();
+        }
+        if (g_current_subsystem != memory::heaps::Subsystem::General) {
+            // Only scoped allocations are counted, to keep shared counters off the hot path
+            const auto index = std::size_t(g_current_subsystem);
+            g_allocations[index].fetch_add(1, std::memory_order_relaxed);
+            g_bytes[index].fetch_add(size, std::memory_order_relaxed);
+        }
+        return ptr;
+    }
+
+    inline void* allocateAligned (std::size_t size, std::align_val_t alignment, bool nothrow)
+    {
+        void* ptr = mi_heap_malloc_aligned(currentHeap(), size, static_cast<std::size_t>(alignment));
+        if (ptr == nullptr && ! nothrow) {
+            throw std::bad_alloc();
+        }
+        if (g_current_subsystem != memory::heaps::Subsystem::General) {
+            const auto index = std::size_t(g_current_subsystem);
+            g_allocations[index].fetch_add(1, std::memory_order_relaxed);
+            g_bytes[index].fetch_add(size, std::memory_order_relaxed);
+        }
+        return ptr;
+    }
+}
+
+// Global allocation functions. mi_free can release memory from any heap, on any thread.
+void* operator new (std::size_t size) { return allocate(size, false); }
+void* operator new[] (std::size_t size) { return allocate(size, false); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, true); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, true); }
+void* operator new (std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment, false); }
+void* operator new[] (std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment, false); }
+void* operator new (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateAligned(size, alignment, true); }
+void* operator new[] (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateAligned(size, alignment, true); }
+
+void operator delete (void* ptr) noexcept { mi_free(ptr); }
+void operator delete[] (void* ptr) noexcept { mi_free(ptr); }
+void operator delete (void* ptr, std::size_t) noexcept { mi_free(ptr); }
+void operator delete[] (void* ptr, std::size_t) noexcept { mi_free(ptr); }
+void operator delete (void* ptr, std::align_val_t) noexcept { mi_free(ptr); }
+void operator delete[] (void* ptr, std::align_val_t) noexcept { mi_free(ptr); }
+void operator delete (void* ptr, std::size_t, std::align_val_t) noexcept { mi_free(ptr); }
+void operator delete[] (void* ptr, std::size_t, std::align_val_t) noexcept { mi_free(ptr); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept { mi_free(ptr); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept { mi_free(ptr); }
+void operator delete (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { mi_free(ptr); }
+void operator delete[] (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { mi_free(ptr); }
+
+memory::heaps::Scope::Scope (memory::heaps::Subsystem subsystem) :
+    m_previous(g_current_subsystem)
+{
+    g_current_subsystem = subsystem;
+}
+
+memory::heaps::Scope::~Scope ()
+{
+    g_current_subsystem = m_previous;
+}
+
+memory::heaps::Stats memory::heaps::stats (memory::heaps::Subsystem subsystem)
+{
+    const auto index = std::size_t(subsystem);
+    return {g_allocations[index].load(std::memory_order_relaxed), g_bytes[index].load(std::memory_order_relaxed)};
+}
+
+void memory::heaps::collect ()
+{
+    mi_collect(true);
+}
+
+void memory::heaps::report ()
+{
+    for (auto subsystem : magic_enum::enum_values<memory::heaps::Subsystem>()) {
+        if (subsystem != memory::heaps::Subsystem::General) {
+            const auto subsystem_stats = stats(subsystem);
+            spdlog::info("[memory] {} heap: {} allocations, {} bytes allocated", magic_enum::enum_name(subsystem), subsystem_stats.allocations, subsystem_stats.bytes);
+        }
+    }
+}
+
+#else
+
+memory::heaps::Stats memory::heaps::stats (memory::heaps::Subsystem)
+{
+    return {0, 0};
+}
+
+void memory::heaps::collect ()
+{
+}
+
+void memory::heaps::report ()
+{
+    SPDLOG_DEBUG("[memory] Not built with mimalloc, no heap statistics available");
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Per-subsystem heaps, only active when built with mimalloc (CONFIG_WITH_MIMALLOC=y, which defines WITH_MIMALLOC).
+// In that build, global new and delete are routed through mimalloc, and allocations made inside a heaps::Scope are served from
+// a heap belonging to that subsystem. mimalloc heaps are owned by a single thread, so each thread gets its own heap per subsystem.
+// Without mimalloc, scopes compile to nothing and no statistics are collected.
+namespace memory::heaps {
+
+    enum class Subsystem : std::uint8_t {
+        General = 0,
+        World,
+        Resources,
+        Scripting,
+    };
+    constexpr std::size_t NUM_SUBSYSTEMS = 4;
+
+    struct Stats {
+        std::uint64_t allocations;
+        std::uint64_t bytes;
+    };
+
+    // Attribute allocations made by the current thread to a subsystem, for the lifetime of the scope. Scopes may be nested.
+    class Scope {
+    public:
+#ifdef WITH_MIMALLOC
+        Scope (Subsystem subsystem);
+        ~Scope ();
+#else
+        Scope (Subsystem) {}
+        ~Scope () {}
+#endif
+        Scope (const Scope&) = delete;
+        Scope& operator= (const Scope&) = delete;
+
+#ifdef WITH_MIMALLOC
+    private:
+        Subsystem m_previous;
+#endif
+    };
+
+    // Total allocations made within scopes of a subsystem, by all threads
+    Stats stats (Subsystem subsystem);
+
+    // Return memory freed by the calling thread to the OS
+    void collect ();
+
+    // Log allocation statistics for each subsystem
+    void report ();
+}
@@ -26,12 +26,14 @@ namespace heterogeneous {
             using ItemAlignType = ItemAlign;
             using OutOfSpacePolicyType = OutOfSpacePolicy;
 
-            BaseStackPool (std::uint32_t size) :
-                size(PoolAlign::adjust_size(size)),
-                buffer(new std::byte[size]),
+            BaseStackPool (std::uint32_t size, const char* type) :
+                tracker(type, PoolAlign::adjust_size(size), PoolAlign::adjust_size(size)),
+                size(size),
+                buffer(new std::byte[PoolAlign::adjust_size(size)]), // Leave room to align the base
                 base(PoolAlign::template align<std::byte>(buffer))
             {}
             BaseStackPool (BaseStackPool&& other) :
+                tracker(std::move(other.tracker)),
                 size(other.size),
                 buffer(other.buffer),
                 base(other.base)
@@ -51,7 +53,7 @@ namespace heterogeneous {
                     std::byte* ptr = base + next;
                     return ptr;
                 } else {
-                    return OutOfSpacePolicy::template apply<std::byte>("heterogeneous::StackPool");
+                    return OutOfSpacePolicy::template apply<std::byte>(tracker.describe());
                 }
             }
 
@@ -71,9 +73,15 @@ namespace heterogeneous {
             }
 
             void reset () {
+                tracker.used(std::min(fetch(), size));
                 put(0);
             }
 
+            // Discard everything allocated past `offset` bytes from the start of the pool
+            void rewind (std::uint32_t offset) {
+                put(offset);
+            }
+
             std::uint32_t remaining () const {
                 return size - fetch();
             }
@@ -93,7 +101,7 @@ namespace heterogeneous {
                         std::memcpy(reinterpret_cast<void*>(base + next), reinterpret_cast<const void*>(other.base), other_next);
                     }
                 } else {
-                    OutOfSpacePolicy::template apply<void>("heterogeneous::StackPool");
+                    OutOfSpacePolicy::template apply<void>(tracker.describe());
                 }
             }
 
@@ -106,6 +114,7 @@ namespace heterogeneous {
             }
 
         private:
+            budget::Tracker tracker;
             const std::uint32_t size;
             std::byte* buffer;
             std::byte* const base;
@@ -125,7 +134,7 @@ namespace heterogeneous {
         void put (std::uint32_t value) final { next = value; }
         std::uint32_t next;
     public:
-        StackPool (std::uint32_t size) : impl::BaseStackPool<PoolAlign, ItemAlign, OutOfSpacePolicy>(size), next(0) {}
+        StackPool (std::uint32_t size) : impl::BaseStackPool<PoolAlign, ItemAlign, OutOfSpacePolicy>(size, "heterogeneous::StackPool"), next(0) {}
         StackPool (StackPool&& other) : impl::BaseStackPool<PoolAlign, ItemAlign, OutOfSpacePolicy>(std::move(other)), next(other.next) {}
         virtual ~StackPool() {}
     };
@@ -137,10 +146,327 @@ namespace heterogeneous {
         std::uint32_t fetch () const final { return next.load(); }
         std::uint32_t fetch_add (std::uint32_t amount) final { return next.fetch_add(amount); }
         void put (std::uint32_t value) final { next.store(value); }
-        std::atomic_uint32_t next;
+        // Kept on its own cache line, so that writers bumping it don't invalidate the line holding size, buffer and base
+        alignas(alignment::AlignCacheLine::Bountary) std::atomic_uint32_t next;
     public:
-        AtomicStackPool (std::uint32_t size) : impl::BaseStackPool<PoolAlign, ItemAlign, OutOfSpacePolicy>(size), next(0) {}
+        AtomicStackPool (std::uint32_t size) : impl::BaseStackPool<PoolAlign, ItemAlign, OutOfSpacePolicy>(size, "heterogeneous::AtomicStackPool"), next(0) {}
         AtomicStackPool (AtomicStackPool&& other) : impl::BaseStackPool<PoolAlign, ItemAlign, OutOfSpacePolicy>(std::move(other)), next(other.next) {}
         virtual ~AtomicStackPool() {}
     };
+
+    // Same as AtomicStackPool, but each thread reserves a chunk of `ChunkSize` bytes with a single atomic add and then allocates from it
+    // without touching shared state, so writers never share cache lines. Each chunk starts with a header recording how much of it is used,
+    // allowing the contents to be iterated without gaps using eachChunk(). Allocations larger than a chunk get a chunk of their own.
+    // Threads beyond the first MaxThreads share a chunk under a lock. reset() must not be called concurrently with anything else.
+    template <typename PoolAlign = alignment::NoAlign, typename ItemAlign = alignment::NoAlign, typename OutOfSpacePolicy = out_of_space_policies::Throw, std::uint32_t ChunkSize = 4096, std::uint32_t MaxThreads = 64>
+    class ChunkedAtomicStackPool {
+    private:
+        static_assert((ChunkSize & (ChunkSize - 1)) == 0, "ChunkedAtomicStackPool chunk size must be a power of two");
+
+        struct ChunkHeader {
+            std::uint32_t size; // Size of chunk in bytes, including header
+            std::uint32_t used; // Bytes allocated after the header
+        };
+        struct alignas(alignment::AlignCacheLine::Bountary) Cursor {
+            std::uint32_t epoch = 0;
+            std::uint32_t chunk = 0; // Offset of the current chunk
+            std::uint32_t next = 0;  // Offset of the next free byte
+            std::uint32_t end = 0;   // Offset of the end of the current chunk
+        };
+
+        template <typename T>
+        T* alloc () {
+            return ItemAlign::template align<T>(unaligned_allocate(ItemAlign::adjust_size(sizeof(T))));
+        }
+
+        std::byte* allocateFrom (Cursor& cursor, std::uint32_t bytes) {
+            if (cursor.epoch != epoch || cursor.next + bytes > cursor.end) {
+                // Claim a new chunk, large enough for the allocation
+                const std::uint32_t chunk_size = (std::uint32_t(sizeof(ChunkHeader)) + bytes + ChunkSize - 1) & ~(ChunkSize - 1);
+                const std::uint32_t chunk = next.fetch_add(chunk_size);
+                if (chunk + chunk_size > size) {
+                    if (chunk + sizeof(ChunkHeader) <= size) {
+                        // Only the thread whose claim straddles the end sees this, mark the rest of the pool as an empty chunk so iteration stops cleanly
+                        new (base + chunk) ChunkHeader{size - chunk, 0};
+                    }
+                    return OutOfSpacePolicy::template apply<std::byte>(tracker.describe());
+                }
+                new (base + chunk) ChunkHeader{chunk_size, 0};
+                cursor = Cursor{epoch, chunk, chunk + std::uint32_t(sizeof(ChunkHeader)), chunk + chunk_size};
+            }
+            std::byte* ptr = base + cursor.next;
+            cursor.next += bytes;
+            reinterpret_cast<ChunkHeader*>(base + cursor.chunk)->used = cursor.next - cursor.chunk - std::uint32_t(sizeof(ChunkHeader));
+            return ptr;
+        }
+
+    public:
+        ChunkedAtomicStackPool (std::uint32_t size) :
+            tracker("heterogeneous::ChunkedAtomicStackPool", PoolAlign::adjust_size(size), PoolAlign::adjust_size(size)),
+            size(size),
+            buffer(new std::byte[PoolAlign::adjust_size(size)]),
+            base(PoolAlign::template align<std::byte>(buffer)),
+            cursors(new Cursor[MaxThreads]),
+            epoch(1),
+            next(0)
+        {}
+        ~ChunkedAtomicStackPool() {
+            delete [] cursors;
+            delete [] buffer;
+        }
+
+        // Allocate, but don't construct
+        std::byte* unaligned_allocate (std::uint32_t bytes) {
+            const auto thread = homogeneous::detail::threadIndex();
+            if (thread < MaxThreads) {
+                return allocateFrom(cursors[thread], bytes);
+            } else {
+                std::lock_guard<std::mutex> guard(shared_cursor_mutex);
+                return allocateFrom(shared_cursor, bytes);
+            }
+        }
+
+        std::byte* allocate (std::uint32_t bytes) {
+            return ItemAlign::template align<std::byte>(unaligned_allocate(ItemAlign::adjust_size(bytes)));
+        }
+
+        // Allocate and construct
+        template <typename T, typename... Args>
+        T* emplace (Args&&... args) {
+            return new(alloc<T>()) T{args...};
+        }
+
+        template <typename T>
+        void push_back (const T& item) {
+            new(alloc<T>()) T{item};
+        }
+
+        void reset () {
+            tracker.used(std::min(next.load(), size));
+            // Invalidate every thread's current chunk
+            ++epoch;
+            next.store(0);
+        }
+
+        // Call `fn(std::byte* begin, std::byte* end)` for the allocated part of each chunk, in address order.
+        // Must not be called while other threads allocate: a chunk is claimed before its header is written, so a concurrent claim can be
+        // seen with a header that isn't there yet.
+        template <typename Function>
+        void eachChunk (Function fn) const {
+            const std::uint32_t end = std::min(next.load(), size);
+            std::uint32_t chunk = 0;
+            // When the pool's size is not a multiple of ChunkSize, the tail may be too small to have been given a header
+            while (end - chunk >= std::uint32_t(sizeof(ChunkHeader))) {
+                const auto& header = *reinterpret_cast<const ChunkHeader*>(base + chunk);
+                std::byte* data = base + chunk + sizeof(ChunkHeader);
+                fn(data, data + header.used);
+                chunk += header.size;
+            }
+        }
+
+        std::uint32_t remaining () const {
+            return size - std::min(next.load(), size);
+        }
+
+        std::uint32_t capacity () const {
+            return size;
+        }
+
+    private:
+        budget::Tracker tracker;
+        const std::uint32_t size;
+        std::byte* const buffer;
+        std::byte* const base;
+        Cursor* const cursors;
+        Cursor shared_cursor;
+        std::mutex shared_cursor_mutex;
+        std::uint32_t epoch;
+        alignas(alignment::AlignCacheLine::Bountary) std::atomic_uint32_t next;
+    };
+
+    // Same as AtomicStackPool, but instead of allocating its buffer up front, reserves a large range of virtual address space and
+    // commits it in chunks of `commit_size` bytes as allocations cross into them. Nothing is resident until it is used, pointers stay
+    // stable as the pool grows and the reservation can be made far larger than the pool is ever expected to need, making overflow rare.
+    // If usage stays below a quarter of the committed memory for `trim_after` consecutive resets, reset() returns the excess to the OS.
+    template <typename ItemAlign = alignment::NoAlign, typename OutOfSpacePolicy = out_of_space_policies::Throw>
+    class VirtualStackPool {
+    private:
+        template <typename T>
+        T* alloc () {
+            return ItemAlign::template align<T>(unaligned_allocate(ItemAlign::adjust_size(sizeof(T))));
+        }
+
+        static std::uint64_t pageSize () {
+            static const std::uint64_t page_size = std::uint64_t(sysconf(_SC_PAGESIZE));
+            return page_size;
+        }
+
+        static std::uint64_t roundToPages (std::uint64_t bytes, std::uint64_t granularity) {
+            return ((bytes + granularity - 1) / granularity) * granularity;
+        }
+
+        static std::byte* reserve (std::uint64_t bytes) {
+            void* ptr = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (ptr == MAP_FAILED) {
+                throw std::runtime_error("heterogeneous::VirtualStackPool could not reserve address space");
+            }
+            return reinterpret_cast<std::byte*>(ptr);
+        }
+
+        // Make memory up to `end` bytes from the start of the pool accessible. Only one thread commits at a time, any thread that
+        // raced it to the same chunk will find it already committed once it acquires the lock.
+        bool commit (std::uint64_t end) {
+            std::lock_guard<std::mutex> guard(m_commit_mutex);
+            const std::uint64_t committed = m_committed.load(std::memory_order_relaxed);
+            if (end <= committed) {
+                return true;
+            }
+            const std::uint64_t new_committed = std::min(roundToPages(end, m_commit_size), m_reserved);
+            if (mprotect(m_base + committed, new_committed - committed, PROT_READ | PROT_WRITE) != 0) {
+                return false;
+            }
+            m_tracker.commit(new_committed);
+            m_committed.store(new_committed, std::memory_order_release);
+            return true;
+        }
+
+        // Release committed memory beyond what was used recently
+        void trim () {
+            const std::uint64_t committed = m_committed.load(std::memory_order_relaxed);
+            const std::uint64_t keep = std::min(roundToPages(std::max<std::uint64_t>(m_recent_peak, 1), m_commit_size), m_reserved);
+            if (keep < committed) {
+                madvise(m_base + keep, committed - keep, MADV_DONTNEED);
+                mprotect(m_base + keep, committed - keep, PROT_NONE);
+                m_committed.store(keep, std::memory_order_release);
+                m_tracker.commit(keep);
+                SPDLOG_TRACE("heterogeneous::VirtualStackPool released {} bytes", committed - keep);
+            }
+        }
+
+    public:
+        VirtualStackPool (std::uint32_t reserve_size, std::uint32_t commit_size = 65536, std::uint32_t trim_after = 256) :
+            m_reserved(roundToPages(reserve_size, pageSize())),
+            m_commit_size(roundToPages(commit_size, pageSize())),
+            m_trim_after(trim_after),
+            m_tracker("heterogeneous::VirtualStackPool", m_reserved, 0),
+            m_base(reserve(m_reserved)),
+            m_next(0),
+            m_committed(0),
+            m_recent_peak(0),
+            m_low_usage_resets(0)
+        {}
+        VirtualStackPool (VirtualStackPool&& other) :
+            m_reserved(other.m_reserved),
+            m_commit_size(other.m_commit_size),
+            m_trim_after(other.m_trim_after),
+            m_tracker(std::move(other.m_tracker)),
+            m_base(other.m_base),
+            m_next(other.m_next.load()),
+            m_committed(other.m_committed.load()),
+            m_recent_peak(other.m_recent_peak),
+            m_low_usage_resets(other.m_low_usage_resets)
+        {
+            other.m_base = nullptr;
+        }
+        ~VirtualStackPool() {
+            if (m_base) {
+                munmap(m_base, m_reserved);
+            }
+        }
+
+        // Allocate, but don't construct
+        std::byte* unaligned_allocate (std::uint32_t bytes) {
+            const std::uint64_t next = m_next.fetch_add(bytes);
+            const std::uint64_t end = next + bytes;
+            if (end <= m_committed.load(std::memory_order_acquire) || (end <= m_reserved && commit(end))) {
+                return m_base + next;
+            } else {
+                return OutOfSpacePolicy::template apply<std::byte>(m_tracker.describe());
+            }
+        }
+
+        std::byte* allocate (std::uint32_t bytes) {
+            return ItemAlign::template align<std::byte>(unaligned_allocate(ItemAlign::adjust_size(bytes)));
+        }
+
+        // Allocate and construct
+        template <typename T, typename... Args>
+        T* emplace (Args&&... args) {
+            return new(alloc<T>()) T{args...};
+        }
+
+        template <typename T>
+        void push_back (const T& item) {
+            new(alloc<T>()) T{item};
+        }
+
+        // Must not be called while other threads are allocating
+        void reset () {
+            const std::uint64_t used = std::min<std::uint64_t>(m_next.load(), m_reserved);
+            m_tracker.used(used);
+            if (used * 4 < m_committed.load(std::memory_order_relaxed)) {
+                m_recent_peak = std::max(m_recent_peak, used);
+                if (++m_low_usage_resets >= m_trim_after) {
+                    trim();
+                    m_low_usage_resets = 0;
+                    m_recent_peak = 0;
+                }
+            } else {
+                m_low_usage_resets = 0;
+                m_recent_peak = 0;
+            }
+            m_next.store(0);
+        }
+
+        // Discard everything allocated past `offset` bytes from the start of the pool
+        void rewind (std::uint32_t offset) {
+            m_next.store(offset);
+        }
+
+        std::uint32_t remaining () const {
+            return std::uint32_t(m_reserved - std::min<std::uint64_t>(m_next.load(), m_reserved));
+        }
+
+        std::uint32_t capacity () const {
+            return std::uint32_t(m_reserved);
+        }
+
+        // Bytes currently backed by memory
+        std::uint32_t committed () const {
+            return std::uint32_t(m_committed.load());
+        }
+
+        // Copy the contents of another stack pool into this pool
+        // WARNING: `other` must not be reset while copy() is in progress. `other` may be added to, but this new memory will not be copied.
+        template <typename SP>
+        void pushAll (const SP& other) {
+            const std::uint32_t other_next = std::uint32_t(other.end() - other.begin());
+            if (other_next > 0) { // Only copy if there is data to copy
+                std::byte* ptr = unaligned_allocate(other_next);
+                if (ptr) {
+                    std::memcpy(reinterpret_cast<void*>(ptr), reinterpret_cast<const void*>(other.begin()), other_next);
+                }
+            }
+        }
+
+        std::byte* begin () const {
+            return m_base;
+        }
+
+        std::byte* end () const {
+            return m_base + m_next.load();
+        }
+
+    private:
+        const std::uint64_t m_reserved;
+        const std::uint64_t m_commit_size;
+        const std::uint32_t m_trim_after;
+        budget::Tracker m_tracker;
+        std::byte* m_base;
+        std::atomic_uint32_t m_next;
+        std::atomic_uint64_t m_committed;
+        std::mutex m_commit_mutex;
+        std::uint64_t m_recent_peak;
+        std::uint32_t m_low_usage_resets;
+    };
 }
\ No newline at end of file
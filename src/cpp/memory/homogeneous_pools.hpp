@@ -7,6 +7,8 @@
 #include <stdexcept>
 #include <new>
 #include <atomic>
+#include <algorithm>
+#include <cstring>
 
 namespace homogeneous {
 
@@ -25,7 +27,7 @@ namespace homogeneous {
                 if (next < size) {
                     return pool + next;
                 } else {
-                    return OutOfSpacePolicy::template apply<T>("homogeneous::BaseStackPool");
+                    return OutOfSpacePolicy::template apply<T>(tracker.describe());
                 }
             }
         public:
@@ -33,13 +35,15 @@ namespace homogeneous {
             using AlignType = Align;
             using OutOfSpacePolicyType = OutOfSpacePolicy;
 
-            BaseStackPool (std::uint32_t size) :
+            BaseStackPool (std::uint32_t size, const char* type) :
+                tracker(type, Align::adjust_size(sizeof(T) * size), Align::adjust_size(sizeof(T) * size)),
                 memory(new std::byte[Align::adjust_size(sizeof(T) * size)]),
                 pool(Align::template align<T>(memory)),
                 size(size) {
 
             }
             BaseStackPool (BaseStackPool&& other) :
+                tracker(std::move(other.tracker)),
                 memory(other.memory),
                 pool(other.pool),
                 size(other.size)
@@ -74,6 +78,7 @@ namespace homogeneous {
                         ++it;
                     }
                 }
+                tracker.used(sizeof(T) * std::min(fetch(), size));
                 put(0);
             }
 
@@ -108,7 +113,7 @@ namespace homogeneous {
             // Copy buffer into StackPool
             void pushAll (T* buffer, uint32_t count) {
                 if (remaining() < count) {
-                    OutOfSpacePolicy::template apply<void>("homogeneous::BaseStackPool");
+                    OutOfSpacePolicy::template apply<void>(tracker.describe());
                 }
                 // TODO: benchmark copy_n, copy, memmove and memcpy
                 std::copy_n(buffer, count, end());
@@ -123,6 +128,7 @@ namespace homogeneous {
             }
 
         private:
+            budget::Tracker tracker;
             std::byte* const memory;
             T* const pool;
             const std::uint32_t size;
@@ -140,7 +146,7 @@ namespace homogeneous {
         void put (std::uint32_t value) final { next = value; }
         std::uint32_t next;
     public:
-        StackPool (std::uint32_t size) : impl::BaseStackPool<T, Align, OutOfSpacePolicy>(size), next(0) {}
+        StackPool (std::uint32_t size) : impl::BaseStackPool<T, Align, OutOfSpacePolicy>(size, "homogeneous::StackPool"), next(0) {}
         StackPool (StackPool&& other) : impl::BaseStackPool<T, Align, OutOfSpacePolicy>(std::move(other)), next(other.next) {}
         virtual ~StackPool() {}
     };
@@ -155,13 +161,14 @@ namespace homogeneous {
         void put (std::uint32_t value) final { next.store(value); }
         std::atomic_uint32_t next;
     public:
-        AtomicStackPool (std::uint32_t size) : impl::BaseStackPool<T, Align, OutOfSpacePolicy>(size), next(0) {}
+        AtomicStackPool (std::uint32_t size) : impl::BaseStackPool<T, Align, OutOfSpacePolicy>(size, "homogeneous::AtomicStackPool"), next(0) {}
         AtomicStackPool (AtomicStackPool&& other) : impl::BaseStackPool<T, Align, OutOfSpacePolicy>(std::move(other)), next(other.next) {}
         virtual ~AtomicStackPool() {}
     };
 
 
     // A free-list based pool. Objects can be allocated and deallocated, unused space will be reused. Pointers to elements are stable until reset() is called.
+    // Items that have never been used are handed out from a bump pointer, so reset() is O(1).
     template <typename T, typename Align = alignment::NoAlign, typename OutOfSpacePolicy = out_of_space_policies::Throw>
     class Pool {
     private:
@@ -171,8 +178,11 @@ namespace homogeneous {
                 next = next->next;
                 --free;
                 return &item->object;
+            } else if (top < size) {
+                --free;
+                return &pool[top++].object;
             } else {
-                return OutOfSpacePolicy::template apply<T>("homogeneous::Pool");
+                return OutOfSpacePolicy::template apply<T>(tracker.describe());
             }
         }
     public:
@@ -180,15 +190,19 @@ namespace homogeneous {
         using Type = T;
 
         Pool (std::uint32_t size) :
-            memory(new std::byte[Align::adjust_size(sizeof(T) * size)]),
+            tracker("homogeneous::Pool", Align::adjust_size(sizeof(Item) * size), Align::adjust_size(sizeof(Item) * size)),
+            memory(new std::byte[Align::adjust_size(sizeof(Item) * size)]),
             pool(reinterpret_cast<Item*>(Align::template align<T>(memory))),
+            top(0),
             size(size) {
             reset();
         }
         Pool (Pool&& other) :
+            tracker(std::move(other.tracker)),
             memory(other.memory),
             pool(other.pool),
             next(other.next),
+            top(other.top),
             free(other.free),
             size(other.size)
         {
@@ -213,7 +227,7 @@ namespace homogeneous {
         void discard (T* object) {
             std::uint64_t addr = reinterpret_cast<std::uint64_t>(object);
             std::uint64_t first =  reinterpret_cast<std::uint64_t>(pool);
-            if (addr < first || addr > first + (sizeof(Item) * size)) {
+            if (addr < first || addr >= first + (sizeof(Item) * size)) {
                 throw std::runtime_error("Pool discarded object not belonging to pool");
             }
             Item* item = reinterpret_cast<Item*>(object);
@@ -223,11 +237,9 @@ namespace homogeneous {
         }
 
         void reset () {
-            for (Item* item = pool; item < pool + size; ++item) {
-                item->next = item + 1;
-            }
-            pool[size-1].next = nullptr;
-            next = pool;
+            tracker.used(sizeof(Item) * top);
+            next = nullptr;
+            top = 0;
             free = size;
         }
 
@@ -244,6 +256,7 @@ namespace homogeneous {
         }
 
     private:
+        budget::Tracker tracker;
         std::byte* memory;
         union Item {
             T object;
@@ -251,11 +264,243 @@ namespace homogeneous {
         };
         Item* const pool;
         Item* next;
+        std::uint32_t top; // Items from here on have never been allocated since the last reset
         std::uint32_t free;
         const std::uint32_t size;
     };
 
 
+    namespace detail {
+        // A small, dense index identifying the calling thread, used to select per-thread caches
+        inline std::uint32_t threadIndex () {
+            static std::atomic_uint32_t next_index{0};
+            thread_local std::uint32_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+            return index;
+        }
+    }
+
+    // A thread safe free-list based pool. Each thread allocates from, and discards into, its own magazine (a small cache of free items)
+    // which is refilled from, or drained into, a shared lock-free stack in batches, so that most operations touch no shared state.
+    // Threads beyond the first MaxThreads use the shared stack directly. Items that have never been used are handed out from a bump pointer,
+    // so reset() is O(1). Pointers to elements are stable until reset() is called. reset() must not be called concurrently with anything else.
+    template <typename T, typename Align = alignment::NoAlign, typename OutOfSpacePolicy = out_of_space_policies::Throw, std::uint32_t MagazineSize = 32, std::uint32_t MaxThreads = 64>
+    class ConcurrentPool {
+    private:
+        static_assert(MagazineSize >= 2 && MagazineSize % 2 == 0, "ConcurrentPool magazine size must be a positive multiple of 2");
+        static constexpr std::uint32_t BatchSize = MagazineSize / 2;
+
+        // The links of the shared stack are kept apart from the items, in `links`, rather than in a union with the object: a popBatch() that
+        // is going to lose its CAS may still be walking items that another thread has popped and is writing an object into.
+        struct Item {
+            T object;
+        };
+        struct alignas(alignment::AlignCacheLine::Bountary) Magazine {
+            std::uint32_t epoch = 0;
+            std::uint32_t count = 0;
+            std::uint32_t items[MagazineSize];
+        };
+
+        [[nodiscard]] T* allocate () {
+            const auto thread = detail::threadIndex();
+            std::uint32_t index;
+            if (thread < MaxThreads) {
+                Magazine& magazine = activeMagazine(thread);
+                if (magazine.count == 0) {
+                    refill(magazine);
+                }
+                if (magazine.count > 0) {
+                    return &pool[magazine.items[--magazine.count]].object;
+                }
+            } else if (popBatch(&index, 1) || bump(&index, 1)) {
+                return &pool[index].object;
+            }
+            return OutOfSpacePolicy::template apply<T>(tracker.describe());
+        }
+
+        Magazine& activeMagazine (std::uint32_t thread) {
+            Magazine& magazine = magazines[thread];
+            if (magazine.epoch != epoch) {
+                // Pool was reset since this magazine was last used, so its contents are stale
+                magazine.epoch = epoch;
+                magazine.count = 0;
+            }
+            return magazine;
+        }
+
+        void refill (Magazine& magazine) {
+            magazine.count = popBatch(magazine.items, BatchSize);
+            if (magazine.count == 0) {
+                magazine.count = bump(magazine.items, BatchSize);
+            }
+        }
+
+        // Take up to `max` never used items
+        std::uint32_t bump (std::uint32_t* out, std::uint32_t max) {
+            if (top.load(std::memory_order_relaxed) >= size) {
+                return 0;
+            }
+            const std::uint32_t first = top.fetch_add(max, std::memory_order_relaxed);
+            if (first >= size) {
+                return 0;
+            }
+            const std::uint32_t count = std::min(max, size - first);
+            // Reverse order, so that lower addresses are handed out first
+            for (std::uint32_t i = 0; i < count; ++i) {
+                out[i] = first + count - 1 - i;
+            }
+            return count;
+        }
+
+        // Index + 1 of the item after `index` in the shared stack, 0 if last. Ordered by the acquire and release on the head.
+        std::uint32_t link (std::uint32_t index) const {
+            return links[index].load(std::memory_order_relaxed);
+        }
+        void setLink (std::uint32_t index, std::uint32_t next) {
+            links[index].store(next, std::memory_order_relaxed);
+        }
+
+        // Pop up to `max` items from the shared stack with a single CAS. The head is tagged with a counter to avoid ABA problems.
+        std::uint32_t popBatch (std::uint32_t* out, std::uint32_t max) {
+            std::uint64_t head = free_head.load(std::memory_order_acquire);
+            while (true) {
+                std::uint32_t count = 0;
+                std::uint32_t next = std::uint32_t(head);
+                while (next != 0 && count < max) {
+                    out[count++] = next - 1;
+                    next = link(next - 1);
+                }
+                if (count == 0) {
+                    return 0;
+                }
+                if (free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    shared_free.fetch_sub(count, std::memory_order_relaxed);
+                    return count;
+                }
+            }
+        }
+
+        // Link items into a chain and splice the chain onto the shared stack with a single CAS
+        void pushBatch (const std::uint32_t* items, std::uint32_t count) {
+            for (std::uint32_t i = 0; i + 1 < count; ++i) {
+                setLink(items[i], items[i + 1] + 1);
+            }
+            std::uint64_t head = free_head.load(std::memory_order_relaxed);
+            do {
+                setLink(items[count - 1], std::uint32_t(head));
+            } while (! free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | (items[0] + 1), std::memory_order_release, std::memory_order_relaxed));
+            shared_free.fetch_add(count, std::memory_order_relaxed);
+        }
+
+    public:
+        static_assert(std::is_trivial<T>::value, "ConcurrentPool<T> must contain a trivial type");
+        using Type = T;
+
+        ConcurrentPool (std::uint32_t size) :
+            tracker("homogeneous::ConcurrentPool", Align::adjust_size(sizeof(Item) * size) + sizeof(std::atomic_uint32_t) * size, Align::adjust_size(sizeof(Item) * size) + sizeof(std::atomic_uint32_t) * size),
+            memory(new std::byte[Align::adjust_size(sizeof(Item) * size)]),
+            pool(reinterpret_cast<Item*>(Align::template align<T>(memory))),
+            links(new std::atomic_uint32_t[size]),
+            magazines(new Magazine[MaxThreads]),
+            top(0),
+            free_head(0),
+            shared_free(0),
+            epoch(1),
+            size(size)
+        {}
+        ConcurrentPool (ConcurrentPool&& other) :
+            tracker(std::move(other.tracker)),
+            memory(other.memory),
+            pool(other.pool),
+            links(other.links),
+            magazines(other.magazines),
+            top(other.top.load()),
+            free_head(other.free_head.load()),
+            shared_free(other.shared_free.load()),
+            epoch(other.epoch),
+            size(other.size)
+        {
+            other.memory = nullptr;
+            other.links = nullptr;
+            other.magazines = nullptr;
+        }
+
+        ~ConcurrentPool() {
+            if (memory) {
+                delete [] memory;
+            }
+            if (links) {
+                delete [] links;
+            }
+            if (magazines) {
+                delete [] magazines;
+            }
+        }
+
+        template <typename... Args>
+        [[nodiscard]] T* emplace (Args&&... args) {
+            return new(allocate()) T{args...};
+        }
+
+        [[nodiscard]] T* insert (const T& other) {
+            return new(allocate()) T(other);
+        }
+
+        void discard (T* object) {
+            Item* item = reinterpret_cast<Item*>(object);
+            if (item < pool || item >= pool + size) {
+                throw std::runtime_error("ConcurrentPool discarded object not belonging to pool");
+            }
+            std::uint32_t index = std::uint32_t(item - pool);
+            const auto thread = detail::threadIndex();
+            if (thread < MaxThreads) {
+                Magazine& magazine = activeMagazine(thread);
+                if (magazine.count == MagazineSize) {
+                    // Magazine is full, return the older half to the shared stack
+                    pushBatch(magazine.items, BatchSize);
+                    std::memmove(magazine.items, magazine.items + BatchSize, sizeof(std::uint32_t) * (MagazineSize - BatchSize));
+                    magazine.count -= BatchSize;
+                }
+                magazine.items[magazine.count++] = index;
+            } else {
+                pushBatch(&index, 1);
+            }
+        }
+
+        void reset () {
+            tracker.used(sizeof(Item) * std::min(top.load(), size));
+            top.store(0);
+            free_head.store(0);
+            shared_free.store(0);
+            ++epoch;
+        }
+
+        // Approximate: items cached in per-thread magazines are counted as in use
+        uint32_t count () const {
+            return std::min(top.load(std::memory_order_relaxed), size) - shared_free.load(std::memory_order_relaxed);
+        }
+
+        uint32_t remaining () const {
+            return size - count();
+        }
+
+        uint32_t capacity () const {
+            return size;
+        }
+
+    private:
+        budget::Tracker tracker;
+        std::byte* memory;
+        Item* const pool;
+        std::atomic_uint32_t* links;
+        Magazine* magazines;
+        std::atomic_uint32_t top; // Items from here on have never been allocated since the last reset
+        std::atomic_uint64_t free_head; // Tag in upper 32 bits, index + 1 of first free item in lower 32 bits
+        std::atomic_uint32_t shared_free;
+        std::uint32_t epoch;
+        const std::uint32_t size;
+    };
+
+
     // A pool maintaining tightly packed elements. Discarded elements are swapped to the back. Pointers to elements are NOT stable.
     template <typename T, typename Allocator = std::allocator<T>>
     class ReorderingPool {
@@ -263,17 +508,22 @@ namespace homogeneous {
         static_assert(std::is_trivial<T>::value, "ReorderingPool<T> must contain a trivial type");
         using Type = T;
 
-        ReorderingPool (uint32_t size) {
+        ReorderingPool (uint32_t size) :
+            tracker("homogeneous::ReorderingPool", sizeof(T) * size, sizeof(T) * size)
+        {
             pool.reserve(size);
         }
 
         template <typename... Args>
         [[nodiscard]] T* emplace (Args&&... args) {
-            return pool.emplace_back(std::forward<Args>(args)...);
+            T* object = &pool.emplace_back(std::forward<Args>(args)...);
+            trackGrowth();
+            return object;
         }
 
         [[nodiscard]] T* insert (const T& other) {
             pool.push_back(T{other});
+            trackGrowth();
             return &pool.back();
         }
 
@@ -285,6 +535,7 @@ namespace homogeneous {
         }
 
         void reset () {
+            tracker.used(sizeof(T) * pool.size());
             pool.clear();
         }
 
@@ -318,6 +569,171 @@ namespace homogeneous {
 
     private:
         std::vector<T, Allocator> pool;
+        std::size_t tracked_capacity = 0;
+        budget::Tracker tracker;
+
+        // The vector grows on demand, so keep the committed size up to date
+        void trackGrowth () {
+            if (pool.capacity() != tracked_capacity) {
+                tracked_capacity = pool.capacity();
+                tracker.commit(sizeof(T) * tracked_capacity);
+            }
+        }
+    };
+
+    // A contiguous run of one field of an SoAReorderingPool
+    template <typename T>
+    class FieldSpan {
+    public:
+        FieldSpan (T* data, std::uint32_t size) : ptr(data), length(size) {}
+
+        T* data () const { return ptr; }
+        std::uint32_t size () const { return length; }
+        T* begin () const { return ptr; }
+        T* end () const { return ptr + length; }
+        T& operator[] (std::uint32_t index) const { return ptr[index]; }
+
+    private:
+        T* ptr;
+        std::uint32_t length;
+    };
+
+    // Structure of arrays version of ReorderingPool, for hot numeric data such as particle or steering state.
+    // Each field is kept tightly packed in its own cache line aligned array, so a loop over one field only touches that field's memory
+    // and vectorizes cleanly. Elements are addressed by index, and discarding an element moves the last element into its place.
+    // Capacity is always a multiple of `Lanes`, so SIMD loops may run to `paddedCount()` in whole AVX2 vectors without a scalar tail:
+    // entries past `count()` hold unspecified values, and anything written to them is ignored.
+    // Fields are accessed by position, or by type if it appears only once, eg: SoAReorderingPool<Position, Velocity, float>
+    template <typename... Fields>
+    class SoAReorderingPool {
+    public:
+        static_assert(sizeof...(Fields) > 0, "SoAReorderingPool must have at least one field");
+        static_assert((std::is_trivial<Fields>::value && ...), "SoAReorderingPool fields must be trivial types");
+        static_assert(((alignof(Fields) <= alignment::AlignCacheLine::Bountary) && ...), "SoAReorderingPool fields must not be aligned to more than a cache line");
+
+        static constexpr std::uint32_t Lanes = 32; // Enough elements to fill a 256 bit vector with the smallest possible field
+        template <std::size_t I> using FieldType = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+        SoAReorderingPool (std::uint32_t size) :
+            memory(nullptr),
+            size(0),
+            used(0),
+            tracker("homogeneous::SoAReorderingPool", 0, 0)
+        {
+            grow(roundUp(std::max(size, 1u)), std::index_sequence_for<Fields...>{});
+        }
+        ~SoAReorderingPool () { delete [] memory; }
+        SoAReorderingPool (const SoAReorderingPool&) = delete;
+        SoAReorderingPool& operator= (const SoAReorderingPool&) = delete;
+
+        // Append an element, returning its index. Indices are only valid until the next discard.
+        std::uint32_t emplace (const Fields&... values) {
+            if (used == size) {
+                grow(size * 2, std::index_sequence_for<Fields...>{});
+            }
+            const std::uint32_t index = used++;
+            std::apply([index, &values...](Fields*... fields){ ((fields[index] = values), ...); }, arrays);
+            return index;
+        }
+
+        // Remove an element by moving the last element into its place
+        void discard (std::uint32_t index) {
+            if (index < used) {
+                const std::uint32_t last = --used;
+                if (index != last) {
+                    std::apply([index, last](Fields*... fields){ ((fields[index] = fields[last]), ...); }, arrays);
+                }
+            }
+        }
+
+        void reset () {
+            tracker.used(bytesPerElement() * used);
+            used = 0;
+        }
+
+        template <std::size_t I>
+        FieldType<I>& get (std::uint32_t index) {
+            return std::get<I>(arrays)[index];
+        }
+
+        template <typename T>
+        T& get (std::uint32_t index) {
+            return std::get<T*>(arrays)[index];
+        }
+
+        // The live entries of a single field
+        template <std::size_t I>
+        FieldSpan<FieldType<I>> field () {
+            return {std::get<I>(arrays), used};
+        }
+
+        template <typename T>
+        FieldSpan<T> field () {
+            return {std::get<T*>(arrays), used};
+        }
+
+        // Call `fn(Fields&...)` for each live element, in index order
+        template <typename Function>
+        void each (Function fn) {
+            std::apply([this, &fn](Fields*... fields){
+                for (std::uint32_t index = 0; index < used; ++index) {
+                    fn(fields[index]...);
+                }
+            }, arrays);
+        }
+
+        std::uint32_t count () const {
+            return used;
+        }
+
+        // Number of elements a SIMD loop should process, a multiple of `Lanes` that is never greater than `capacity()`
+        std::uint32_t paddedCount () const {
+            return roundUp(used);
+        }
+
+        std::uint32_t remaining () const {
+            return size - used;
+        }
+
+        std::uint32_t capacity () const {
+            return size;
+        }
+
+    private:
+        std::byte* memory;
+        std::tuple<Fields*...> arrays;
+        std::uint32_t size;
+        std::uint32_t used;
+        budget::Tracker tracker;
+
+        static constexpr std::uint32_t roundUp (std::uint32_t count) {
+            return (count + Lanes - 1) & ~(Lanes - 1);
+        }
+
+        static constexpr std::size_t bytesPerElement () {
+            return (sizeof(Fields) + ...);
+        }
+
+        // Move every field into new arrays with room for `new_size` elements
+        template <std::size_t... I>
+        void grow (std::uint32_t new_size, std::index_sequence<I...>) {
+            constexpr std::size_t Boundary = alignment::AlignCacheLine::Bountary;
+            std::size_t offsets[sizeof...(Fields)];
+            std::size_t bytes = 0;
+            ((offsets[I] = bytes, bytes += (sizeof(Fields) * new_size + Boundary - 1) & ~(Boundary - 1)), ...);
+            const std::size_t allocated = alignment::AlignCacheLine::adjust_size(bytes);
+            tracker.commit(allocated);
+            std::byte* new_memory = new std::byte[allocated];
+            std::byte* base = alignment::AlignCacheLine::template align<std::byte>(new_memory);
+            std::tuple<Fields*...> new_arrays{reinterpret_cast<Fields*>(base + offsets[I])...};
+            if (used > 0) {
+                (std::memcpy(std::get<I>(new_arrays), std::get<I>(arrays), sizeof(Fields) * used), ...);
+            }
+            delete [] memory;
+            memory = new_memory;
+            arrays = new_arrays;
+            size = new_size;
+        }
     };
 
     
@@ -352,7 +768,7 @@ namespace homogeneous {
                     bitset ^= (1 << bit);
                     return ptr;
                 } else {
-                    return OutOfSpacePolicy::template apply<T>("homogeneous::BaseStackPool");
+                    return OutOfSpacePolicy::template apply<T>(tracker.describe());
                 }
             }
 
@@ -365,6 +781,7 @@ namespace homogeneous {
             }
     public:
         BitsetPool () :
+            tracker("homogeneous::BitsetPool", Align::adjust_size(sizeof(T) * N), Align::adjust_size(sizeof(T) * N)),
             memory(new std::byte[Align::adjust_size(sizeof(T) * N)]),
             pool(Align::template align<T>(memory)),
             bitset(calcResetValue(N))
@@ -424,9 +841,168 @@ namespace homogeneous {
         }
 
     private:
+        budget::Tracker tracker;
         std::byte* const memory;
         T* const pool;
         typename detail::BitsetUnderlying<detail::roundUp(N)>::Type bitset;
     };
 
+    // A pool for large numbers of high-churn objects, using a hierarchy of 64 bit bitmaps to find free slots.
+    // Each leaf word has a bit set for each free slot, and each word of a summary level has a bit set for each word of the level below
+    // that still has a free slot, so finding a free slot takes one bit scan per level: four levels cover over 16 million slots.
+    // Live objects can be iterated in address order by scanning the leaf words.
+    template <typename T, typename Align = alignment::NoAlign, typename OutOfSpacePolicy = out_of_space_policies::Throw>
+    class HierarchicalBitsetPool {
+    private:
+            static constexpr std::uint32_t SHIFT = 6;
+            static constexpr std::uint32_t MASK = 63;
+
+            // Allocate, but don't construct
+            [[nodiscard]] T* allocate () {
+                const std::size_t top = levels.size() - 1;
+                if (levels[top][0] == 0) {
+                    return OutOfSpacePolicy::template apply<T>(tracker.describe());
+                }
+                // Descend to the first word on each level that has a free slot
+                std::uint32_t slot = 0;
+                for (std::size_t level = levels.size(); level-- > 0;) {
+                    slot = (slot << SHIFT) | std::uint32_t(__builtin_ctzll(levels[level][slot]));
+                }
+                // Mark the slot as used, clearing the summary bits of any words that have become full
+                std::uint32_t index = slot;
+                for (auto& level : levels) {
+                    auto& word = level[index >> SHIFT];
+                    word &= ~(std::uint64_t(1) << (index & MASK));
+                    if (word != 0) {
+                        break;
+                    }
+                    index >>= SHIFT;
+                }
+                ++used;
+                return pool + slot;
+            }
+
+            // Fill in the free bits for every slot, leaving bits past the end of the pool clear
+            void markAllFree () {
+                std::uint32_t count = size;
+                for (auto& level : levels) {
+                    std::fill(level.begin(), level.end(), 0);
+                    for (std::uint32_t word = 0; word < (count >> SHIFT); ++word) {
+                        level[word] = ~std::uint64_t(0);
+                    }
+                    if (count & MASK) {
+                        level[count >> SHIFT] = (std::uint64_t(1) << (count & MASK)) - 1;
+                    }
+                    count = (count + MASK) >> SHIFT; // Number of words, which is the number of bits in the level above
+                }
+            }
+
+    public:
+        using Type = T;
+
+        HierarchicalBitsetPool (std::uint32_t size) :
+            tracker("homogeneous::HierarchicalBitsetPool", Align::adjust_size(sizeof(T) * size), Align::adjust_size(sizeof(T) * size)),
+            size(size),
+            memory(new std::byte[Align::adjust_size(sizeof(T) * size)]),
+            pool(Align::template align<T>(memory)),
+            used(0)
+        {
+            // Add levels until a level fits in a single word
+            std::uint32_t count = size;
+            std::size_t bitmap_bytes = 0;
+            do {
+                count = (count + MASK) >> SHIFT;
+                levels.emplace_back(std::max(count, 1u));
+                bitmap_bytes += sizeof(std::uint64_t) * levels.back().size();
+            } while (count > 1);
+            tracker.commit(Align::adjust_size(sizeof(T) * size) + bitmap_bytes);
+            markAllFree();
+        }
+        ~HierarchicalBitsetPool () {
+            reset();
+            delete [] memory;
+        }
+
+        template <typename... Args>
+        [[nodiscard]] T* emplace (Args&&... args) {
+            return new(allocate()) T{args...};
+        }
+
+        [[nodiscard]] T* insert (const T& other) {
+            return new(allocate()) T(other);
+        }
+
+        void discard (T* object) {
+            // Not a trivial type, so need to call the destructor
+            if constexpr (! std::is_trivial<T>::value) {
+                object->~T();
+            }
+            // Mark the slot as free, setting the summary bits of any words that were full
+            std::uint32_t index = std::uint32_t(object - pool);
+            for (auto& level : levels) {
+                auto& word = level[index >> SHIFT];
+                const bool was_full = word == 0;
+                word |= std::uint64_t(1) << (index & MASK);
+                if (! was_full) {
+                    break;
+                }
+                index >>= SHIFT;
+            }
+            --used;
+        }
+
+        void reset () {
+            tracker.used(sizeof(T) * used);
+            // Not a trivial type, so need to call the destructor
+            if constexpr (! std::is_trivial<T>::value) {
+                each([](T& object){ object.~T(); });
+            }
+            markAllFree();
+            used = 0;
+        }
+
+        // Call `fn(T&)` for each live object, in address order
+        template <typename Function>
+        void each (Function fn) {
+            const auto& leaves = levels[0];
+            for (std::uint32_t word = 0; word < leaves.size(); ++word) {
+                std::uint64_t live = ~leaves[word];
+                if (word == (size >> SHIFT)) {
+                    // Ignore bits past the end of the pool
+                    live &= (std::uint64_t(1) << (size & MASK)) - 1;
+                }
+                while (live) {
+                    const std::uint32_t bit = std::uint32_t(__builtin_ctzll(live));
+                    fn(pool[(word << SHIFT) | bit]);
+                    live &= live - 1;
+                }
+            }
+        }
+
+        bool contains (const T* object) const {
+            const auto index = std::uint32_t(object - pool);
+            return object >= pool && index < size && ((levels[0][index >> SHIFT] >> (index & MASK)) & 1) == 0;
+        }
+
+        std::uint32_t remaining () const {
+            return size - used;
+        }
+
+        std::uint32_t count () const {
+            return used;
+        }
+
+        std::uint32_t capacity () const {
+            return size;
+        }
+
+    private:
+        budget::Tracker tracker;
+        const std::uint32_t size;
+        std::byte* const memory;
+        T* const pool;
+        std::vector<std::vector<std::uint64_t>> levels; // levels[0] are the leaves, the last level is a single word
+        std::uint32_t used;
+    };
+
 }
\ No newline at end of file
@@ -0,0 +1,563 @@
+#include <monkeys.hpp>
+
+#ifdef WITH_MIMALLOC
+#include <mimalloc.h>
+#endif
+
+#include <chrono>
+
+// Tests for the pools in pools.hpp. Benchmarks are in the `benchmarks` test suite, which is skipped unless run with --no-skip, and are only
+// meaningful in the benchmarks build (builds/benchmarks.config) as the tests build is unoptimised and instrumented.
+
+namespace {
+    struct Particle {
+        float position[3];
+        float velocity[3];
+        std::uint32_t owner;
+        std::uint32_t serial;
+    };
+
+    template <typename Function>
+    void onThreads (std::uint32_t threads, Function fn)
+    {
+        std::vector<std::thread> workers;
+        for (std::uint32_t thread = 0; thread < threads; ++thread) {
+            workers.emplace_back(fn, thread);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Stop the compiler from eliding an allocation whose result is never read
+    inline void escape (void* ptr)
+    {
+        asm volatile("" : : "g"(ptr) : "memory");
+    }
+
+    // Every thread holds a varying number of items, checking that none of them has been handed to another allocation in the meantime
+    template <typename Pool>
+    void checkConcurrentPoolOwnership ()
+    {
+        constexpr std::uint32_t Threads = 8;
+        constexpr std::uint32_t MaxHeld = 100; // More than a magazine, so that magazines both run dry and overflow into the shared stack
+        constexpr std::uint32_t Rounds = 2000;
+        // Room for every thread to hold its items with a full magazine besides, with slack for free items cached by other threads
+        Pool pool(Threads * (MaxHeld + 32) * 2);
+        std::atomic_uint32_t failures{0};
+
+        onThreads(Threads, [&](std::uint32_t thread){
+            std::vector<std::pair<Particle*, std::uint32_t>> held;
+            std::uint32_t serial = 0;
+            try {
+                for (std::uint32_t round = 0; round < Rounds; ++round) {
+                    const std::uint32_t target = (round * 37 + thread * 11) % MaxHeld + 1;
+                    while (held.size() < target) {
+                        held.emplace_back(pool.insert(Particle{{}, {}, thread, serial}), serial);
+                        ++serial;
+                    }
+                    // An item also handed to another allocation would have been overwritten by it
+                    for (const auto& [particle, expected] : held) {
+                        if (particle->owner != thread || particle->serial != expected) {
+                            ++failures;
+                        }
+                    }
+                    while (held.size() > target / 2) {
+                        pool.discard(held.back().first);
+                        held.pop_back();
+                    }
+                }
+            } catch (const std::exception& e) {
+                spdlog::error("[memory] {}", e.what());
+                ++failures;
+            }
+            for (const auto& item : held) {
+                pool.discard(item.first);
+            }
+        });
+        CHECK(failures.load() == 0);
+    }
+}
+
+TEST_CASE("ConcurrentPool never hands out an item that is still in use") {
+    checkConcurrentPoolOwnership<memory::homogeneous::ConcurrentPool<Particle>>();
+    // Threads beyond MaxThreads use the shared stack for every allocation and discard, so with one the test's threads contend on it directly
+    checkConcurrentPoolOwnership<memory::homogeneous::ConcurrentPool<Particle, memory::alignment::NoAlign, memory::out_of_space_policies::Throw, 32, 1>>();
+}
+
+TEST_CASE("ConcurrentPool reset invalidates the items cached by every thread") {
+    using Pool = memory::homogeneous::ConcurrentPool<Particle>;
+    constexpr std::uint32_t Threads = 4;
+    Pool pool(Threads * 64);
+    std::atomic_uint32_t cached{0};
+    std::atomic_bool taken{false};
+    std::atomic_uint32_t stale{0};
+
+    std::thread workers([&](){
+        onThreads(Threads, [&](std::uint32_t){
+            // Leave free items in this thread's magazine
+            std::vector<Particle*> particles;
+            for (std::uint32_t index = 0; index < 16; ++index) {
+                particles.push_back(pool.emplace());
+            }
+            for (auto* particle : particles) {
+                pool.discard(particle);
+            }
+            ++cached;
+            while (! taken.load()) {
+                std::this_thread::yield();
+            }
+            // Every item belongs to the test thread now, so those left in the magazine must not be handed out
+            try {
+                escape(pool.emplace());
+                ++stale;
+            } catch (const std::exception&) {}
+        });
+    });
+
+    while (cached.load() < Threads) {
+        std::this_thread::yield();
+    }
+    pool.reset();
+    std::vector<Particle*> particles;
+    try {
+        for (std::uint32_t index = 0; index < pool.capacity(); ++index) {
+            particles.push_back(pool.emplace());
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("[memory] {}", e.what());
+    }
+    taken.store(true);
+    workers.join();
+
+    CHECK(particles.size() == pool.capacity());
+    CHECK(pool.count() == pool.capacity());
+    std::sort(particles.begin(), particles.end());
+    CHECK(std::adjacent_find(particles.begin(), particles.end()) == particles.end());
+    CHECK(stale.load() == 0);
+}
+
+TEST_CASE("DoubleBuffered readers never see a pool that is being reset or written to") {
+    using Pool = memory::adapter::DoubleBuffered<memory::homogeneous::StackPool<std::uint64_t>>;
+    constexpr std::uint32_t Frames = 2000;
+    constexpr std::uint32_t Items = 256;
+    Pool buffered(Items);
+    std::atomic_bool reading{false};
+    std::atomic_bool done{false};
+    std::atomic_uint32_t failures{0};
+    std::atomic_uint32_t frames_read{0};
+
+    // The writer fills the front pool with the number of the frame, so the back pool published by swap N holds Items copies of N
+    std::thread writer([&](){
+        while (! reading.load()) {
+            std::this_thread::yield();
+        }
+        for (std::uint64_t frame = 1; frame <= Frames; ++frame) {
+            for (std::uint32_t index = 0; index < Items; ++index) {
+                escape(buffered.emplace(frame));
+            }
+            buffered.swap();
+            std::this_thread::yield(); // Give the reader a chance to run, even with a single core
+        }
+        done.store(true);
+    });
+    std::thread reader([&](){
+        std::uint64_t last_epoch = 0;
+        reading.store(true);
+        while (! done.load()) {
+            auto guard = buffered.read();
+            if (guard.epoch() == 0) {
+                continue; // Nothing published yet
+            }
+            const auto& pool = guard.pool();
+            const auto count = pool.count();
+            // A slow reader, so that a writer that did not wait for it would reset and refill the pool in the meantime
+            std::this_thread::yield();
+            if (count != Items || pool.count() != Items || std::any_of(pool.cbegin(), pool.cend(), [&](auto value){ return value != guard.epoch(); })) {
+                ++failures;
+            }
+            if (guard.epoch() != last_epoch) {
+                last_epoch = guard.epoch();
+                ++frames_read;
+            }
+        }
+    });
+    writer.join();
+    reader.join();
+
+    CHECK(failures.load() == 0);
+    CHECK(frames_read.load() > 0);
+}
+
+SCENARIO("HierarchicalBitsetPool hands out the lowest free slot and iterates live objects in address order") {
+    using Pool = memory::homogeneous::HierarchicalBitsetPool<Particle>;
+    // Three levels of bitmaps, with partial words at the end of each level
+    constexpr std::uint32_t Capacity = 64 * 64 + 64 * 14 + 5;
+    Pool pool(Capacity);
+    std::vector<Particle*> live;
+    const auto liveInAddressOrder = [&](){
+        std::vector<Particle*> visited;
+        pool.each([&](Particle& particle){ visited.push_back(&particle); });
+        std::sort(live.begin(), live.end());
+        return visited == live;
+    };
+
+    GIVEN("a full pool") {
+        for (std::uint32_t index = 0; index < Capacity; ++index) {
+            live.push_back(pool.emplace(Particle{{}, {}, index, 0}));
+        }
+        bool threw = false;
+        try {
+            escape(pool.emplace());
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        THEN("every slot was handed out once, in address order, and no more") {
+            CHECK(threw);
+            CHECK(pool.count() == Capacity);
+            CHECK(pool.remaining() == 0);
+            CHECK(std::is_sorted(live.begin(), live.end()));
+            CHECK(live.back() - live.front() == Capacity - 1);
+            CHECK(liveInAddressOrder());
+        }
+
+        WHEN("objects are discarded and allocated again at random") {
+            std::uint32_t seed = 12345;
+            const auto random = [&](std::uint32_t range){
+                seed = seed * 1664525u + 1013904223u;
+                return (seed >> 8) % range;
+            };
+            Particle* const first = live.front();
+            std::vector<bool> used(Capacity, true);
+            std::uint32_t mismatches = 0;
+            for (std::uint32_t round = 0; round < 20000; ++round) {
+                // Discard more than is allocated, until the pool is mostly empty, then the other way around
+                const bool emptying = (round / 5000) % 2 == 0;
+                if (live.size() == Capacity || (live.size() > 0 && (random(4) == 0) != emptying)) {
+                    const auto index = random(std::uint32_t(live.size()));
+                    used[live[index] - first] = false;
+                    pool.discard(live[index]);
+                    live[index] = live.back();
+                    live.pop_back();
+                } else {
+                    // The pool always hands out the free slot with the lowest address
+                    const auto expected = std::uint32_t(std::find(used.begin(), used.end(), false) - used.begin());
+                    Particle* particle = pool.emplace(Particle{{}, {}, round, 1});
+                    if (particle != first + expected) {
+                        ++mismatches;
+                    }
+                    used[particle - first] = true;
+                    live.push_back(particle);
+                }
+                if (pool.count() != live.size()) {
+                    ++mismatches;
+                }
+            }
+            THEN("the pool agrees with the objects that were kept") {
+                CHECK(mismatches == 0);
+                CHECK(liveInAddressOrder());
+                CHECK(std::all_of(live.begin(), live.end(), [&](auto* particle){ return pool.contains(particle); }));
+            }
+        }
+
+        WHEN("the pool is reset") {
+            pool.reset();
+            THEN("it is empty and every slot can be handed out again") {
+                CHECK(pool.count() == 0);
+                std::uint32_t visited = 0;
+                pool.each([&](Particle&){ ++visited; });
+                CHECK(visited == 0);
+                CHECK_FALSE(pool.contains(live.front()));
+                std::uint32_t allocated = 0;
+                try {
+                    for (; allocated < Capacity; ++allocated) {
+                        escape(pool.emplace());
+                    }
+                } catch (const std::exception&) {}
+                CHECK(allocated == Capacity);
+            }
+        }
+    }
+}
+
+SCENARIO("SoAReorderingPool keeps each field packed and removes elements by moving the last one into their place") {
+    using Pool = memory::homogeneous::SoAReorderingPool<float, std::uint32_t, std::uint8_t>;
+    using Element = std::tuple<float, std::uint32_t, std::uint8_t>;
+    Pool pool(10);
+    std::vector<Element> expected;
+    const auto matches = [&](){
+        std::vector<Element> elements;
+        pool.each([&](float& a, std::uint32_t& b, std::uint8_t& c){ elements.emplace_back(a, b, c); });
+        bool fields = pool.field<0>().size() == expected.size() && pool.field<std::uint32_t>().size() == expected.size();
+        for (std::uint32_t index = 0; fields && index < expected.size(); ++index) {
+            fields = pool.field<0>()[index] == std::get<0>(expected[index]) && pool.get<std::uint32_t>(index) == std::get<1>(expected[index]) && pool.get<2>(index) == std::get<2>(expected[index]);
+        }
+        return fields && elements == expected;
+    };
+
+    THEN("its capacity is rounded up to a whole number of lanes") {
+        CHECK(pool.capacity() == Pool::Lanes);
+        CHECK(pool.count() == 0);
+        CHECK(pool.paddedCount() == 0);
+    }
+
+    GIVEN("more elements than it was created with room for") {
+        for (std::uint32_t index = 0; index < 100; ++index) {
+            const auto element = Element{float(index) * 0.5f, index * 3, std::uint8_t(index)};
+            CHECK(pool.emplace(std::get<0>(element), std::get<1>(element), std::get<2>(element)) == index);
+            expected.push_back(element);
+        }
+
+        THEN("it grows, keeping the elements and each field's alignment") {
+            CHECK(pool.count() == 100);
+            CHECK(pool.capacity() >= 100);
+            CHECK(pool.capacity() % Pool::Lanes == 0);
+            CHECK(matches());
+            CHECK(reinterpret_cast<std::uintptr_t>(pool.field<0>().data()) % memory::alignment::AlignCacheLine::Bountary == 0);
+            CHECK(reinterpret_cast<std::uintptr_t>(pool.field<1>().data()) % memory::alignment::AlignCacheLine::Bountary == 0);
+            CHECK(reinterpret_cast<std::uintptr_t>(pool.field<2>().data()) % memory::alignment::AlignCacheLine::Bountary == 0);
+        }
+
+        THEN("a loop may run to the padded count without touching the live elements of other fields") {
+            CHECK(pool.paddedCount() % Pool::Lanes == 0);
+            CHECK(pool.paddedCount() >= pool.count());
+            CHECK(pool.paddedCount() <= pool.capacity());
+            auto* values = pool.field<0>().data();
+            for (std::uint32_t index = 0; index < pool.paddedCount(); ++index) {
+                values[index] = values[index] * 2.0f;
+            }
+            for (auto& element : expected) {
+                std::get<0>(element) *= 2.0f;
+            }
+            CHECK(matches());
+        }
+
+        WHEN("elements are discarded and emplaced at random") {
+            std::uint32_t seed = 54321;
+            const auto random = [&](std::uint32_t range){
+                seed = seed * 1664525u + 1013904223u;
+                return (seed >> 8) % range;
+            };
+            std::uint32_t mismatches = 0;
+            for (std::uint32_t round = 0; round < 5000; ++round) {
+                if (! expected.empty() && random(2) == 0) {
+                    const auto index = random(std::uint32_t(expected.size()));
+                    pool.discard(index);
+                    expected[index] = expected.back();
+                    expected.pop_back();
+                } else {
+                    const auto element = Element{float(round), round, std::uint8_t(round * 7)};
+                    if (pool.emplace(std::get<0>(element), std::get<1>(element), std::get<2>(element)) != expected.size()) {
+                        ++mismatches;
+                    }
+                    expected.push_back(element);
+                }
+            }
+            THEN("the pool matches a vector with the same swap removal") {
+                CHECK(mismatches == 0);
+                CHECK(pool.count() == expected.size());
+                CHECK(matches());
+            }
+        }
+
+        WHEN("an index past the end is discarded") {
+            pool.discard(pool.count());
+            THEN("nothing changes") {
+                CHECK(matches());
+            }
+        }
+
+        WHEN("the pool is reset") {
+            const auto capacity = pool.capacity();
+            pool.reset();
+            expected.clear();
+            THEN("it is empty but keeps its capacity") {
+                CHECK(pool.count() == 0);
+                CHECK(pool.paddedCount() == 0);
+                CHECK(pool.capacity() == capacity);
+                CHECK(matches());
+            }
+        }
+    }
+}
+
+namespace {
+    // A variable sized allocation made by the ChunkedAtomicStackPool tests, followed by a payload filled with a byte derived from it
+    struct Record {
+        std::uint32_t thread;
+        std::uint32_t serial;
+        std::uint32_t bytes; // Including the record itself
+    };
+
+    inline std::byte payloadByte (std::uint32_t thread, std::uint32_t serial)
+    {
+        return std::byte((thread * 31 + serial) & 0xff);
+    }
+
+    template <typename Pool>
+    void allocateRecord (Pool& pool, std::uint32_t thread, std::uint32_t serial)
+    {
+        // Mostly small items, with the occasional item that is larger than a chunk
+        const std::uint32_t bytes = serial % 500 == 499 ? 6000 : std::uint32_t(sizeof(Record)) + 4 * ((serial * 7 + thread) % 24);
+        std::byte* memory = pool.allocate(bytes);
+        new (memory) Record{thread, serial, bytes};
+        std::fill(memory + sizeof(Record), memory + bytes, payloadByte(thread, serial));
+    }
+
+    // Walk the records in every chunk, counting how often each one is seen. Returns the number of corrupt records.
+    template <typename Pool>
+    std::uint32_t walkRecords (const Pool& pool, std::vector<std::vector<std::uint32_t>>& seen)
+    {
+        for (auto& serials : seen) {
+            std::fill(serials.begin(), serials.end(), 0);
+        }
+        std::uint32_t corrupt = 0;
+        pool.eachChunk([&](std::byte* begin, std::byte* end){
+            while (begin < end) {
+                if (std::size_t(end - begin) < sizeof(Record)) {
+                    ++corrupt;
+                    return;
+                }
+                const auto& record = *reinterpret_cast<const Record*>(begin);
+                if (record.bytes < sizeof(Record) || record.bytes > std::size_t(end - begin) || record.thread >= seen.size() || record.serial >= seen[record.thread].size()) {
+                    ++corrupt;
+                    return;
+                }
+                if (std::any_of(begin + sizeof(Record), begin + record.bytes, [&](std::byte value){ return value != payloadByte(record.thread, record.serial); })) {
+                    ++corrupt;
+                }
+                ++seen[record.thread][record.serial];
+                begin += record.bytes;
+            }
+        });
+        return corrupt;
+    }
+
+    // True if each thread's records with serials in [first, first + counts[thread]) were seen once and no others were seen
+    inline bool seenOnce (const std::vector<std::vector<std::uint32_t>>& seen, std::uint32_t first, const std::vector<std::uint32_t>& counts)
+    {
+        for (std::uint32_t thread = 0; thread < seen.size(); ++thread) {
+            for (std::uint32_t serial = 0; serial < seen[thread].size(); ++serial) {
+                const bool expected = serial >= first && serial < first + counts[thread];
+                if (seen[thread][serial] != (expected ? 1 : 0)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <typename Pool>
+    void checkChunkedAtomicStackPool ()
+    {
+        constexpr std::uint32_t Threads = 8;
+        constexpr std::uint32_t Rounds = 2;
+        constexpr std::uint32_t PerRound = 2000;
+        const std::vector<std::uint32_t> all(Threads, PerRound);
+        std::vector<std::vector<std::uint32_t>> seen(Threads, std::vector<std::uint32_t>(Rounds * PerRound));
+
+        {
+            Pool pool(4 * 1024 * 1024);
+            std::atomic_uint32_t finished{0};
+            std::atomic_uint32_t round{0};
+            std::atomic_uint32_t failures{0};
+
+            // Each thread allocates a round of records, then waits for the test thread to check and reset the pool before the next round,
+            // so that the chunks they were allocating from when the pool was reset are handed to other threads
+            std::thread workers([&](){
+                onThreads(Threads, [&](std::uint32_t thread){
+                    for (std::uint32_t current = 0; current < Rounds; ++current) {
+                        while (round.load() != current) {
+                            std::this_thread::yield();
+                        }
+                        try {
+                            for (std::uint32_t serial = current * PerRound; serial < (current + 1) * PerRound; ++serial) {
+                                allocateRecord(pool, thread, serial);
+                            }
+                        } catch (const std::exception& e) {
+                            spdlog::error("[memory] {}", e.what());
+                            ++failures;
+                        }
+                        ++finished;
+                    }
+                });
+            });
+            for (std::uint32_t current = 0; current < Rounds; ++current) {
+                while (finished.load() != (current + 1) * Threads) {
+                    std::this_thread::yield();
+                }
+                CHECK(walkRecords(pool, seen) == 0);
+                CHECK(seenOnce(seen, current * PerRound, all));
+                pool.reset();
+                round.store(current + 1);
+            }
+            workers.join();
+            CHECK(failures.load() == 0);
+        }
+
+        {
+            // Not a multiple of the chunk size, so the claim that runs out of space straddles the end of the pool
+            Pool pool(64 * 1024 + 100);
+            std::vector<std::uint32_t> counts(Threads, 0);
+            onThreads(Threads, [&](std::uint32_t thread){
+                try {
+                    for (std::uint32_t serial = 0; serial < PerRound; ++serial) {
+                        allocateRecord(pool, thread, serial);
+                        ++counts[thread];
+                    }
+                } catch (const std::exception&) {}
+            });
+            CHECK(pool.remaining() == 0);
+            CHECK(walkRecords(pool, seen) == 0);
+            CHECK(seenOnce(seen, 0, counts));
+        }
+    }
+}
+
+TEST_CASE("ChunkedAtomicStackPool allocations from many threads never overlap and are iterated without gaps") {
+    using namespace memory;
+    checkChunkedAtomicStackPool<heterogeneous::ChunkedAtomicStackPool<>>();
+    // Threads beyond MaxThreads share a chunk under a lock, so with one the test's threads all go through the shared chunk
+    checkChunkedAtomicStackPool<heterogeneous::ChunkedAtomicStackPool<alignment::NoAlign, alignment::NoAlign, out_of_space_policies::Throw, 4096, 1>>();
+}
+
+TEST_CASE("ConcurrentPool allocation benchmark" * doctest::test_suite("benchmarks") * doctest::skip()) {
+    constexpr std::uint32_t Frames = 10000;
+    constexpr std::uint32_t Batch = 256;
+
+    // Each thread allocates a batch of items and discards them again, every frame
+    const auto run = [&](const char* name, std::uint32_t threads, auto allocate, auto discard){
+        const auto start = std::chrono::steady_clock::now();
+        onThreads(threads, [&](std::uint32_t){
+            std::vector<Particle*> particles(Batch);
+            for (std::uint32_t frame = 0; frame < Frames; ++frame) {
+                for (auto& particle : particles) {
+                    particle = allocate();
+                    escape(particle);
+                }
+                for (auto* particle : particles) {
+                    discard(particle);
+                }
+            }
+        });
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        spdlog::info("[memory] {:<16} {:>2} threads: {:>8.1f}ms, {:>6.1f}ns per allocate and discard", name, threads, elapsed.count(), elapsed.count() * 1e6 / (double(Frames) * Batch));
+    };
+
+    std::vector<std::uint32_t> thread_counts{1};
+    if (std::thread::hardware_concurrency() > 1) {
+        thread_counts.push_back(std::min(std::thread::hardware_concurrency(), 16u));
+    }
+    for (const auto threads : thread_counts) {
+        memory::homogeneous::ConcurrentPool<Particle> pool(threads * (Batch + 32) * 2);
+        run("ConcurrentPool", threads, [&](){ return pool.emplace(); }, [&](Particle* particle){ pool.discard(particle); });
+
+        // With WITH_MIMALLOC, global new and delete are mimalloc's too, so this measures mimalloc through the standard allocator
+        std::allocator<Particle> allocator;
+        run("std::allocator", threads, [&](){ return allocator.allocate(1); }, [&](Particle* particle){ allocator.deallocate(particle, 1); });
+
+#ifdef WITH_MIMALLOC
+        run("mimalloc", threads, [](){ return static_cast<Particle*>(mi_malloc(sizeof(Particle))); }, [](Particle* particle){ mi_free(particle); });
+#endif
+    }
+}
@@ -1,5 +1,20 @@
 #pragma once
 
+// System headers must be included outside of the memory namespace
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "budget.hpp"
+
 namespace memory {
 
     #include "homogeneous_pools.hpp"
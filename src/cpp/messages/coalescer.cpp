@@ -0,0 +1,82 @@
+#include "coalescer.hpp"
+#include "context.hpp"
+
+#include <cstring>
+
+using MessageEnvelope = memory::MessagePool::MessageEnvelope;
+
+// Messages only supersede each other if they have the same target type, filter and categories
+constexpr std::uint32_t TARGET_FLAGS_MASK = 0xe0ffff00;
+
+template <typename Function>
+void forEachMessage (std::byte* begin, std::byte* end, Function fn)
+{
+    std::byte* ptr = begin;
+    while (ptr < end) {
+        const auto& envelope = *reinterpret_cast<const MessageEnvelope*>(ptr);
+        const std::uint32_t message_size = sizeof(MessageEnvelope) + (envelope.metadata & 0xff);
+        fn(envelope, ptr, message_size);
+        ptr += message_size;
+    }
+}
+
+messages::Coalescer::Slot& messages::Coalescer::find (entt::hashed_string::hash_type type, std::uint32_t target, std::uint32_t target_flags)
+{
+    std::uint64_t hash = ((std::uint64_t(type) << 32) | target) ^ (std::uint64_t(target_flags) * 0x9e3779b97f4a7c15ull);
+    hash *= 0x9e3779b97f4a7c15ull;
+    std::uint32_t index = std::uint32_t(hash >> 32) & m_mask;
+    // Linear probing, the table is never more than half full so an empty slot is always found
+    while (true) {
+        Slot& slot = m_table[index];
+        if (slot.offset == 0 || (slot.type == type && slot.target == target && slot.target_flags == target_flags)) {
+            return slot;
+        }
+        index = (index + 1) & m_mask;
+    }
+}
+
+void messages::Coalescer::apply (memory::MessagePool::GatherPoolType& pool)
+{
+    EASY_FUNCTION(messages::COLOR(3));
+    std::byte* begin = pool.begin();
+    std::byte* end = pool.end();
+
+    // Size the table to the number of coalescing messages pumped this time
+    std::uint32_t count = 0;
+    forEachMessage(begin, end, [this, &count](const auto& envelope, auto, auto){
+        if (m_types.contains(envelope.type)) {
+            ++count;
+        }
+    });
+    if (count < 2) {
+        // Nothing can be superseded
+        return;
+    }
+    std::uint32_t capacity = 16;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+    m_table.assign(capacity, Slot{0, 0, 0, 0});
+    m_mask = capacity - 1;
+
+    // Record the last message for each (type, target) pair
+    forEachMessage(begin, end, [this, begin](const auto& envelope, auto ptr, auto){
+        if (m_types.contains(envelope.type)) {
+            const std::uint32_t target_flags = envelope.metadata & TARGET_FLAGS_MASK;
+            find(envelope.type, envelope.target, target_flags) = Slot{envelope.type, envelope.target, target_flags, std::uint32_t(ptr - begin) + 1};
+        }
+    });
+
+    // Compact the pool, keeping only messages that have not been superseded
+    std::byte* out = begin;
+    forEachMessage(begin, end, [this, begin, &out](const auto& envelope, auto ptr, auto message_size){
+        if (m_types.contains(envelope.type) && find(envelope.type, envelope.target, envelope.metadata & TARGET_FLAGS_MASK).offset != std::uint32_t(ptr - begin) + 1) {
+            return;
+        }
+        if (out != ptr) {
+            std::memmove(out, ptr, message_size);
+        }
+        out += message_size;
+    });
+    pool.rewind(std::uint32_t(out - begin));
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <monkeys.hpp>
+#include "memory/event_pools.hpp"
+
+namespace messages {
+
+    // Drops superseded messages of coalescing (last-writer-wins) types, so that only the last message of such a type
+    // posted to each target is delivered. Uses an open-addressing table sized to the number of messages being pumped.
+    class Coalescer {
+    public:
+        Coalescer () {}
+        ~Coalescer () {}
+
+        void add (entt::hashed_string::hash_type message_type) { m_types.insert(message_type); }
+        bool empty () const { return m_types.empty(); }
+
+        // Remove every message of a coalescing type that is followed by another with the same type and target, compacting the pool in place
+        void apply (memory::MessagePool::GatherPoolType& pool);
+
+    private:
+        struct Slot {
+            entt::hashed_string::hash_type type;
+            std::uint32_t target;
+            std::uint32_t target_flags;
+            std::uint32_t offset; // Offset of last message + 1, 0 if slot is empty
+        };
+
+        phmap::flat_hash_set<entt::hashed_string::hash_type> m_types;
+        std::vector<Slot> m_table;
+        std::uint32_t m_mask = 0;
+
+        Slot& find (entt::hashed_string::hash_type type, std::uint32_t target, std::uint32_t target_flags);
+    };
+
+}
@@ -2,13 +2,23 @@
 
 #include <monkeys.hpp>
 #include "memory/event_pools.hpp"
+#include "timing_wheel.hpp"
+#include "traffic_stats.hpp"
+#include "coalescer.hpp"
 
 namespace messages {
     struct Context {
         Context ();
         ~Context () {}
         std::vector<memory::MessagePool*> m_message_pools;
-        memory::MessagePool::PoolType m_message_pool;
+        memory::MessagePool::GatherPoolType m_message_pool;
+        memory::MessageBlobArena m_message_blobs; // Out-of-line storage for payloads too large for the message pools
+        // Delayed messages are held in the timing wheel until due, then queued in m_due_messages for the next pump
+        TimingWheel m_timing_wheel;
+        memory::MessagePool m_due_messages;
+        std::atomic_uint64_t m_current_frame;
+        std::unique_ptr<TrafficStats> m_traffic_stats; // Only set if message statistics are enabled
+        Coalescer m_coalescer;
     };
 
     constexpr profiler::color_t COLOR(unsigned idx) {
@@ -6,8 +6,21 @@ int get_global_event_pool_size () {
     return pool_size * std::thread::hardware_concurrency();
 }
 
+int get_global_event_pool_reserve () {
+    const std::uint32_t reserve_size = entt::monostate<"memory/events/global-pool-reserve"_hs>();
+    return std::max(reserve_size, std::uint32_t(get_global_event_pool_size()));
+}
+
+int get_message_blob_arena_size () {
+    const std::uint32_t arena_size = entt::monostate<"memory/events/blob-arena-size"_hs>();
+    return arena_size;
+}
+
 messages::Context::Context () :
-    m_message_pool(get_global_event_pool_size())
+    m_message_pool(get_global_event_pool_reserve(), get_global_event_pool_size()),
+    m_message_blobs(get_message_blob_arena_size()),
+    m_due_messages(get_global_event_pool_size(), &m_message_blobs),
+    m_current_frame(0)
 {
 
 }
@@ -16,7 +29,19 @@ messages::Context* messages::init ()
 {
     EASY_BLOCK("messages::init", messages::COLOR(1));
     SPDLOG_DEBUG("[messages] Init");
-    return new messages::Context{};
+    messages::Context* context;
+    {
+        memory::budget::Scope budget_scope(memory::budget::Subsystem::Messages, "global message pools");
+        context = new messages::Context{};
+    }
+    const bool& message_stats_enabled = entt::monostate<"telemetry/message-stats"_hs>{};
+    if (message_stats_enabled) {
+        const std::uint32_t report_interval = entt::monostate<"telemetry/message-stats/report-interval"_hs>{};
+        const std::uint32_t top_count = entt::monostate<"telemetry/message-stats/top-count"_hs>{};
+        context->m_traffic_stats = std::make_unique<messages::TrafficStats>(report_interval, top_count);
+        spdlog::info("[messages] Message traffic statistics enabled");
+    }
+    return context;
 }
 
 void messages::term (messages::Context* context)
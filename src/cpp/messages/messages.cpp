@@ -3,6 +3,7 @@
 
 #include "core/engine.hpp"
 
+#include <cstring>
 #include <iterator>
 #include <mutex>
 
@@ -10,15 +11,61 @@ std::mutex g_pool_mutex;
 
 thread_local memory::MessagePublisher<memory::MessagePool> g_message_publisher;
 
+void queueDueMessage (messages::Context* context, const memory::DelayedMessage& header, const std::byte* payload)
+{
+    std::byte* ptr = context->m_due_messages.push(header.type, header.target, header.flags, header.size);
+    std::memcpy(ptr, payload, header.size);
+}
+
+void messages::update (messages::Context* context, std::uint64_t frame)
+{
+    EASY_BLOCK("messages::update", messages::COLOR(2));
+    if EXPECT_NOT_TAKEN(context->m_traffic_stats != nullptr) {
+        context->m_traffic_stats->endFrame();
+    }
+    context->m_current_frame.store(frame, std::memory_order_relaxed);
+    context->m_timing_wheel.advance(frame, [context](const auto& header, const auto* payload){
+        queueDueMessage(context, header, payload);
+    });
+}
+
 void messages::pump (messages::Context* context)
 {
     EASY_BLOCK("messages::pump", messages::COLOR(2));
     context->m_message_pool.reset();
+    // Move messages posted with a delay into the timing wheel, unless they are already due
+    auto& timing_wheel = context->m_timing_wheel;
+    for (auto pool : context->m_message_pools) {
+        pool->drainDelayed([context, &timing_wheel](const auto& header, const auto* payload){
+            if (header.frame > timing_wheel.currentFrame()) {
+                timing_wheel.insert(header, payload);
+            } else {
+                queueDueMessage(context, header, payload);
+            }
+        });
+    }
+    // Blobs written since the last pump now belong to the messages being gathered, while the blobs of the previous batch are freed
+    context->m_message_blobs.swap();
+    // Copy messages that have become due into the global pool
+    context->m_due_messages.copyInto(context->m_message_pool);
+    context->m_due_messages.reset();
     // Copy thread local events into global pool and reset thread local pools
     for (auto pool : context->m_message_pools) {
         pool->copyInto(context->m_message_pool);
         pool->reset();
     }
+    if EXPECT_NOT_TAKEN(context->m_traffic_stats != nullptr) {
+        context->m_traffic_stats->recordPump(context->m_message_pool.begin(), context->m_message_pool.end());
+    }
+    // Only deliver the last message of each coalescing type for each target
+    if (! context->m_coalescer.empty()) {
+        context->m_coalescer.apply(context->m_message_pool);
+    }
+}
+
+void messages::setCoalescing (messages::Context* context, entt::hashed_string::hash_type message_type)
+{
+    context->m_coalescer.add(message_type);
 }
 
 million::events::Publisher& messages::publisher (messages::Context* context)
@@ -31,9 +78,10 @@ million::events::Publisher& messages::publisher (messages::Context* context)
 
         // Only one thread can access event pools list at once
         std::lock_guard<std::mutex> guard(g_pool_mutex);
-        auto message_pool = new memory::MessagePool(message_pool_size);
+        memory::budget::Scope budget_scope(memory::budget::Subsystem::Messages, "per-thread message pool");
+        auto message_pool = new memory::MessagePool(message_pool_size, &context->m_message_blobs);
         context->m_message_pools.push_back(message_pool); // Keep track of this pool so that we can gather the events into a global pool at the end of each frame
-        g_message_publisher = memory::MessagePublisher<memory::MessagePool>(message_pool);
+        g_message_publisher = memory::MessagePublisher<memory::MessagePool>(message_pool, &context->m_current_frame);
     }
     return g_message_publisher;
 }
@@ -42,3 +90,15 @@ const std::pair<std::byte*, std::byte*> messages::messages (messages::Context* c
 {
     return std::make_pair(context->m_message_pool.begin(), context->m_message_pool.end());
 }
+
+const std::byte* messages::blobs (messages::Context* context)
+{
+    return context->m_message_blobs.blobs();
+}
+
+void messages::recordFanOut (messages::Context* context, std::uint32_t num_entities)
+{
+    if EXPECT_NOT_TAKEN(context->m_traffic_stats != nullptr) {
+        context->m_traffic_stats->recordFanOut(num_entities);
+    }
+}
@@ -6,8 +6,16 @@ namespace messages {
     Context* init ();
     void term (Context*);
 
+    // Advance the timing wheel to the current frame, queueing delayed messages that are now due for the next pump
+    void update (messages::Context* context, std::uint64_t frame);
     void pump (messages::Context* context);
+    // Mark a message type as coalescing: of those pumped together, only the last posted to each target is delivered
+    void setCoalescing (Context* context, entt::hashed_string::hash_type message_type);
 
     million::events::Publisher& publisher (Context* context);
     const std::pair<std::byte*, std::byte*> messages (Context* context);
+    // Base address for the MessageBlob offsets of extended payload messages returned by messages()
+    const std::byte* blobs (Context* context);
+    // Record how many entities a non-entity targetted message was delivered to, if message statistics are enabled
+    void recordFanOut (Context* context, std::uint32_t num_entities);
 }
@@ -0,0 +1,55 @@
+#include "timing_wheel.hpp"
+
+messages::TimingWheel::TimingWheel () :
+    m_current_frame(0),
+    m_pending(0)
+{
+
+}
+
+void messages::TimingWheel::insert (const memory::DelayedMessage& header, const std::byte* payload)
+{
+    place(header, payload);
+    ++m_pending;
+}
+
+void messages::TimingWheel::place (const memory::DelayedMessage& header, const std::byte* payload)
+{
+    // Pick the lowest level whose range covers the delay, so that the slot comes around before the message is due
+    const std::uint64_t delay = header.frame - m_current_frame;
+    unsigned level = 0;
+    while (level < NumLevels - 1 && delay >= (std::uint64_t(1) << (SlotBits * (level + 1)))) {
+        ++level;
+    }
+    std::uint64_t slot_index;
+    if EXPECT_TAKEN(delay < (std::uint64_t(1) << (SlotBits * NumLevels))) {
+        slot_index = (header.frame >> (SlotBits * level)) & SlotMask;
+    } else {
+        // Beyond the range of the wheel: park it in the last slot to come around, it will be placed again when it does
+        slot_index = ((m_current_frame >> (SlotBits * level)) - 1) & SlotMask;
+    }
+    auto& slot = m_slots[level][slot_index];
+    const std::byte* header_ptr = reinterpret_cast<const std::byte*>(&header);
+    slot.insert(slot.end(), header_ptr, header_ptr + sizeof(memory::DelayedMessage));
+    slot.insert(slot.end(), payload, payload + header.size);
+}
+
+void messages::TimingWheel::cascade ()
+{
+    // Find the highest level whose slot boundary has been reached on this frame
+    unsigned top = 0;
+    while (top < NumLevels - 1 && (m_current_frame & ((std::uint64_t(1) << (SlotBits * (top + 1))) - 1)) == 0) {
+        ++top;
+    }
+    // Move messages down from the highest level first, so that they can keep cascading through the lower levels on this frame
+    for (unsigned level = top; level > 0; --level) {
+        auto& slot = m_slots[level][(m_current_frame >> (SlotBits * level)) & SlotMask];
+        if (! slot.empty()) {
+            std::swap(slot, m_scratch);
+            forEach(m_scratch, [this](const auto& header, const auto* payload){
+                place(header, payload);
+            });
+            m_scratch.clear();
+        }
+    }
+}
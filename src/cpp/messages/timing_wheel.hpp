@@ -0,0 +1,76 @@
+#pragma once
+
+#include <monkeys.hpp>
+#include "memory/event_pools.hpp"
+
+namespace messages {
+
+    // Hierarchical timing wheel, holding delayed messages until the frame on which they are due.
+    // Four levels of 256 slots, where each slot in level N covers 256^N frames. Inserting a message is O(1) and
+    // ticking is O(1) amortised, as messages in higher levels only cascade down when their slot comes around.
+    class TimingWheel {
+    public:
+        TimingWheel ();
+        ~TimingWheel () {}
+
+        std::uint64_t currentFrame () const { return m_current_frame; }
+        std::uint32_t pending () const { return m_pending; }
+
+        // Store a message until it is due. The message must be due after the current frame.
+        void insert (const memory::DelayedMessage& header, const std::byte* payload);
+
+        // Advance to `frame`, calling `fn(const memory::DelayedMessage&, const std::byte* payload)` for each message that has become due
+        template <typename Function>
+        void advance (std::uint64_t frame, Function fn)
+        {
+            while (m_current_frame < frame) {
+                if (m_pending == 0) {
+                    // Nothing to deliver, skip straight to the target frame
+                    m_current_frame = frame;
+                    break;
+                }
+                ++m_current_frame;
+                cascade();
+                // Every message left in the first level slot for this frame is now due
+                auto& slot = m_slots[0][m_current_frame & SlotMask];
+                if (! slot.empty()) {
+                    std::swap(slot, m_scratch);
+                    forEach(m_scratch, [this, &fn](const auto& header, const auto* payload){
+                        --m_pending;
+                        fn(header, payload);
+                    });
+                    m_scratch.clear();
+                }
+            }
+        }
+
+    private:
+        static constexpr unsigned SlotBits = 8;
+        static constexpr unsigned NumSlots = 1 << SlotBits;
+        static constexpr std::uint64_t SlotMask = NumSlots - 1;
+        static constexpr unsigned NumLevels = 4;
+
+        // Each slot holds its messages back to back, as a DelayedMessage header followed by the payload
+        using Slot = std::vector<std::byte>;
+        Slot m_slots[NumLevels][NumSlots];
+        Slot m_scratch;
+        std::uint64_t m_current_frame;
+        std::uint32_t m_pending;
+
+        void place (const memory::DelayedMessage& header, const std::byte* payload);
+        void cascade ();
+
+        template <typename Function>
+        static void forEach (const Slot& slot, Function fn)
+        {
+            const std::byte* ptr = slot.data();
+            const std::byte* end = ptr + slot.size();
+            while (ptr < end) {
+                const auto& header = *reinterpret_cast<const memory::DelayedMessage*>(ptr);
+                fn(header, ptr + sizeof(memory::DelayedMessage));
+                ptr += sizeof(memory::DelayedMessage) + header.size;
+            }
+        }
+    };
+
+}
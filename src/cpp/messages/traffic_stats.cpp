@@ -0,0 +1,108 @@
+#include "traffic_stats.hpp"
+#include "context.hpp"
+
+#include <algorithm>
+
+using MessageEnvelope = memory::MessagePool::MessageEnvelope;
+
+messages::TrafficStats::TrafficStats (std::uint32_t report_interval, std::uint32_t top_count) :
+    m_report_interval(std::max(report_interval, std::uint32_t{1})),
+    m_top_count(top_count)
+{
+
+}
+
+void messages::TrafficStats::recordPump (const std::byte* begin, const std::byte* end)
+{
+    EASY_FUNCTION(messages::COLOR(3));
+    ++m_frame_iterations;
+    const std::byte* ptr = begin;
+    while (ptr < end) {
+        const auto& envelope = *reinterpret_cast<const MessageEnvelope*>(ptr);
+        const std::uint32_t inline_size = envelope.metadata & 0xff;
+        std::uint32_t payload_size = inline_size;
+        if (envelope.metadata & memory::MessagePool::ExtendedPayloadFlag) {
+            payload_size = reinterpret_cast<const memory::MessageBlob*>(ptr + sizeof(MessageEnvelope))->size;
+        }
+        const std::uint64_t bytes = sizeof(MessageEnvelope) + payload_size;
+
+        auto& type = m_types[envelope.type];
+        ++type.count;
+        type.bytes += bytes;
+        auto& target = m_targets[(std::uint64_t(envelope.metadata >> 30) << 32) | envelope.target];
+        ++target.count;
+        target.bytes += bytes;
+        ++m_frame.count;
+        m_frame.bytes += bytes;
+
+        ptr += sizeof(MessageEnvelope) + inline_size;
+    }
+}
+
+void messages::TrafficStats::recordFanOut (std::uint32_t num_entities)
+{
+    ++m_fan_out_messages;
+    m_fan_out_entities += num_entities;
+    m_frame_fan_out += num_entities;
+    m_max_fan_out = std::max(m_max_fan_out, num_entities);
+}
+
+void messages::TrafficStats::endFrame ()
+{
+    EASY_VALUE("Messages", m_frame.count, messages::COLOR(2));
+    EASY_VALUE("Message bytes", m_frame.bytes, messages::COLOR(2));
+    EASY_VALUE("Message fan-out", m_frame_fan_out, messages::COLOR(2));
+    EASY_VALUE("Message cascade iterations", m_frame_iterations, messages::COLOR(2));
+
+    m_total.count += m_frame.count;
+    m_total.bytes += m_frame.bytes;
+    m_iterations += m_frame_iterations;
+    m_max_iterations = std::max(m_max_iterations, m_frame_iterations);
+    m_frame = Counter{};
+    m_frame_fan_out = 0;
+    m_frame_iterations = 0;
+
+    if (++m_frames >= m_report_interval) {
+        report();
+    }
+}
+
+template <typename Map>
+std::vector<std::pair<typename Map::key_type, typename Map::mapped_type>> topByBytes (const Map& map, std::uint32_t count)
+{
+    std::vector<std::pair<typename Map::key_type, typename Map::mapped_type>> sorted(map.begin(), map.end());
+    auto middle = sorted.begin() + std::min(std::size_t(count), sorted.size());
+    std::partial_sort(sorted.begin(), middle, sorted.end(), [](const auto& a, const auto& b){ return a.second.bytes > b.second.bytes; });
+    sorted.erase(middle, sorted.end());
+    return sorted;
+}
+
+void messages::TrafficStats::report ()
+{
+    EASY_FUNCTION(messages::COLOR(3));
+    const auto frames = float(m_frames);
+    spdlog::info("[messages] Traffic over {} frames: {:.1f} messages/frame, {:.1f} bytes/frame, {:.1f} cascade iterations/frame (max {}), fan-out {:.1f} entities/message (max {})",
+        m_frames,
+        m_total.count / frames,
+        m_total.bytes / frames,
+        m_iterations / frames,
+        m_max_iterations,
+        m_fan_out_messages ? float(m_fan_out_entities) / m_fan_out_messages : 0.0f,
+        m_max_fan_out);
+    for (const auto& [type, counter] : topByBytes(m_types, m_top_count)) {
+        spdlog::info("[messages]   type {:#010x}: {} messages, {} bytes", type, counter.count, counter.bytes);
+    }
+    for (const auto& [target, counter] : topByBytes(m_targets, m_top_count)) {
+        spdlog::info("[messages]   target {}:{}: {} messages, {} bytes", magic_enum::enum_name(million::events::TargetType(target >> 32)), std::uint32_t(target), counter.count, counter.bytes);
+    }
+
+    m_types.clear();
+    m_targets.clear();
+    m_total = Counter{};
+    m_fan_out_messages = 0;
+    m_fan_out_entities = 0;
+    m_max_fan_out = 0;
+    m_iterations = 0;
+    m_max_iterations = 0;
+    m_frames = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <monkeys.hpp>
+
+namespace messages {
+
+    // Instrumentation for message traffic, used to track down message storms.
+    // Per-frame totals are published to the profiler, per-type and per-target totals are logged every report interval.
+    class TrafficStats {
+    public:
+        TrafficStats (std::uint32_t report_interval, std::uint32_t top_count);
+        ~TrafficStats () {}
+
+        // Record every message gathered by a pump. Each pump is one cascade iteration.
+        void recordPump (const std::byte* begin, const std::byte* end);
+        // Record how many entities a group, entity set or composite message was delivered to
+        void recordFanOut (std::uint32_t num_entities);
+        // Publish this frame's totals and, once per report interval, log a summary
+        void endFrame ();
+
+    private:
+        struct Counter {
+            std::uint64_t count = 0;
+            std::uint64_t bytes = 0;
+        };
+
+        void report ();
+
+        const std::uint32_t m_report_interval;
+        const std::uint32_t m_top_count;
+
+        // Interval totals
+        helpers::hashed_string_node_map<Counter> m_types;
+        phmap::flat_hash_map<std::uint64_t, Counter> m_targets; // Keyed by (target type << 32) | target
+        Counter m_total;
+        std::uint64_t m_fan_out_messages = 0;
+        std::uint64_t m_fan_out_entities = 0;
+        std::uint32_t m_max_fan_out = 0;
+        std::uint64_t m_iterations = 0;
+        std::uint32_t m_max_iterations = 0;
+        std::uint32_t m_frames = 0;
+
+        // Current frame totals
+        Counter m_frame;
+        std::uint64_t m_frame_fan_out = 0;
+        std::uint32_t m_frame_iterations = 0;
+    };
+
+}
@@ -5,6 +5,7 @@
 #include "resources/resources.hpp"
 #include "messages/messages.hpp"
 #include "events/events.hpp"
+#include "memory/frame_arena.hpp"
 
 class RuntimeAPI : public million::api::EngineRuntime
 {
@@ -17,26 +18,66 @@ public:
         return world::findEntity(m_world_ctx, name);
     }
 
-    const std::string& findEntityName (const components::core::Named& named) const final
+    std::string_view findEntityName (const components::core::Named& named) const final
     {
         return world::findEntityName(m_world_ctx, named);
     }
 
-    const std::string& findEntityName (entt::entity entity) const final
+    std::string_view findEntityName (entt::entity entity) const final
     {
         return world::findEntityName(m_world_ctx, entity);
     }
 
+    void entitiesInRadius (const glm::vec3& center, float radius, std::vector<entt::entity>& entities) const final
+    {
+        world::entitiesInRadius(m_world_ctx, center, radius, entities);
+    }
+
+    void entitiesInBox (const glm::vec3& min, const glm::vec3& max, std::vector<entt::entity>& entities) const final
+    {
+        world::entitiesInBox(m_world_ctx, min, max, entities);
+    }
+
+    void nearestEntities (const glm::vec3& point, std::uint32_t count, std::vector<entt::entity>& entities) const final
+    {
+        world::nearestEntities(m_world_ctx, point, count, entities);
+    }
+
     entt::entity loadEntity (entt::hashed_string prototype_id) final
     {
         return world::loadEntity(m_world_ctx, prototype_id);
     }
 
+    std::uint32_t spawnMany (entt::hashed_string prototype_id, std::uint32_t count, entt::entity* entities) final
+    {
+        return world::spawnMany(m_world_ctx, prototype_id, count, entities);
+    }
+
+    std::vector<std::byte> snapshot (bool delta) final
+    {
+        return world::saveSnapshot(m_world_ctx, delta);
+    }
+
+    bool restore (const std::vector<std::byte>& snapshot) final
+    {
+        return world::restoreSnapshot(m_world_ctx, snapshot.data(), snapshot.size());
+    }
+
     void mergeEntity (entt::entity entity, entt::hashed_string prototype_id, bool overwrite_components) final
     {
         world::mergeEntity(m_world_ctx, entity, prototype_id, overwrite_components);
     }
 
+    void setInEntitySet (entt::hashed_string set_name, entt::entity entity, bool in_set) final
+    {
+        world::setInEntitySet(m_world_ctx, set_name.value(), entity, in_set);
+    }
+
+    std::uint32_t defineComposite (million::events::CompositeOp op, million::events::Target lhs, million::events::Target rhs) final
+    {
+        return world::defineComposite(m_world_ctx, op, lhs, rhs);
+    }
+
     million::resources::Handle findResource (entt::hashed_string::hash_type name) const final
     {
         return resources::find(m_resources_ctx, name);
@@ -62,6 +103,16 @@ public:
         return events::events(m_events_ctx, stream_name);
     }
 
+    million::memory::FrameArena& frameArena() final
+    {
+        return memory::frameArena();
+    }
+
+    million::EntityCommands& commands() final
+    {
+        return world::entityCommands(m_world_ctx);
+    }
+
 private:
     world::Context* m_world_ctx;
     resources::Context* m_resources_ctx;
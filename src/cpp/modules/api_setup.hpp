@@ -21,6 +21,11 @@ public:
         resources::install(m_resources_ctx, loader);
     }
 
+    void registerCoalescingMessage (entt::hashed_string message_type) final
+    {
+        messages::setCoalescing(m_messages_ctx, message_type);
+    }
+
     void registerGameHandler (entt::hashed_string state, entt::hashed_string::hash_type events, million::GameHandler handler) final
     {
         game::registerHandler(m_game_ctx, state, events, handler);
@@ -2,10 +2,13 @@
 #include "context.hpp"
 
 #include "events/events.hpp"
+#include "memory/heaps.hpp"
 
 void loaderThread (resources::Context* context)
 {
     EASY_THREAD("Resource Loader");
+    // Loaders may override this with a more specific subsystem
+    memory::heaps::Scope heap_scope{memory::heaps::Subsystem::Resources};
     SPDLOG_DEBUG("[resources] Starting resource loader thread");
     WorkItem item = WorkItem::POISON_PILL;
     do {
@@ -1,6 +1,8 @@
 #include "scheduler.hpp"
 #include "context.hpp"
 
+#include "world/world.hpp"
+
 int get_num_workers () {
     auto max_workers = std::thread::hardware_concurrency();
     // Keep some cores free for rendeder, resource loader and audio, but if not enough cores are available then use all available
@@ -44,6 +46,11 @@ scheduler::Context* scheduler::init (world::Context* world_ctx, scripting::Conte
     context->m_game_ctx = game_ctx;
     context->m_modules_ctx = modules_ctx;
 
+    // Scenes that are swapped out are cleared by the task workers, rather than by a thread started for each swap
+    world::setRunAsync(world_ctx, [context](std::function<void()> fn){
+        context->m_executor.silent_async(std::move(fn));
+    });
+
     context->m_timestep_cccumulator = 0.0f;
     context->m_step_size = 1.0f / 60.0f;
     context->m_frames_late = 0;
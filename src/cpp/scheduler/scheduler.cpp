@@ -53,8 +53,8 @@ bool scheduler::execute (scheduler::Context* context)
     EASY_BLOCK("scheduler::execute", scheduler::COLOR(1));
     if EXPECT_TAKEN(context->m_system_status == scheduler::SystemStatus::Running) {
         // Execute the taskflow graph if systems are running
-        context->m_executor.run(context->m_coordinator);
-        context->m_executor.wait_for_all();
+        // Wait for the graph only, not for background work on the executor (such as clearing a swapped out scene)
+        context->m_executor.run(context->m_coordinator).wait();
         return context->m_ok.load();
     } else {
         // If systems are stopped, only pump events
@@ -68,27 +68,45 @@ entt::organizer& scheduler::organizer (scheduler::Context* context, million::Sys
     return context->m_organizers[type];
 }
 
-tf::Task createTask (scheduler::Context* context, tf::Taskflow* taskflow, const char* name, const void* userdata, TaskCallback callback)
+// Engine tasks that run game code record their entity commands after those of every system stage, in this order
+enum class CoreCommandOrder : std::uint32_t {
+    GameEvents,
+    SceneEvents,
+    ScriptedBehaviors,
+    BeforeUpdateHooks,
+};
+
+std::uint32_t commandOrder (CoreCommandOrder order)
+{
+    return (std::uint32_t(magic_enum::enum_count<million::SystemStage>()) << 16) | std::uint32_t(order);
+}
+
+// `order` is the system's position in the order that entity commands are applied in
+tf::Task createTask (scheduler::Context* context, tf::Taskflow* taskflow, const char* name, const void* userdata, TaskCallback callback, std::uint32_t order)
 {
     if (name) {
-        auto fn = [context, userdata, callback, name](){
+        auto fn = [context, userdata, callback, name, order](){
             SPDLOG_TRACE("[scheduler] Running System: {}", name);
             EASY_BLOCK(name, scheduler::COLOR(2));
+            world::setCommandOrder(order);
             try {
                 callback(userdata, world::registry(context->m_world_ctx));
             } catch (const std::exception& e) {
                 context->m_ok = false;
             }
+            world::setCommandOrder(world::UNORDERED_COMMANDS);
         };
         return taskflow->emplace(fn).name(name);
     } else {
-        auto fn = [context, userdata, callback](){
+        auto fn = [context, userdata, callback, order](){
             EASY_BLOCK("Systems/task", scheduler::COLOR(2));
+            world::setCommandOrder(order);
             try {
                 callback(userdata, world::registry(context->m_world_ctx));
             } catch (const std::exception& e) {
                 context->m_ok = false;
             }
+            world::setCommandOrder(world::UNORDERED_COMMANDS);
         };
         return taskflow->emplace(fn).name("Task");
     }
@@ -122,9 +140,11 @@ void scheduler::generateTasksForSystems (scheduler::Context* context)
                 }
                 auto callback = node.callback();
                 auto userdata = node.data();
+                // Entity commands are applied by stage, then in the order the organizer lists the stage's systems
+                const auto order = (std::uint32_t(magic_enum::enum_integer(type)) << 16) | std::uint32_t(tasks.size());
                 tasks.push_back({
                     node,
-                    createTask(context, taskflow, name, userdata, callback)
+                    createTask(context, taskflow, name, userdata, callback, order)
                 });
             }
             // Second pass, set parent-child relationship of tasks
@@ -161,6 +181,10 @@ void scheduler::createTaskGraph (scheduler::Context* context)
      *                     +-> BEFORE UPDATE
      *                              |
      *                        UPDATE LOGIC [*]
+     *                              |
+     *                       ENTITY COMMANDS <---- AI EXECUTE [*], APPLY AI ACTIONS [*]
+     *                              |
+     *                      SPATIAL INDEX [*]
      * // Copy current frames events for processing next frame
      * [*] = modules of subtasks
      **/
@@ -169,31 +193,37 @@ void scheduler::createTaskGraph (scheduler::Context* context)
     Task events_game = context->m_coordinator.emplace([context](){
         EASY_BLOCK("Events/game", scheduler::COLOR(3));
         SPDLOG_TRACE("[scheduler] Running Game event handlers");
+        world::setCommandOrder(commandOrder(CoreCommandOrder::GameEvents));
         try {
             game::executeHandlers(context->m_game_ctx);
         } catch (const std::exception& e) {
             context->m_ok = false;
         }
+        world::setCommandOrder(world::UNORDERED_COMMANDS);
     }).name("events/game");
 
     Task events_scene = context->m_coordinator.emplace([context](){
         EASY_BLOCK("Events/scene", scheduler::COLOR(3));
         SPDLOG_TRACE("[scheduler] Running Scene event handlers");
+        world::setCommandOrder(commandOrder(CoreCommandOrder::SceneEvents));
         try {
             world::executeHandlers(context->m_world_ctx);
         } catch (const std::exception& e) {
             context->m_ok = false;
         }
+        world::setCommandOrder(world::UNORDERED_COMMANDS);
     }).name("events/scene");
 
     Task scripts_behavior = context->m_coordinator.emplace([context](){
         EASY_BLOCK("SveScriptsnts/behavior", scheduler::COLOR(3));
         SPDLOG_TRACE("[scheduler] Running ScriptedBehaviors");
+        world::setCommandOrder(commandOrder(CoreCommandOrder::ScriptedBehaviors));
         try {
             scripting::processMessages(context->m_scripting_ctx);
         } catch (const std::exception& e) {
             context->m_ok = false;
         }
+        world::setCommandOrder(world::UNORDERED_COMMANDS);
     }).name("scripts/behavior");
     
     Task scripts_ai = context->m_coordinator.emplace([](){
@@ -228,11 +258,13 @@ void scheduler::createTaskGraph (scheduler::Context* context)
 
     Task before_update = context->m_coordinator.emplace([context](){
         SPDLOG_TRACE("[scheduler] Running before_update hooks");
+        world::setCommandOrder(commandOrder(CoreCommandOrder::BeforeUpdateHooks));
         try {
             modules::hooks::before_update(context->m_modules_ctx);
         } catch (const std::exception& e) {
             context->m_ok = false;
         }
+        world::setCommandOrder(world::UNORDERED_COMMANDS);
     }).name("hooks/before-update");
 
     Task game_logic = context->m_coordinator.emplace([context](tf::Subflow& subflow){
@@ -255,6 +287,34 @@ void scheduler::createTaskGraph (scheduler::Context* context)
         }
     }).name("systems/update");
 
+    Task entity_commands = context->m_coordinator.emplace([context](){
+        EASY_BLOCK("World/entity-commands", scheduler::COLOR(3));
+        SPDLOG_TRACE("[scheduler] Applying entity commands");
+        try {
+            world::applyEntityCommands(context->m_world_ctx);
+        } catch (const std::exception& e) {
+            context->m_ok = false;
+        }
+    }).name("world/entity-commands");
+
+    Task spatial_index = context->m_coordinator.emplace([context](tf::Subflow& subflow){
+        EASY_BLOCK("World/spatial-index", scheduler::COLOR(3));
+        SPDLOG_TRACE("[scheduler] Updating spatial index");
+        try {
+            world::updateSpatialIndex(context->m_world_ctx, [context, &subflow](std::uint32_t count, const auto& fn){
+                // Split into one chunk per worker, but not so small that scheduling the chunks costs more than the work
+                const std::uint32_t chunk_size = std::max<std::uint32_t>(1024, count / std::uint32_t(context->m_executor.num_workers()) + 1);
+                for (std::uint32_t begin = 0; begin < count; begin += chunk_size) {
+                    const auto end = std::min(count, begin + chunk_size);
+                    subflow.emplace([&fn, begin, end](){ fn(begin, end); });
+                }
+                subflow.join();
+            });
+        } catch (const std::exception& e) {
+            context->m_ok = false;
+        }
+    }).name("world/spatial-index");
+
     Task actions = context->m_coordinator.emplace([context](tf::Subflow& subflow){
         EASY_BLOCK("Systems/actions", scheduler::COLOR(3));
         tf::Taskflow* actions_flow = helpers::find_or(context->m_systems, million::SystemStage::Actions, nullptr);
@@ -280,6 +340,10 @@ void scheduler::createTaskGraph (scheduler::Context* context)
     game_logic.before(before_update, physics_step);
     before_update >> pump_events;
     update_logic.after(pump_events, physics_step);
+    // Every system stage may record entity commands, so they are applied once all of them are done
+    entity_commands.after(update_logic, actions, ai_execute);
+    // Once all systems have run, so that the index is current for next frame's queries and includes entities they created
+    entity_commands >> spatial_index;
 
 #ifdef DEBUG_BUILD
     const std::string& task_graph = entt::monostate<"dev/export-task-graph"_hs>();
@@ -2,6 +2,7 @@
 #include "context.hpp"
 
 #include "world/world.hpp"
+#include "messages/messages.hpp"
 #include "core/components.hpp"
 
 extern "C" std::uint32_t null_entity_value ()
@@ -22,6 +23,45 @@ extern "C" std::uint32_t entity_create_from_prototype (scripting::Context* conte
     return magic_enum::enum_integer(world::loadEntity(context->m_world_ctx, entt::hashed_string{prototype}));
 }
 
+extern "C" std::uint32_t entity_spawn_many (scripting::Context* context, const char* prototype, std::uint32_t count, std::uint32_t* entities)
+{
+    EASY_FUNCTION(scripting::COLOR(3));
+    static_assert(sizeof(entt::entity) == sizeof(std::uint32_t), "Lua expects 32 bit entities");
+    return world::spawnMany(context->m_world_ctx, entt::hashed_string{prototype}, count, reinterpret_cast<entt::entity*>(entities));
+}
+
+// Copy up to `max` of the entities found by a spatial query to `entities`, returning how many were found
+std::uint32_t copyQueryResults (const std::vector<entt::entity>& found, std::uint32_t* entities, std::uint32_t max)
+{
+    const auto count = std::min(max, std::uint32_t(found.size()));
+    std::copy_n(reinterpret_cast<const std::uint32_t*>(found.data()), count, entities);
+    return std::uint32_t(found.size());
+}
+
+extern "C" std::uint32_t spatial_query_radius (scripting::Context* context, float x, float y, float z, float radius, std::uint32_t* entities, std::uint32_t max)
+{
+    EASY_FUNCTION(scripting::COLOR(3));
+    thread_local std::vector<entt::entity> found;
+    world::entitiesInRadius(context->m_world_ctx, {x, y, z}, radius, found);
+    return copyQueryResults(found, entities, max);
+}
+
+extern "C" std::uint32_t spatial_query_box (scripting::Context* context, float min_x, float min_y, float min_z, float max_x, float max_y, float max_z, std::uint32_t* entities, std::uint32_t max)
+{
+    EASY_FUNCTION(scripting::COLOR(3));
+    thread_local std::vector<entt::entity> found;
+    world::entitiesInBox(context->m_world_ctx, {min_x, min_y, min_z}, {max_x, max_y, max_z}, found);
+    return copyQueryResults(found, entities, max);
+}
+
+extern "C" std::uint32_t spatial_query_nearest (scripting::Context* context, float x, float y, float z, std::uint32_t count, std::uint32_t* entities)
+{
+    EASY_FUNCTION(scripting::COLOR(3));
+    thread_local std::vector<entt::entity> found;
+    world::nearestEntities(context->m_world_ctx, {x, y, z}, count, found);
+    return copyQueryResults(found, entities, count);
+}
+
 extern "C" void entity_destroy (scripting::Context* context, std::uint32_t entity)
 {
     EASY_FUNCTION(scripting::COLOR(3));
@@ -154,10 +194,14 @@ extern "C" std::uint32_t get_group (scripting::Context* context, std::uint32_t g
     const auto& registry = world::registry(context->m_world_ctx);
     const auto& storage = registry.storage<core::EntityGroup>(entt::hashed_string::hash_type(group));
     *entities = reinterpret_cast<const uint32_t*>(storage.data());
+    messages::recordFanOut(context->m_messages_ctx, storage.size());
     return storage.size();
 }
 
-extern "C" std::uint32_t get_entity_composite (scripting::Context* context, std::uint32_t, const std::uint32_t**)
+extern "C" std::uint32_t get_entity_composite (scripting::Context* context, std::uint32_t composite, const std::uint32_t** entities)
 {
-    return 0;
+    const auto& composite_entities = world::entityComposite(context->m_world_ctx, composite);
+    *entities = reinterpret_cast<const uint32_t*>(composite_entities.data());
+    messages::recordFanOut(context->m_messages_ctx, composite_entities.size());
+    return composite_entities.size();
 }
@@ -16,13 +16,18 @@ extern "C" std::uint32_t get_category (scripting::Context* context, const char*
     return 0;
 }
 
-extern "C" void* allocate_message (scripting::Context* context, const char* message_name, std::uint32_t target, std::uint16_t flags, std::uint16_t size)
+extern "C" void* allocate_message (scripting::Context* context, const char* message_name, std::uint32_t target, std::uint32_t flags, std::uint32_t size)
 {
     EASY_FUNCTION(scripting::COLOR(3));
     entt::hashed_string::hash_type message_type = entt::hashed_string::value(message_name);
     return messages::publisher(context->m_messages_ctx).push(message_type, target, flags, size);
 }
 
+extern "C" void set_message_coalescing (scripting::Context* context, const char* message_name)
+{
+    messages::setCoalescing(context->m_messages_ctx, entt::hashed_string::value(message_name));
+}
+
 extern "C" std::uint32_t get_messages (scripting::Context* context, const char** buffer)
 {
     EASY_FUNCTION(scripting::COLOR(3));
@@ -32,6 +37,11 @@ extern "C" std::uint32_t get_messages (scripting::Context* context, const char**
     return end - begin;
 }
 
+extern "C" const char* get_message_blobs (scripting::Context* context)
+{
+    return reinterpret_cast<const char*>(messages::blobs(context->m_messages_ctx));
+}
+
 extern "C" std::uint32_t get_stream_events (scripting::Context* context, std::uint32_t stream_name, const char** buffer)
 {
     EASY_FUNCTION(scripting::COLOR(3));
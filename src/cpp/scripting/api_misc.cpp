@@ -4,12 +4,34 @@
 #include "core/engine.hpp"
 
 #include "resources/resources.hpp"
+#include "world/world.hpp"
+#include "messages/messages.hpp"
 
 #include <stdexcept>
 
-extern "C" std::uint32_t get_entity_set (scripting::Context* context, std::uint32_t, const std::uint32_t**)
+extern "C" std::uint32_t get_entity_set (scripting::Context* context, std::uint32_t set, const std::uint32_t** entities)
 {
-    return 0;
+    EASY_FUNCTION(scripting::COLOR(3));
+    const auto& entity_set = world::entitySet(context->m_world_ctx, entt::hashed_string::hash_type(set));
+    *entities = reinterpret_cast<const uint32_t*>(entity_set.data());
+    messages::recordFanOut(context->m_messages_ctx, entity_set.size());
+    return entity_set.size();
+}
+
+extern "C" void entity_set_update (scripting::Context* context, std::uint32_t entity, const char* set_name, bool in_set)
+{
+    EASY_FUNCTION(scripting::COLOR(3));
+    world::setInEntitySet(context->m_world_ctx, entt::hashed_string::value(set_name), static_cast<entt::entity>(entity), in_set);
+}
+
+extern "C" std::uint32_t define_composite (scripting::Context* context, std::uint32_t op, std::uint32_t lhs_type, std::uint32_t lhs, std::uint32_t rhs_type, std::uint32_t rhs)
+{
+    EASY_FUNCTION(scripting::COLOR(3));
+    return world::defineComposite(
+        context->m_world_ctx,
+        million::events::CompositeOp(op),
+        {million::events::TargetType(lhs_type), lhs},
+        {million::events::TargetType(rhs_type), rhs});
 }
 
 extern "C" void output_log (scripting::Context* context, std::uint32_t level, const char* message)
@@ -1,6 +1,7 @@
 
 #include "scripting.hpp"
 #include "context.hpp"
+#include "memory/heaps.hpp"
 
 #include <spdlog/fmt/fmt.h>
 #include <lua.hpp>
@@ -24,6 +25,7 @@ bool scripting::load (scripting::Context* context, const std::string& filename)
 bool scripting::evaluate (scripting::Context* context, const std::string& name, const std::string& source)
 {
     EASY_BLOCK("Scripts/evaluate", scripting::COLOR(2));
+    memory::heaps::Scope heap_scope{memory::heaps::Subsystem::Scripting};
     SPDLOG_TRACE("[script] Evaluating code");
     // Only one thread can execute Lua code at once
     std::lock_guard<std::mutex> guard(context->m_vm_mutex);
@@ -49,6 +51,7 @@ bool scripting::evaluate (scripting::Context* context, const std::string& name,
 void scripting::detail::call (scripting::Context* context, const std::string& function, const scripting::detail::VariantVector& args)
 {
     EASY_BLOCK("Scripts/call", scripting::COLOR(1));
+    memory::heaps::Scope heap_scope{memory::heaps::Subsystem::Scripting};
     SPDLOG_TRACE("[script] Calling function {}", function);
 
     // Only one thread can execute Lua code at once
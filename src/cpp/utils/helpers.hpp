@@ -1,8 +1,14 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <functional>
 #include <memory>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
 
 namespace helpers {
 
@@ -244,6 +250,110 @@ namespace helpers {
         return pointer + ((-pointer) & (bytes_alignment - 1));
     }
 
+    ///////////////////////////////////////////////////////////////////////////
+    // Build a binary file out of aligned sections, addressed by their offset
+    ///////////////////////////////////////////////////////////////////////////
+    class SectionWriter {
+    public:
+        static constexpr std::size_t Alignment = 16;
+
+        // Append a section, returning its offset
+        std::uint32_t append (const void* data, std::size_t size) {
+            const std::size_t offset = (m_bytes.size() + Alignment - 1) & ~(Alignment - 1);
+            m_bytes.resize(offset + size);
+            if (size > 0) {
+                std::memcpy(m_bytes.data() + offset, data, size);
+            }
+            return std::uint32_t(offset);
+        }
+        template <typename T> std::uint32_t append (const std::vector<T>& values) {
+            return append(values.data(), values.size() * sizeof(T));
+        }
+        std::vector<std::byte>& bytes () { return m_bytes; }
+        const std::vector<std::byte>& bytes () const { return m_bytes; }
+    private:
+        std::vector<std::byte> m_bytes;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // NUL terminated strings packed one after another, each stored once and
+    // addressed by its offset, to be written out as a section
+    ///////////////////////////////////////////////////////////////////////////
+    class StringTable {
+    public:
+        std::uint32_t add (const std::string& string) {
+            auto it = m_offsets.find(string);
+            if (it != m_offsets.end()) {
+                return it->second;
+            }
+            const auto offset = std::uint32_t(m_chars.size());
+            m_chars.insert(m_chars.end(), string.begin(), string.end());
+            m_chars.push_back('\0');
+            m_offsets[string] = offset;
+            return offset;
+        }
+        const std::vector<char>& chars () const { return m_chars; }
+    private:
+        std::vector<char> m_chars;
+        phmap::flat_hash_map<std::string, std::uint32_t> m_offsets;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Copies of strings packed into large blocks, which stay valid (and NUL
+    // terminated) until the arena is cleared. Strings are never freed one by
+    // one, but each distinct string is only stored once
+    ///////////////////////////////////////////////////////////////////////////
+    class StringArena {
+    public:
+        StringArena (std::size_t block_size = 64 * 1024) : m_block_size(block_size) {}
+
+        std::string_view intern (std::string_view str) {
+            auto it = m_strings.find(str);
+            if (it != m_strings.end()) {
+                return *it;
+            }
+            const std::size_t size = str.size() + 1;
+            if (m_used + size > m_capacity) {
+                m_capacity = std::max(m_block_size, size);
+                m_blocks.push_back({std::unique_ptr<char[]>(new char[m_capacity]), m_capacity});
+                m_used = 0;
+            }
+            char* copy = m_blocks.back().data.get() + m_used;
+            str.copy(copy, str.size());
+            copy[str.size()] = '\0';
+            m_used += size;
+            m_size += size;
+            const std::string_view interned{copy, str.size()};
+            m_strings.insert(interned);
+            return interned;
+        }
+        // Whether a string was interned by this arena (and is still valid)
+        bool owns (const char* str) const {
+            const auto address = std::uintptr_t(str);
+            return std::any_of(m_blocks.begin(), m_blocks.end(), [address](const auto& block){
+                return address >= std::uintptr_t(block.data.get()) && address < std::uintptr_t(block.data.get()) + block.capacity;
+            });
+        }
+        // Bytes used by the interned strings
+        std::size_t size () const { return m_size; }
+        void clear () {
+            m_blocks.clear();
+            m_strings.clear();
+            m_used = m_capacity = m_size = 0;
+        }
+    private:
+        struct Block {
+            std::unique_ptr<char[]> data;
+            std::size_t capacity;
+        };
+        std::size_t m_block_size;
+        std::size_t m_used = 0;
+        std::size_t m_capacity = 0;
+        std::size_t m_size = 0;
+        std::vector<Block> m_blocks;
+        phmap::flat_hash_set<std::string_view> m_strings;
+    };
+
     ///////////////////////////////////////////////////////////////////////////
     // Number rounding
     ///////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,438 @@
+#include "baked_scene.hpp"
+#include "world.hpp"
+#include "context.hpp"
+#include "loaders/scene_entities.hpp"
+
+#include "core/components.hpp"
+#include "memory/heaps.hpp"
+
+#include <physfs.hpp>
+
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char MAGIC[8] = {'M', 'M', 'B', 'A', 'K', 'E', 'D', '\0'};
+
+    baked::Header readHeader (physfs::ifstream& stream, const std::string& filename)
+    {
+        baked::Header head;
+        if (! stream.read(reinterpret_cast<char*>(&head), sizeof(baked::Header)) || std::memcmp(head.magic, MAGIC, sizeof(MAGIC)) != 0 || head.version != baked::VERSION) {
+            throw std::runtime_error("Not a baked scene, or baked with a different version: " + filename);
+        }
+        return head;
+    }
+
+    std::uint32_t sourceHash (const std::string& source)
+    {
+        return entt::hashed_string::value(source.data(), source.size());
+    }
+
+    entt::registry& registryFor (RegistryPair& registries, baked::Registry registry)
+    {
+        return registry == baked::Registry::Prototypes ? registries.prototypes : registries.runtime;
+    }
+
+    // A column being baked
+    struct ColumnData {
+        baked::Column column;
+        std::vector<std::uint32_t> rows;
+        std::vector<std::byte> data;
+    };
+}
+
+baked::Scene::Scene (const std::string& filename) :
+    m_data(nullptr),
+    m_size(0),
+    m_mapped(false)
+{
+    EASY_FUNCTION(world::COLOR(3));
+    if (! physfs::exists(filename)) {
+        throw std::invalid_argument("File could not be read: " + filename);
+    }
+    // Files on the real filesystem are mapped, so only the pages that are touched get read. Files in archives have to be read in full.
+    const auto real_dir = physfs::getRealDir(filename);
+    const auto real_path = std::filesystem::path(real_dir) / std::filesystem::path(filename).relative_path();
+    if (! real_dir.empty() && std::filesystem::is_regular_file(real_path)) {
+        const int fd = open(real_path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* ptr = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED) {
+                m_data = reinterpret_cast<const std::byte*>(ptr);
+                m_size = std::size_t(info.st_size);
+                m_mapped = true;
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (! m_mapped) {
+        physfs::ifstream stream(filename);
+        std::vector<char> contents{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+        m_buffer.resize(contents.size());
+        std::memcpy(m_buffer.data(), contents.data(), contents.size());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+
+    // Validate everything up front, so that instantiating never reads outside of the file
+    const auto in_bounds = [this](std::size_t offset, std::size_t size) { return offset <= m_size && size <= m_size - offset; };
+    if (m_size < sizeof(Header) || std::memcmp(header().magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a baked scene: " + filename);
+    }
+    const auto& head = header();
+    if (head.version != VERSION) {
+        throw std::runtime_error(fmt::format("Baked scene '{}' has version {}, expected {}: it must be re-baked", filename, head.version, VERSION));
+    }
+    bool valid = in_bounds(head.columns_offset, std::size_t(head.num_columns) * sizeof(Column))
+        && in_bounds(head.manifest_offset, head.manifest_size)
+        && in_bounds(head.strings_offset, head.strings_size)
+        && (head.strings_size == 0 || string(0)[head.strings_size - 1] == '\0');
+    std::uint32_t work = 0;
+    for (auto registry : {Registry::Runtime, Registry::Prototypes}) {
+        const auto index = std::size_t(registry);
+        valid = valid && in_bounds(head.entities_offset[index], std::size_t(head.num_entities[index]) * sizeof(entt::entity));
+        work += head.num_entities[index];
+    }
+    for (std::uint32_t index = 0; valid && index < head.num_columns; ++index) {
+        const auto& col = column(index);
+        valid = in_bounds(col.rows_offset, std::size_t(col.count) * sizeof(std::uint32_t))
+            && in_bounds(col.data_offset, std::size_t(col.count) * col.element_size)
+            && col.data_offset % helpers::SectionWriter::Alignment == 0
+            && std::size_t(col.registry) < 2;
+        const auto* rows = at<std::uint32_t>(col.rows_offset);
+        for (std::uint32_t row = 0; valid && row < col.count; ++row) {
+            valid = rows[row] < head.num_entities[std::size_t(col.registry)];
+        }
+        // Named and Loader columns hold string table offsets
+        if (valid && (col.kind == ColumnKind::Named || col.kind == ColumnKind::Loader)) {
+            valid = col.element_size == sizeof(std::uint32_t) && (col.kind != ColumnKind::Loader || col.component_name < head.strings_size);
+            const auto* offsets = at<std::uint32_t>(col.data_offset);
+            for (std::uint32_t row = 0; valid && row < col.count; ++row) {
+                valid = offsets[row] < head.strings_size;
+            }
+        }
+        m_column_work.push_back(work);
+        work += col.count;
+    }
+    if (! valid) {
+        throw std::runtime_error("Baked scene is corrupt: " + filename);
+    }
+    m_column_work.push_back(work);
+}
+
+baked::Scene::~Scene ()
+{
+    if (m_mapped) {
+        munmap(const_cast<std::byte*>(m_data), m_size);
+    }
+}
+
+std::uint32_t baked::Scene::totalWork () const
+{
+    return m_column_work.back();
+}
+
+std::uint32_t baked::Scene::numEntities () const
+{
+    const auto& head = header();
+    return head.num_entities[std::size_t(Registry::Runtime)] + head.num_entities[std::size_t(Registry::Prototypes)];
+}
+
+std::uint32_t baked::Scene::instantiate (world::Context* context, RegistryPair& registries, std::uint32_t next, std::uint32_t budget)
+{
+    EASY_FUNCTION(world::COLOR(3));
+    const auto& head = header();
+    const std::uint32_t end = totalWork() - next > budget ? next + budget : totalWork();
+
+    // Entities first, created with the ids they were baked with so that entity references in component data stay valid
+    const std::uint32_t num_runtime = head.num_entities[std::size_t(Registry::Runtime)];
+    const std::uint32_t num_entities = num_runtime + head.num_entities[std::size_t(Registry::Prototypes)];
+    std::uint32_t remapped = 0;
+    for (; next < end && next < num_entities; ++next) {
+        const auto registry = next < num_runtime ? Registry::Runtime : Registry::Prototypes;
+        const auto index = std::size_t(registry);
+        const auto hint = at<entt::entity>(head.entities_offset[index])[m_entities[index].size()];
+        const auto entity = registryFor(registries, registry).create(hint);
+        remapped += entity != hint;
+        m_entities[index].push_back(entity);
+    }
+    if (remapped > 0) {
+        spdlog::warn("[scene] {} baked entities could not keep their ids, entity references to them will be wrong", remapped);
+    }
+
+    // Then components, a column at a time
+    auto column_it = std::upper_bound(m_column_work.begin(), m_column_work.end() - 1, next);
+    while (next < end) {
+        const auto index = std::uint32_t(std::distance(m_column_work.begin(), column_it) - 1);
+        const auto first = next - m_column_work[index];
+        const auto last = std::min(end, m_column_work[index + 1]) - m_column_work[index];
+        insertRows(context, registries, column(index), first, last);
+        next += last - first;
+        ++column_it;
+    }
+    return next;
+}
+
+void baked::Scene::insertRows (world::Context* context, RegistryPair& registries, const Column& col, std::uint32_t first, std::uint32_t last)
+{
+    auto& registry = registryFor(registries, col.registry);
+    const auto& entities = m_entities[std::size_t(col.registry)];
+    const auto* rows = at<std::uint32_t>(col.rows_offset);
+    if (col.registry == Registry::Prototypes) {
+        registries.prototypesChanged();
+    }
+    switch (col.kind) {
+        case ColumnKind::Raw:
+        {
+            auto it = registry.storage(col.storage_id);
+            std::size_t size = 0;
+            if (it == registry.storage().end()) {
+                spdlog::error("[scene] Baked scene has data for a component that does not exist: {:x}", col.storage_id);
+                return;
+            } else if (col.element_size != 0 && (! rawComponentSize(context, col.storage_id, size) || size != col.element_size)) {
+                spdlog::error("[scene] Baked scene data for component {:x} does not match the component, the scene must be re-baked", col.storage_id);
+                return;
+            }
+            auto& storage = it->second;
+            storage.reserve(storage.size() + (last - first));
+            const auto* data = at<std::byte>(col.data_offset);
+            for (auto row = first; row < last; ++row) {
+                const auto entity = entities[rows[row]];
+                if (! storage.contains(entity)) {
+                    storage.emplace(entity, col.element_size != 0 ? data + std::size_t(row) * col.element_size : nullptr);
+                }
+            }
+            break;
+        }
+        case ColumnKind::Named:
+        {
+            const auto* names = at<std::uint32_t>(col.data_offset);
+            for (auto row = first; row < last; ++row) {
+                registry.emplace<components::core::Named>(entities[rows[row]], entt::hashed_string{string(names[row])});
+            }
+            break;
+        }
+        case ColumnKind::Group:
+        {
+            auto& storage = registry.storage<core::EntityGroup>(col.storage_id);
+            for (auto row = first; row < last; ++row) {
+                storage.emplace(entities[rows[row]]);
+            }
+            break;
+        }
+        case ColumnKind::Loader:
+        {
+            const auto* sources = at<std::uint32_t>(col.data_offset);
+            const entt::hashed_string component{string(col.component_name)};
+            for (auto row = first; row < last; ++row) {
+                std::istringstream iss(string(sources[row]));
+                const auto table = toml::parse<toml::discard_comments, tsl::ordered_map, std::vector>(iss, component.data());
+                toml::value value = table.at("component");
+                loadComponent(context, registry, component, entities[rows[row]], reinterpret_cast<const void*>(&value));
+            }
+            break;
+        }
+    }
+}
+
+std::string baked::bakedFilename (const std::string& scene_filename)
+{
+    return std::filesystem::path(scene_filename).replace_extension(EXTENSION).string();
+}
+
+TomlValue baked::parseManifest (const std::string& filename)
+{
+    physfs::ifstream stream(filename);
+    const auto head = readHeader(stream, filename);
+    std::string manifest(head.manifest_size, '\0');
+    stream.seekg(head.manifest_offset);
+    if (! stream.read(manifest.data(), head.manifest_size)) {
+        throw std::runtime_error("Baked scene is corrupt: " + filename);
+    }
+    std::istringstream iss(manifest);
+    return toml::parse<toml::discard_comments, tsl::ordered_map, std::vector>(iss, filename);
+}
+
+bool baked::isCurrent (const std::string& filename, const std::string& scene_filename)
+{
+    EASY_FUNCTION(world::COLOR(3));
+    try {
+        physfs::ifstream stream(filename);
+        const auto head = readHeader(stream, filename);
+        const auto source = helpers::readToString(scene_filename);
+        return head.source_size == source.size() && head.source_hash == sourceHash(source);
+    } catch (const std::exception& e) {
+        spdlog::warn("[scene] Could not check baked scene '{}': {}", filename, e.what());
+        return false;
+    }
+}
+
+bool baked::bake (world::Context* context, const std::string& scene_filename, const std::string& output_filename)
+{
+    EASY_FUNCTION(world::COLOR(3));
+    memory::heaps::Scope heap_scope{memory::heaps::Subsystem::World};
+    TomlValue config;
+    std::string source;
+    try {
+        source = helpers::readToString(scene_filename);
+        config = parser::parse_toml(scene_filename);
+    } catch (const std::exception& e) {
+        spdlog::error("[scene] Could not bake '{}': {}", scene_filename, e.what());
+        return false;
+    }
+
+    // Load the scene into scratch registries, exactly as an unbaked scene would be loaded, remembering each entity's source
+    RegistryPair scratch;
+    std::vector<entt::entity> entities[2];
+    std::vector<const TomlValue*> sources[2];
+    phmap::flat_hash_map<entt::entity, std::uint32_t> rows[2];
+    const auto create = [&](Registry registry, const char* key, auto createFn) {
+        if (config.contains(key)) {
+            const auto index = std::size_t(registry);
+            for (const auto& source : config.at(key).as_array()) {
+                const auto entity = createFn(context, registryFor(scratch, registry), source);
+                if (entity != entt::null) {
+                    entities[index].push_back(entity);
+                    sources[index].push_back(&source);
+                }
+            }
+        }
+    };
+    create(Registry::Prototypes, "prototypes", &loaders::SceneEntities::createPrototype);
+    create(Registry::Runtime, "entity", &loaders::SceneEntities::createEntity);
+    for (auto registry : {Registry::Runtime, Registry::Prototypes}) {
+        // Prototypes that were replaced by a later one of the same name have been destroyed
+        const auto index = std::size_t(registry);
+        std::uint32_t kept = 0;
+        for (std::uint32_t row = 0; row < entities[index].size(); ++row) {
+            if (registryFor(scratch, registry).valid(entities[index][row])) {
+                entities[index][kept] = entities[index][row];
+                sources[index][kept] = sources[index][row];
+                rows[index][entities[index][kept]] = kept;
+                ++kept;
+            }
+        }
+        entities[index].resize(kept);
+        sources[index].resize(kept);
+    }
+
+    // Turn each storage into a column
+    helpers::StringTable strings;
+    std::vector<ColumnData> columns;
+    for (auto registry : {Registry::Runtime, Registry::Prototypes}) {
+        const auto index = std::size_t(registry);
+        for (auto [id, storage] : registryFor(scratch, registry).storage()) {
+            if (storage.empty()) {
+                continue;
+            }
+            ColumnData data{};
+            data.column.registry = registry;
+            data.column.storage_id = id;
+            for (const auto entity : storage) {
+                data.rows.push_back(rows[index].at(entity));
+            }
+            std::size_t size = 0;
+            if (storage.type() == entt::type_id<components::core::Named>()) {
+                data.column.kind = ColumnKind::Named;
+                for (const auto entity : storage) {
+                    const auto offset = strings.add(static_cast<const components::core::Named*>(storage.get(entity))->name.data());
+                    data.data.resize(data.data.size() + sizeof(offset));
+                    std::memcpy(data.data.data() + data.data.size() - sizeof(offset), &offset, sizeof(offset));
+                }
+                data.column.element_size = sizeof(std::uint32_t);
+            } else if (storage.type() == entt::type_id<core::EntityGroup>()) {
+                data.column.kind = ColumnKind::Group;
+            } else if (storage.get(*storage.begin()) == nullptr) {
+                data.column.kind = ColumnKind::Raw; // Tag component, no data
+            } else if (rawComponentSize(context, id, size)) {
+                data.column.kind = ColumnKind::Raw;
+                data.column.element_size = std::uint32_t(size);
+                for (const auto entity : storage) {
+                    const auto* value = reinterpret_cast<const std::byte*>(storage.get(entity));
+                    data.data.insert(data.data.end(), value, value + size);
+                }
+            } else if (auto it = context->m_component_info.find(id); it != context->m_component_info.end()) {
+                // Keep the component's TOML, to load it through its loader
+                data.column.kind = ColumnKind::Loader;
+                data.column.component_name = strings.add(it->second.name);
+                data.column.element_size = sizeof(std::uint32_t);
+                data.rows.clear();
+                for (const auto entity : storage) {
+                    const auto row = rows[index].at(entity);
+                    const auto& source = *sources[index][row];
+                    if (! source.contains(it->second.name)) {
+                        spdlog::warn("[scene] In '{}', component '{}' was not loaded from the scene, it will be missing from the baked scene", scene_filename, it->second.name);
+                        continue;
+                    }
+                    TomlValue wrapper = TomlTable{{"component", source.at(it->second.name)}};
+                    const auto offset = strings.add(toml::format(wrapper));
+                    data.rows.push_back(row);
+                    data.data.resize(data.data.size() + sizeof(offset));
+                    std::memcpy(data.data.data() + data.data.size() - sizeof(offset), &offset, sizeof(offset));
+                }
+            } else {
+                spdlog::warn("[scene] In '{}', storage {:x} is not a known component, it will be missing from the baked scene", scene_filename, id);
+                continue;
+            }
+            data.column.count = std::uint32_t(data.rows.size());
+            columns.push_back(std::move(data));
+        }
+    }
+    // Loaders may depend on other components already being there, so they run last
+    std::stable_partition(columns.begin(), columns.end(), [](const auto& data){ return data.column.kind != ColumnKind::Loader; });
+
+    // Lay out the file
+    helpers::SectionWriter writer;
+    Header head{};
+    writer.append(&head, sizeof(Header));
+    std::memcpy(head.magic, MAGIC, sizeof(MAGIC));
+    head.version = VERSION;
+    head.source_size = std::uint32_t(source.size());
+    head.source_hash = sourceHash(source);
+    TomlValue manifest = config;
+    manifest.as_table().erase("entity");
+    manifest.as_table().erase("prototypes");
+    const auto manifest_text = toml::format(manifest);
+    head.manifest_offset = writer.append(manifest_text.data(), manifest_text.size());
+    head.manifest_size = std::uint32_t(manifest_text.size());
+    head.strings_offset = writer.append(strings.chars());
+    head.strings_size = std::uint32_t(strings.chars().size());
+    for (auto registry : {Registry::Runtime, Registry::Prototypes}) {
+        const auto index = std::size_t(registry);
+        head.num_entities[index] = std::uint32_t(entities[index].size());
+        head.entities_offset[index] = writer.append(entities[index]);
+    }
+    std::vector<Column> table;
+    for (auto& data : columns) {
+        data.column.rows_offset = writer.append(data.rows);
+        data.column.data_offset = writer.append(data.data);
+        table.push_back(data.column);
+    }
+    head.num_columns = std::uint32_t(table.size());
+    head.columns_offset = writer.append(table);
+    std::memcpy(writer.bytes().data(), &head, sizeof(Header));
+
+    try {
+        const auto output_path = std::filesystem::path(output_filename);
+        if (output_path.has_parent_path()) {
+            std::filesystem::create_directories(output_path.parent_path());
+        }
+        std::ofstream out(output_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(writer.bytes().data()), std::streamsize(writer.bytes().size()));
+        if (! out) {
+            throw std::runtime_error("write failed");
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("[scene] Could not write baked scene '{}': {}", output_filename, e.what());
+        return false;
+    }
+    spdlog::info("[scene] Baked '{}' into '{}': {} entities, {} prototypes, {} columns, {} bytes", scene_filename, output_filename,
+        head.num_entities[std::size_t(Registry::Runtime)], head.num_entities[std::size_t(Registry::Prototypes)], head.num_columns, writer.bytes().size());
+    return true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <monkeys.hpp>
+#include "utils/parser.hpp"
+
+struct RegistryPair;
+
+// Baked scenes are scene files that have been converted ahead of time (with --bake-scenes) into a binary format that can be loaded
+// without parsing. Instead of one TOML table per entity, components are stored in columns: one column per component type per registry,
+// holding the entities that have the component and their raw component data, which is copied straight into the component's storage.
+// Components that cannot be copied as raw bytes (those holding resource handles or pointers, or whose attributes were not described) keep
+// their TOML source and are loaded through their component loader, like an unbaked scene. Named component names and TOML sources are stored in a string table.
+// If a baked file (<scene>.baked) exists next to a scene's TOML file, it is loaded instead, as long as it was baked from the TOML file as it
+// is now (otherwise the TOML file is loaded, with a warning). Baked files must also be re-baked when the layout of any of their components
+// changes: columns whose size no longer matches their component are skipped with an error.
+namespace baked {
+
+    constexpr const char* EXTENSION = ".baked";
+    constexpr std::uint32_t VERSION = 2;
+
+    enum class Registry : std::uint32_t {
+        Runtime = 0,
+        Prototypes = 1,
+    };
+
+    enum class ColumnKind : std::uint32_t {
+        Raw,    // Component data copied bytewise (empty for tag components)
+        Named,  // String table offset of each entity's name
+        Group,  // Entities only, stored in a named group storage
+        Loader, // String table offset of each entity's TOML source, loaded through the component's loader
+    };
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t num_columns;
+        std::uint32_t columns_offset;
+        std::uint32_t manifest_offset;  // TOML of the scene without its entities and prototypes (resources, scripts, ...)
+        std::uint32_t manifest_size;
+        std::uint32_t strings_offset;
+        std::uint32_t strings_size;
+        std::uint32_t num_entities[2];  // Indexed by Registry
+        std::uint32_t entities_offset[2];
+        std::uint32_t source_size;      // Size and hash of the TOML file the scene was baked from
+        std::uint32_t source_hash;
+    };
+
+    struct Column {
+        Registry registry;
+        ColumnKind kind;
+        entt::id_type storage_id;       // Component type id, or group name for groups
+        std::uint32_t component_name;   // String table offset of the component's name, for Loader columns
+        std::uint32_t count;
+        std::uint32_t element_size;
+        std::uint32_t rows_offset;      // Index of each row's entity in the registry's entity list
+        std::uint32_t data_offset;
+    };
+
+    // A baked scene file, memory mapped if it is a real file and read into memory if it is in an archive
+    class Scene {
+    public:
+        Scene (const std::string& filename);
+        ~Scene ();
+        Scene (const Scene&) = delete;
+        Scene& operator= (const Scene&) = delete;
+
+        // Number of entities to create plus number of component rows to insert, the unit of scene loading progress
+        std::uint32_t totalWork () const;
+        // Number of entities to create, prototypes included
+        std::uint32_t numEntities () const;
+
+        // Create entities and insert component rows, starting from `next`, until `budget` work is done. Returns the new `next`.
+        std::uint32_t instantiate (world::Context* context, RegistryPair& registries, std::uint32_t next, std::uint32_t budget);
+
+    private:
+        const std::byte* m_data;
+        std::size_t m_size;
+        bool m_mapped;
+        std::vector<std::byte> m_buffer;
+        std::vector<entt::entity> m_entities[2]; // Entities as created at load time, indexed by Registry
+        std::vector<std::uint32_t> m_column_work; // Work index of each column's first row
+
+        const Header& header () const { return *reinterpret_cast<const Header*>(m_data); }
+        const Column& column (std::uint32_t index) const { return reinterpret_cast<const Column*>(m_data + header().columns_offset)[index]; }
+        const char* string (std::uint32_t offset) const { return reinterpret_cast<const char*>(m_data + header().strings_offset + offset); }
+        template <typename T> const T* at (std::uint32_t offset) const { return reinterpret_cast<const T*>(m_data + offset); }
+
+        void insertRows (world::Context* context, RegistryPair& registries, const Column& column, std::uint32_t first, std::uint32_t last);
+    };
+
+    // Path of the baked file for a scene file
+    std::string bakedFilename (const std::string& scene_filename);
+
+    // Read only the manifest of a baked scene file
+    TomlValue parseManifest (const std::string& filename);
+
+    // Whether a baked scene file was baked from the current contents of its scene file
+    bool isCurrent (const std::string& filename, const std::string& scene_filename);
+
+    // Convert a TOML scene file into a baked scene file on the real filesystem. Returns false if the scene could not be baked.
+    bool bake (world::Context* context, const std::string& scene_filename, const std::string& output_filename);
+}
@@ -1,16 +1,18 @@
 #include "world.hpp"
 #include "context.hpp"
 
+#include "core/components.hpp"
 #include "scripting/scripting.hpp"
 #include "modules/modules.hpp"
 
 void world::prepareRegistries (world::Context* context, million::api::definitions::PrepareFn prepareFn)
 {
-    // Create storage for the component
-    prepareFn(context->m_registries.foreground().runtime);
-    prepareFn(context->m_registries.foreground().prototypes);
-    prepareFn(context->m_registries.background().runtime);
-    prepareFn(context->m_registries.background().prototypes);
+    // Create storage for the component. Recipes skip components without a runtime storage, so they must be rebuilt.
+    context->m_registries.each([prepareFn](auto& registries){
+        prepareFn(registries.runtime);
+        prepareFn(registries.prototypes);
+        registries.prototypesChanged();
+    });
 }
 
 void world::installComponent (world::Context* context, const million::api::definitions::Component& component, million::api::definitions::PrepareFn prepareFn)
@@ -20,6 +22,39 @@ void world::installComponent (world::Context* context, const million::api::defin
     scripting::registerComponent(context->m_scripting_ctx, component.id.value(), component.type_id);
     // Add component loader
     context->m_component_loaders[component.id] = component.loader;
+    // Record layout for baked scenes. Without attribute descriptions, it is unknown whether the component is safe to copy bytewise.
+    bool bakeable = ! component.attributes.empty();
+    for (const auto& attribute : component.attributes) {
+        switch (attribute.type) {
+            case million::types::Type::Resource:
+            case million::types::Type::TextureResource:
+            case million::types::Type::MeshResource:
+            case million::types::Type::HashedString:
+            case million::types::Type::Ref:
+                bakeable = false;
+                break;
+            default: break;
+        }
+    }
+    context->m_component_info[component.type_id] = {component.id.data(), component.size_in_bytes, bakeable};
+}
+
+bool rawComponentSize (world::Context* context, entt::id_type type_id, std::size_t& size)
+{
+    // Engine components that are set by the scene loader itself rather than through a component loader
+    if (type_id == entt::type_hash<core::EntityPrototypeID>::value()) {
+        size = sizeof(core::EntityPrototypeID);
+        return true;
+    } else if (type_id == entt::type_hash<components::core::Category>::value()) {
+        size = sizeof(components::core::Category); // Category bitflags are assigned from the game config, which baked scenes depend on
+        return true;
+    }
+    auto it = context->m_component_info.find(type_id);
+    if (it != context->m_component_info.end()) {
+        size = it->second.size;
+        return it->second.bakeable;
+    }
+    return false;
 }
 
 void loadComponent (world::Context* context, entt::registry& registry, entt::hashed_string component, entt::entity entity, const void* table)
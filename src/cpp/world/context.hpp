@@ -2,20 +2,70 @@
 
 #include <monkeys.hpp>
 #include "registries.hpp"
+#include "utils/parser.hpp"
+#include "baked_scene.hpp"
+#include "entity_commands.hpp"
 
 #include <filesystem>
+#include <memory>
+#include <mutex>
+
+// A scene's prototypes and entities, parsed on the loader thread and created on the main thread a batch at a time
+struct SceneInstantiation {
+    million::resources::Handle handle;
+    TomlValue config;
+    std::unique_ptr<baked::Scene> baked; // Set instead of config if the scene was baked
+    std::uint32_t prototypes; // Prototypes are created first, then entities
+    std::uint32_t entities; // Prototypes plus entities, the unit of SceneLoadProgress
+    std::uint32_t total; // Units of work, entities for TOML scenes (same as `entities`), entities plus component rows for baked scenes
+    std::uint32_t next;
+};
 
 struct PendingScene {
     phmap::flat_hash_set<million::resources::Handle::Type> resources;
+    std::vector<SceneInstantiation> instantiations;
     bool auto_swap;
 };
 
+struct CompositeTarget {
+    million::events::CompositeOp op;
+    million::events::Target lhs;
+    million::events::Target rhs;
+    // Lazily computed membership, valid while generation matches the world's target generation
+    std::uint64_t generation = 0;
+    std::vector<entt::entity> entities;
+};
+
+struct CompositeKey {
+    million::events::CompositeOp op;
+    million::events::Target lhs;
+    million::events::Target rhs;
+
+    bool operator== (const CompositeKey& other) const {
+        return op == other.op && lhs.type == other.lhs.type && lhs.id == other.lhs.id && rhs.type == other.rhs.type && rhs.id == other.rhs.id;
+    }
+
+    template <typename H>
+    friend H AbslHashValue (H h, const CompositeKey& key) {
+        return H::combine(std::move(h), std::uint8_t(key.op), std::uint8_t(key.lhs.type), key.lhs.id, std::uint8_t(key.rhs.type), key.rhs.id);
+    }
+};
+
+struct CachedGroup {
+    std::uint64_t generation = 0;
+    std::vector<entt::entity> entities;
+};
+
 struct SceneEventHandler {
     entt::hashed_string::hash_type events;
     million::GameHandler handler;
 };
 
 void loadComponent (world::Context* context, entt::registry& registry, entt::hashed_string component, entt::entity entity, const void* table);
+// Remove destroyed entities from the current scene's entity sets
+void purgeEntitySets (world::Context* context);
+// Size of the data of a component type that can be copied bytewise, or false if it cannot be (used by baked scenes and snapshots)
+bool rawComponentSize (world::Context* context, entt::id_type type_id, std::size_t& size);
 
 namespace world {
     struct Context {
@@ -30,6 +80,13 @@ namespace world {
 
         // Component loaders
         helpers::hashed_string_flat_map<million::api::definitions::LoaderFn> m_component_loaders;
+        // Component layout by type id, used to bake scenes and to check that baked component data still fits its component
+        struct ComponentInfo {
+            std::string name;
+            std::size_t size;
+            bool bakeable; // False if the component holds resource handles or pointers (only valid in the process that created them) or its attributes are unknown
+        };
+        phmap::flat_hash_map<entt::id_type, ComponentInfo> m_component_info;
 
         // ECS registries to manage all entities
         Registries m_registries;
@@ -43,10 +100,26 @@ namespace world {
         std::filesystem::path m_path;
         helpers::hashed_string_flat_map<std::string> m_scenes;
         helpers::hashed_string_flat_map<PendingScene> m_pending_scenes;
+        std::mutex m_parsed_scenes_mutex;
+        phmap::flat_hash_map<million::resources::Handle::Type, SceneInstantiation> m_parsed_scenes; // Written by the loader thread
+
+        // Snapshots (see snapshot.cpp)
+        std::uint32_t m_snapshot_ids = 0;
+        std::vector<std::byte> m_snapshot_baseline; // Full snapshot of the state the next delta snapshot is relative to
+
+        // Entity command buffers of every thread that has recorded commands (see entity_commands.cpp)
+        std::mutex m_command_buffers_mutex;
+        std::vector<std::unique_ptr<EntityCommandBuffer>> m_command_buffers;
 
         // Entity categories
         helpers::hashed_string_flat_map<std::uint16_t> m_category_bitfields;
 
+        // Composite message targets, identified by their index. Cached results are invalidated whenever the generation changes (every frame, scene swap or entity set change)
+        std::vector<CompositeTarget> m_composites;
+        phmap::flat_hash_map<CompositeKey, std::uint32_t> m_composite_ids;
+        helpers::hashed_string_node_map<CachedGroup> m_group_cache; // Node map so that references stay valid while other groups are cached
+        std::uint64_t m_target_generation = 1;
+
         // Current scene and pending scene
         struct Info {
             entt::hashed_string::hash_type scene = 0;
@@ -3,8 +3,6 @@
 
 #include "core/components.hpp"
 
-const std::string g_empty_string = {};
-
 entt::entity world::findEntity (world::Context* context, entt::hashed_string name)
 {
     EASY_FUNCTION(world::COLOR(2));
@@ -16,41 +14,38 @@ entt::entity world::findEntity (world::Context* context, entt::hashed_string nam
     return entt::null;
 }
 
-const std::string& world::findEntityName (world::Context* context, const components::core::Named& named)
+std::string_view world::findEntityName (world::Context* context, const components::core::Named& named)
 {
     EASY_FUNCTION(world::COLOR(2));
     const auto& entities = context->m_registries.foreground().entity_names;
     auto it = entities.find(named.name);
     if (it == entities.end()) {
         spdlog::warn("No name for {}", named.name.data());
-        return g_empty_string;
+        return {};
     }
     return it->second.name;
     
 }
 
-const std::string& world::findEntityName (world::Context* context, entt::entity entity)
+std::string_view world::findEntityName (world::Context* context, entt::entity entity)
 {
     EASY_FUNCTION(world::COLOR(2));
-    auto& foreground = context->m_registries.foreground();
-    auto named = foreground.runtime.try_get<components::core::Named>(entity);
-    if (named == nullptr) {
+    const auto name = context->m_registries.foreground().entityName(entity);
+    if (name.data() == nullptr) {
         spdlog::warn("No name for entity {}", entt::to_integral(entity));
-        return g_empty_string;
     }
-    const auto& entities = foreground.entity_names;
-    auto it = entities.find(named->name);
-    if (it == entities.end()) {
-        spdlog::warn("No name for {}", named->name.data());
-        return g_empty_string;
-    }
-    return it->second.name;
+    return name;
 }
 
 bool world::isInGroup (world::Context* context, entt::entity entity, entt::hashed_string::hash_type group_name)
 {
-    const auto& registry = context->m_registries.foreground().runtime;
-    const auto& storage = registry.storage<core::EntityGroup>(group_name);
+    auto& foreground = context->m_registries.foreground();
+    const auto bit = foreground.group_index.bit(foreground.runtime, group_name);
+    if EXPECT_TAKEN(bit != 0) {
+        return foreground.group_index.contains(entity, bit);
+    }
+    // Too many groups to index them all
+    const auto& storage = std::as_const(foreground.runtime).storage<core::EntityGroup>(group_name);
     return storage.contains(entity);
 }
 
@@ -73,3 +68,26 @@ std::uint16_t world::categoryBitflag (world::Context* context, entt::hashed_stri
     }
     return 0;
 }
+
+void world::updateSpatialIndex (world::Context* context, const SpatialIndex::ParallelFor& parallel_for)
+{
+    EASY_FUNCTION(world::COLOR(1));
+    const float& cell_size = entt::monostate<"scenes/spatial-cell-size"_hs>();
+    auto& foreground = context->m_registries.foreground();
+    foreground.spatial_index.update(foreground.runtime, cell_size, parallel_for);
+}
+
+void world::entitiesInRadius (world::Context* context, const glm::vec3& center, float radius, std::vector<entt::entity>& entities)
+{
+    context->m_registries.foreground().spatial_index.radius(center, radius, entities);
+}
+
+void world::entitiesInBox (world::Context* context, const glm::vec3& min, const glm::vec3& max, std::vector<entt::entity>& entities)
+{
+    context->m_registries.foreground().spatial_index.box(min, max, entities);
+}
+
+void world::nearestEntities (world::Context* context, const glm::vec3& point, std::uint32_t count, std::vector<entt::entity>& entities)
+{
+    context->m_registries.foreground().spatial_index.nearest(point, count, entities);
+}
@@ -0,0 +1,208 @@
+#include "entity_commands.hpp"
+#include "world.hpp"
+#include "context.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+    thread_local EntityCommandBuffer* g_command_buffer = nullptr;
+    thread_local std::uint32_t g_command_order = world::UNORDERED_COMMANDS;
+    // Position of the next command among those recorded at the current order. Each order is only ever recorded by one thread at a time,
+    // so (order, sequence) identifies a command independently of which thread's buffer it is in.
+    thread_local std::uint32_t g_command_sequence = 0;
+
+    // Position of a command in the deterministic application order
+    struct CommandRef {
+        std::uint32_t order;
+        std::uint32_t sequence;
+        std::uint32_t buffer; // Where to find the command, not part of the order
+        std::uint32_t index;
+
+        bool operator< (const CommandRef& other) const {
+            return std::tie(order, sequence) < std::tie(other.order, other.sequence);
+        }
+    };
+}
+
+void EntityCommandBuffer::setOrder (std::uint32_t order)
+{
+    g_command_order = order;
+    g_command_sequence = 0;
+}
+
+bool EntityCommandBuffer::accept (const char* command) const
+{
+    if EXPECT_NOT_TAKEN(g_command_order == world::UNORDERED_COMMANDS) {
+        spdlog::error("[world] Cannot record {} command outside of a system, it would be applied in no particular order", command);
+        return false;
+    }
+    return true;
+}
+
+million::DeferredEntity EntityCommandBuffer::spawn (entt::hashed_string prototype)
+{
+    if EXPECT_NOT_TAKEN(! accept("spawn")) {
+        return RejectedSpawn;
+    }
+    // The name is only needed for error messages, but the caller's string may not outlive the frame
+    const auto name = m_data.append(prototype.data(), prototype.size() + 1);
+    m_spawns.push_back({g_command_order, g_command_sequence++, prototype.value(), name});
+    return {std::uint32_t(m_spawns.size() - 1)};
+}
+
+void EntityCommandBuffer::destroy (Target target)
+{
+    if EXPECT_TAKEN(accept("destroy")) {
+        m_destroys.push_back({g_command_order, g_command_sequence++, target});
+    }
+}
+
+void EntityCommandBuffer::record (Target target, entt::id_type component, ApplyFn apply, const void* value, std::size_t size, std::size_t alignment)
+{
+    if (alignment > helpers::SectionWriter::Alignment) {
+        spdlog::error("[world] Cannot record command for component {}, its alignment of {} is too large", component, alignment);
+        return;
+    }
+    if EXPECT_NOT_TAKEN(! accept("component")) {
+        return;
+    }
+    const auto offset = value != nullptr ? m_data.append(value, size) : 0;
+    m_components.push_back({g_command_order, g_command_sequence++, target, component, apply, offset});
+}
+
+entt::entity EntityCommandBuffer::resolve (const Target& target) const
+{
+    if (target.deferred == Target::NotDeferred) {
+        return target.entity;
+    }
+    return target.deferred < m_spawned.size() ? m_spawned[target.deferred] : entt::entity{entt::null};
+}
+
+void EntityCommandBuffer::clear ()
+{
+    m_spawns.clear();
+    m_components.clear();
+    m_destroys.clear();
+    m_data.bytes().clear();
+    m_spawned.clear();
+}
+
+million::EntityCommands& world::entityCommands (world::Context* context)
+{
+    if EXPECT_NOT_TAKEN(g_command_buffer == nullptr) {
+        EASY_BLOCK("world::entityCommands", world::COLOR(3));
+        std::lock_guard<std::mutex> guard(context->m_command_buffers_mutex);
+        context->m_command_buffers.push_back(std::make_unique<EntityCommandBuffer>());
+        g_command_buffer = context->m_command_buffers.back().get();
+    }
+    return *g_command_buffer;
+}
+
+void world::setCommandOrder (std::uint32_t order)
+{
+    EntityCommandBuffer::setOrder(order);
+}
+
+void world::applyEntityCommands (world::Context* context)
+{
+    EASY_FUNCTION(world::COLOR(1));
+    // Runs after every system stage, so no thread is recording
+    std::lock_guard<std::mutex> guard(context->m_command_buffers_mutex);
+    auto& buffers = context->m_command_buffers;
+    auto& registry = context->m_registries.foreground().runtime;
+    std::vector<CommandRef> commands;
+
+    {
+        EASY_BLOCK("Spawn", world::COLOR(2));
+        for (std::uint32_t buffer = 0; buffer < buffers.size(); ++buffer) {
+            const auto& spawns = buffers[buffer]->spawns();
+            buffers[buffer]->spawned().assign(spawns.size(), entt::null);
+            for (std::uint32_t index = 0; index < spawns.size(); ++index) {
+                commands.push_back({spawns[index].order, spawns[index].sequence, buffer, index});
+            }
+        }
+        std::sort(commands.begin(), commands.end());
+        // Consecutive spawns of the same prototype are created together
+        std::vector<entt::entity> created;
+        for (std::size_t first = 0; first < commands.size();) {
+            const auto& spawn = buffers[commands[first].buffer]->spawns()[commands[first].index];
+            auto last = first + 1;
+            while (last < commands.size() && buffers[commands[last].buffer]->spawns()[commands[last].index].prototype == spawn.prototype) {
+                ++last;
+            }
+            const auto name = reinterpret_cast<const char*>(buffers[commands[first].buffer]->data(spawn.name));
+            created.resize(last - first);
+            if (world::spawnMany(context, entt::hashed_string{name}, std::uint32_t(created.size()), created.data()) != 0) {
+                for (auto index = first; index < last; ++index) {
+                    buffers[commands[index].buffer]->spawned()[commands[index].index] = created[index - first];
+                }
+            }
+            first = last;
+        }
+    }
+
+    {
+        EASY_BLOCK("Components", world::COLOR(2));
+        // Sorted by component first, so that each component's storage is visited once, with all of its commands in order
+        std::vector<std::pair<entt::id_type, CommandRef>> component_commands;
+        for (std::uint32_t buffer = 0; buffer < buffers.size(); ++buffer) {
+            const auto& recorded = buffers[buffer]->components();
+            for (std::uint32_t index = 0; index < recorded.size(); ++index) {
+                component_commands.push_back({recorded[index].component, {recorded[index].order, recorded[index].sequence, buffer, index}});
+            }
+        }
+        std::sort(component_commands.begin(), component_commands.end());
+        // Consecutive commands of the same kind on the same component are applied as a batch
+        std::vector<entt::entity> entities;
+        std::vector<const void*> values;
+        million::EntityCommands::ApplyFn batch_apply = nullptr;
+        entt::id_type batch_component = 0;
+        const auto flush = [&](){
+            if (! entities.empty()) {
+                batch_apply(registry, entities.data(), values.data(), std::uint32_t(entities.size()));
+                entities.clear();
+                values.clear();
+            }
+        };
+        for (const auto& [component, ref] : component_commands) {
+            const auto& buffer = *buffers[ref.buffer];
+            const auto& command = buffer.components()[ref.index];
+            if (command.apply != batch_apply || component != batch_component) {
+                flush();
+                batch_apply = command.apply;
+                batch_component = component;
+            }
+            const auto entity = buffer.resolve(command.target);
+            if (registry.valid(entity)) {
+                entities.push_back(entity);
+                values.push_back(buffer.data(command.value));
+            }
+        }
+        flush();
+    }
+
+    {
+        EASY_BLOCK("Destroy", world::COLOR(2));
+        commands.clear();
+        for (std::uint32_t buffer = 0; buffer < buffers.size(); ++buffer) {
+            const auto& destroys = buffers[buffer]->destroys();
+            for (std::uint32_t index = 0; index < destroys.size(); ++index) {
+                commands.push_back({destroys[index].order, destroys[index].sequence, buffer, index});
+            }
+        }
+        std::sort(commands.begin(), commands.end());
+        for (const auto& ref : commands) {
+            const auto& buffer = *buffers[ref.buffer];
+            const auto entity = buffer.resolve(buffer.destroys()[ref.index].target);
+            // The same entity may have been destroyed by more than one command
+            if (registry.valid(entity)) {
+                registry.destroy(entity);
+            }
+        }
+    }
+
+    for (auto& buffer : buffers) {
+        buffer->clear();
+    }
+}
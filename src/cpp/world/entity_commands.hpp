@@ -0,0 +1,60 @@
+#pragma once
+
+#include <monkeys.hpp>
+
+// One thread's recorded entity commands. Each command is tagged with the order of the system that recorded it and its position among that
+// system's commands, so that commands from every thread can be merged into a deterministic order when they are applied. Commands recorded
+// without an order (for example from worker tasks that a system spawns) cannot be placed in that order and are rejected.
+class EntityCommandBuffer final : public million::EntityCommands {
+public:
+    million::DeferredEntity spawn (entt::hashed_string prototype) final;
+    void destroy (Target target) final;
+
+    // Set the order of the calling thread's subsequent commands, restarting their sequence
+    static void setOrder (std::uint32_t order);
+
+    // Returned by spawn() when the command is rejected, resolves to entt::null
+    static constexpr million::DeferredEntity RejectedSpawn{Target::NotDeferred - 1};
+
+    // Get the entity that a target refers to once spawns have been applied, entt::null if there is none
+    entt::entity resolve (const Target& target) const;
+    void clear ();
+
+    struct Spawn {
+        std::uint32_t order;
+        std::uint32_t sequence;
+        entt::id_type prototype;
+        std::uint32_t name; // Offset of the prototype's name in m_data
+    };
+    struct ComponentCommand {
+        std::uint32_t order;
+        std::uint32_t sequence;
+        Target target;
+        entt::id_type component;
+        ApplyFn apply;
+        std::uint32_t value; // Offset of the component's value in m_data
+    };
+    struct Destroy {
+        std::uint32_t order;
+        std::uint32_t sequence;
+        Target target;
+    };
+
+    const std::vector<Spawn>& spawns () const { return m_spawns; }
+    const std::vector<ComponentCommand>& components () const { return m_components; }
+    const std::vector<Destroy>& destroys () const { return m_destroys; }
+    const std::byte* data (std::uint32_t offset) const { return m_data.bytes().data() + offset; }
+    std::vector<entt::entity>& spawned () { return m_spawned; }
+
+protected:
+    void record (Target target, entt::id_type component, ApplyFn apply, const void* value, std::size_t size, std::size_t alignment) final;
+
+private:
+    std::vector<Spawn> m_spawns;
+    std::vector<ComponentCommand> m_components;
+    std::vector<Destroy> m_destroys;
+    helpers::SectionWriter m_data; // Prototype names and component values
+    std::vector<entt::entity> m_spawned; // Entity created for each spawn, filled in when spawns are applied
+
+    bool accept (const char* command) const;
+};
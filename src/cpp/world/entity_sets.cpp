@@ -0,0 +1,149 @@
+#include "world.hpp"
+#include "context.hpp"
+
+#include "core/components.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+const std::vector<entt::entity> g_empty_entities = {};
+
+const std::vector<entt::entity>& groupEntities (world::Context* context, entt::hashed_string::hash_type group_name)
+{
+    EASY_FUNCTION(world::COLOR(3));
+    auto& cached = context->m_group_cache[group_name];
+    if (cached.generation != context->m_target_generation) {
+        // Group storages are not kept in entity order, so take a sorted copy to use in set operations
+        const auto& registry = context->m_registries.foreground().runtime;
+        const auto& storage = registry.storage<core::EntityGroup>(group_name);
+        cached.entities.assign(storage.data(), storage.data() + storage.size());
+        std::sort(cached.entities.begin(), cached.entities.end());
+        cached.generation = context->m_target_generation;
+    }
+    return cached.entities;
+}
+
+const std::vector<entt::entity>& targetEntities (world::Context* context, million::events::Target target)
+{
+    switch (target.type) {
+        case million::events::TargetType::Group:
+            return groupEntities(context, target.id);
+        case million::events::TargetType::EntitySet:
+            return world::entitySet(context, target.id);
+        case million::events::TargetType::Composite:
+            return world::entityComposite(context, target.id);
+        default:
+            spdlog::warn("[world] Invalid composite operand type: {}", magic_enum::enum_integer(target.type));
+            return g_empty_entities;
+    }
+}
+
+void world::setInEntitySet (world::Context* context, entt::hashed_string::hash_type set_name, entt::entity entity, bool in_set)
+{
+    EASY_FUNCTION(world::COLOR(2));
+    auto& entities = context->m_registries.foreground().entity_sets[set_name];
+    // Keep the set sorted, so that composites can be computed with linear merges
+    auto it = std::lower_bound(entities.begin(), entities.end(), entity);
+    bool found = it != entities.end() && *it == entity;
+    if (in_set && ! found) {
+        entities.insert(it, entity);
+        ++context->m_target_generation;
+    } else if (! in_set && found) {
+        entities.erase(it);
+        ++context->m_target_generation;
+    }
+}
+
+void purgeEntitySets (world::Context* context)
+{
+    EASY_FUNCTION(world::COLOR(3));
+    auto& foreground = context->m_registries.foreground();
+    for (auto& [set_name, entities] : foreground.entity_sets) {
+        // Removing keeps the set sorted
+        entities.erase(std::remove_if(entities.begin(), entities.end(), [&foreground](auto entity){ return ! foreground.runtime.valid(entity); }), entities.end());
+    }
+}
+
+const std::vector<entt::entity>& world::entitySet (world::Context* context, entt::hashed_string::hash_type set_name)
+{
+    const auto& entity_sets = context->m_registries.foreground().entity_sets;
+    auto it = entity_sets.find(set_name);
+    if (it != entity_sets.end()) {
+        return it->second;
+    }
+    return g_empty_entities;
+}
+
+std::uint32_t world::defineComposite (world::Context* context, million::events::CompositeOp op, million::events::Target lhs, million::events::Target rhs)
+{
+    EASY_FUNCTION(world::COLOR(2));
+    CompositeKey key{op, lhs, rhs};
+    auto it = context->m_composite_ids.find(key);
+    if (it != context->m_composite_ids.end()) {
+        return it->second;
+    }
+    // Composites may only reference composites that already exist, so definitions can never be cyclic
+    for (const auto& operand : {lhs, rhs}) {
+        if (operand.type == million::events::TargetType::Entity || (operand.type == million::events::TargetType::Composite && operand.id >= context->m_composites.size())) {
+            spdlog::error("[world] Invalid composite operand: type {} id {}", magic_enum::enum_integer(operand.type), operand.id);
+            return std::uint32_t(-1);
+        }
+    }
+    std::uint32_t composite_id = context->m_composites.size();
+    context->m_composites.push_back({op, lhs, rhs});
+    context->m_composite_ids.emplace(key, composite_id);
+    return composite_id;
+}
+
+const std::vector<entt::entity>& world::entityComposite (world::Context* context, std::uint32_t composite_id)
+{
+    EASY_FUNCTION(world::COLOR(2));
+    if (composite_id >= context->m_composites.size()) {
+        spdlog::warn("[world] Composite target does not exist: {}", composite_id);
+        return g_empty_entities;
+    }
+    auto& composite = context->m_composites[composite_id];
+    if (composite.generation != context->m_target_generation) {
+        // Computed lazily on first use, then reused by every message sent to this composite until the generation changes
+        if (composite.lhs.type == million::events::TargetType::Group && composite.rhs.type == million::events::TargetType::Group) {
+            // Combine the groups' bits in one pass over the group index, rather than merging sorted copies of both groups
+            auto& foreground = context->m_registries.foreground();
+            const auto lhs = foreground.group_index.bit(foreground.runtime, composite.lhs.id);
+            const auto rhs = foreground.group_index.bit(foreground.runtime, composite.rhs.id);
+            if (lhs != 0 && rhs != 0) {
+                switch (composite.op) {
+                    case million::events::CompositeOp::Union:
+                        foreground.group_index.select(0, lhs | rhs, 0, composite.entities);
+                        break;
+                    case million::events::CompositeOp::Intersection:
+                        foreground.group_index.select(lhs | rhs, 0, 0, composite.entities);
+                        break;
+                    case million::events::CompositeOp::Difference:
+                        foreground.group_index.select(lhs, 0, rhs, composite.entities);
+                        break;
+                };
+                // Other composites expect entity order, not entity index order
+                std::sort(composite.entities.begin(), composite.entities.end());
+                composite.generation = context->m_target_generation;
+                return composite.entities;
+            }
+        }
+        const auto& lhs = targetEntities(context, composite.lhs);
+        const auto& rhs = targetEntities(context, composite.rhs);
+        composite.entities.clear();
+        auto out = std::back_inserter(composite.entities);
+        switch (composite.op) {
+            case million::events::CompositeOp::Union:
+                std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out);
+                break;
+            case million::events::CompositeOp::Intersection:
+                std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out);
+                break;
+            case million::events::CompositeOp::Difference:
+                std::set_difference(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out);
+                break;
+        };
+        composite.generation = context->m_target_generation;
+    }
+    return composite.entities;
+}
@@ -0,0 +1,174 @@
+#include "group_index.hpp"
+
+#include "core/components.hpp"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace {
+    // A required group with fewer members than this fraction of the index is selected from by checking its members instead of every mask
+    constexpr std::size_t MemberScanRatio = 16;
+
+    inline bool matches (GroupIndex::Mask mask, GroupIndex::Mask required, GroupIndex::Mask any, GroupIndex::Mask excluded)
+    {
+        return (mask & required) == required && (any == 0 || (mask & any) != 0) && (mask & excluded) == 0 && mask != 0;
+    }
+}
+
+void GroupIndex::Slot::onAdd (entt::registry&, entt::entity entity)
+{
+    const auto entity_index = entt::to_entity(entity);
+    if (entity_index >= index->m_masks.size()) {
+        index->m_masks.resize(entity_index + 1, 0);
+        index->m_entities.resize(entity_index + 1, entt::null);
+    }
+    if (index->m_entities[entity_index] != entity) {
+        // The index's previous entity was destroyed, so it is no longer in any group
+        index->m_entities[entity_index] = entity;
+        index->m_masks[entity_index] = 0;
+    }
+    index->m_masks[entity_index] |= bit;
+}
+
+void GroupIndex::Slot::onRemove (entt::registry&, entt::entity entity)
+{
+    const auto entity_index = entt::to_entity(entity);
+    if (entity_index < index->m_masks.size() && index->m_entities[entity_index] == entity) {
+        index->m_masks[entity_index] &= ~bit;
+    }
+}
+
+void GroupIndex::clear (entt::registry& registry)
+{
+    for (std::uint32_t slot = 0; slot < m_num_slots; ++slot) {
+        registry.on_construct<core::EntityGroup>(m_slots[slot].group).disconnect(m_slots[slot]);
+        registry.on_destroy<core::EntityGroup>(m_slots[slot].group).disconnect(m_slots[slot]);
+    }
+    m_num_slots = 0;
+    m_slot_ids.clear();
+    m_masks.clear();
+    m_entities.clear();
+}
+
+GroupIndex::Mask GroupIndex::bit (entt::registry& registry, entt::id_type group)
+{
+    auto it = m_slot_ids.find(group);
+    if EXPECT_TAKEN(it != m_slot_ids.end()) {
+        return m_slots[it->second].bit;
+    }
+    if (m_num_slots == MaxGroups) {
+        return 0;
+    }
+    EASY_FUNCTION(profiler::colors::Green500);
+    const auto slot_id = m_num_slots++;
+    auto& slot = m_slots[slot_id];
+    const auto& storage = registry.storage<core::EntityGroup>(group);
+    slot = {this, group, Mask(1) << slot_id, &storage};
+    m_slot_ids[group] = slot_id;
+    registry.on_construct<core::EntityGroup>(group).connect<&Slot::onAdd>(slot);
+    registry.on_destroy<core::EntityGroup>(group).connect<&Slot::onRemove>(slot);
+    // Index the members the group already has
+    for (auto entity = storage.data(), end = storage.data() + storage.size(); entity != end; ++entity) {
+        slot.onAdd(registry, *entity);
+    }
+    return slot.bit;
+}
+
+void GroupIndex::select (Mask required, Mask any, Mask excluded, std::vector<entt::entity>& entities) const
+{
+    EASY_FUNCTION(profiler::colors::Green300);
+    entities.clear();
+    const std::size_t count = m_masks.size();
+    const Mask* masks = m_masks.data();
+
+    // Every match is a member of each required group, so if one of them is small, check its members rather than every mask
+    const entt::sparse_set* smallest = nullptr;
+    for (std::uint32_t slot = 0; slot < m_num_slots; ++slot) {
+        if ((required & m_slots[slot].bit) != 0 && (smallest == nullptr || m_slots[slot].storage->size() < smallest->size())) {
+            smallest = m_slots[slot].storage;
+        }
+    }
+    if (smallest != nullptr && smallest->size() * MemberScanRatio < count) {
+        for (const auto entity : *smallest) {
+            if (matches(masks[entt::to_entity(entity)], required, any, excluded)) {
+                entities.push_back(entity);
+            }
+        }
+        std::sort(entities.begin(), entities.end(), [](auto a, auto b){ return entt::to_entity(a) < entt::to_entity(b); });
+        return;
+    }
+
+    std::size_t index = 0;
+#ifdef __AVX2__
+    // Four masks at a time. A zero `any` accepts every non-zero mask, which all matches are anyway.
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i required_bits = _mm256_set1_epi64x(std::int64_t(required));
+    const __m256i any_bits = _mm256_set1_epi64x(std::int64_t(any != 0 ? any : ~Mask(0)));
+    const __m256i excluded_bits = _mm256_set1_epi64x(std::int64_t(excluded));
+    for (; index + 4 <= count; index += 4) {
+        const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + index));
+        __m256i match = _mm256_cmpeq_epi64(_mm256_and_si256(mask, required_bits), required_bits);
+        match = _mm256_and_si256(match, _mm256_cmpeq_epi64(_mm256_and_si256(mask, excluded_bits), zero));
+        match = _mm256_andnot_si256(_mm256_cmpeq_epi64(_mm256_and_si256(mask, any_bits), zero), match);
+        auto lanes = unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(match)));
+        while (lanes != 0) {
+            entities.push_back(m_entities[index + std::size_t(__builtin_ctz(lanes))]);
+            lanes &= lanes - 1;
+        }
+    }
+#endif
+    for (; index < count; ++index) {
+        if (matches(masks[index], required, any, excluded)) {
+            entities.push_back(m_entities[index]);
+        }
+    }
+}
+
+SCENARIO("Selecting entities by group membership") {
+    GIVEN("A large group and a small group") {
+        entt::registry registry;
+        GroupIndex index;
+        std::vector<entt::entity> all(1000);
+        registry.create(all.begin(), all.end());
+        for (std::size_t entity = 0; entity < all.size(); ++entity) {
+            if (entity % 2 == 0) {
+                registry.storage<core::EntityGroup>("large"_hs).emplace(all[entity]);
+            }
+            if (entity % 100 == 0 || entity % 100 == 1) {
+                registry.storage<core::EntityGroup>("small"_hs).emplace(all[entity]);
+            }
+        }
+        const auto large = index.bit(registry, "large"_hs);
+        const auto small = index.bit(registry, "small"_hs);
+        const auto expected = [&](auto predicate){
+            std::vector<entt::entity> entities;
+            for (std::size_t entity = 0; entity < all.size(); ++entity) {
+                if (predicate(entity)) {
+                    entities.push_back(all[entity]);
+                }
+            }
+            return entities;
+        };
+        std::vector<entt::entity> entities;
+        WHEN("Selecting the members of both, which goes through the small group's members") {
+            index.select(large | small, 0, 0, entities);
+            THEN("The entities in both are found in entity index order") {
+                CHECK(entities == expected([](auto entity){ return entity % 100 == 0; }));
+            }
+        }
+        WHEN("Selecting the large group's members that are not in the small group, which scans the masks") {
+            index.select(large, 0, small, entities);
+            THEN("Every other member of the large group is found in entity index order") {
+                CHECK(entities == expected([](auto entity){ return entity % 2 == 0 && entity % 100 != 0; }));
+            }
+        }
+        WHEN("Selecting the members of either") {
+            index.select(0, large | small, 0, entities);
+            THEN("The entities in either are found in entity index order") {
+                CHECK(entities == expected([](auto entity){ return entity % 2 == 0 || entity % 100 == 1; }));
+            }
+        }
+        index.clear(registry);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <monkeys.hpp>
+
+// Membership of a registry's entities in up to 64 groups, as one 64 bit mask per entity kept in a dense array indexed by entity index.
+// The groups' EntityGroup storages remain the record of who is in each group (and the dense member array of each group); the index follows
+// them through their construct and destroy signals. A group is indexed the first time it is asked for, so only groups that are queried use
+// a bit. Once all 64 bits are in use, further groups are not indexed and callers must fall back to their storage.
+class GroupIndex {
+public:
+    using Mask = std::uint64_t;
+    static constexpr std::uint32_t MaxGroups = 64;
+
+    // Stop following the registry's group storages and forget all groups
+    void clear (entt::registry& registry);
+
+    // Bit of a group, indexing it if it is not indexed yet. 0 if the group could not be indexed.
+    Mask bit (entt::registry& registry, entt::id_type group);
+
+    // True if the entity is in any of the groups in `bits`
+    bool contains (entt::entity entity, Mask bits) const
+    {
+        const auto index = entt::to_entity(entity);
+        return index < m_entities.size() && m_entities[index] == entity && (m_masks[index] & bits) != 0;
+    }
+
+    // Replace `entities` with the entities that are in all of the `required` groups, in any of the `any` groups (unless `any` is 0) and in
+    // none of the `excluded` groups, in entity index order. Scans every mask, unless a required group is small enough that checking its
+    // members is cheaper.
+    void select (Mask required, Mask any, Mask excluded, std::vector<entt::entity>& entities) const;
+
+private:
+    struct Slot {
+        GroupIndex* index;
+        entt::id_type group;
+        Mask bit;
+        const entt::sparse_set* storage; // The group's members
+
+        void onAdd (entt::registry&, entt::entity entity);
+        void onRemove (entt::registry&, entt::entity entity);
+    };
+
+    std::array<Slot, MaxGroups> m_slots;
+    std::uint32_t m_num_slots = 0;
+    helpers::hashed_string_flat_map<std::uint32_t> m_slot_ids; // Group name to slot
+    std::vector<Mask> m_masks;            // Indexed by entity index
+    std::vector<entt::entity> m_entities; // The entity each mask belongs to, so that stale entities are not mistaken for their index's new owner
+};
@@ -41,3 +41,8 @@ void world::setContextData (world::Context* context, million::api::EngineRuntime
 {
     context->m_context_data = runtime;
 }
+
+void world::setRunAsync (world::Context* context, std::function<void(std::function<void()>)> run_async)
+{
+    context->m_registries.setRunAsync(std::move(run_async));
+}
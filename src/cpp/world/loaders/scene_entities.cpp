@@ -5,6 +5,7 @@
 #include "core/components.hpp"
 #include "scripting/scripting.hpp"
 #include "utils/parser.hpp"
+#include "memory/heaps.hpp"
 
 void addGroups (entt::registry& registry, const TomlValue& groups, entt::entity entity)
 {
@@ -20,88 +21,93 @@ void addGroups (entt::registry& registry, const TomlValue& groups, entt::entity
     }
 }
 
-bool loaders::SceneEntities::load (million::resources::Handle handle, const std::string& filename)
+entt::entity loaders::SceneEntities::createPrototype (world::Context* context, entt::registry& registry, const TomlValue& entity)
 {
-    EASY_BLOCK("SceneEntities::load", world::COLOR(3));
-    try {
-        auto config = parser::parse_toml(filename);
-
-        auto& registries = m_context->m_registries.background();
-
-        // Load prototype entities
-        if (config.contains("prototypes")) {
-            auto& prototype_registry = registries.prototypes;
-            for (const auto& entity : config.at("prototypes").as_array()) {
-                if (entity.contains("_name_")) {
-                    const auto& name = entity.at("_name_").as_string().str;
-                    SPDLOG_TRACE("[scene] Creating new prototype entity: {}", name);
-                    auto entity_id = prototype_registry.create();
-                    prototype_registry.emplace<core::EntityPrototypeID>(entity_id, entt::hashed_string::value(name.c_str()));
-                    for (const auto& [name_str, component]  : entity.as_table()) {
-                        if (name_str == "_groups_") {
-                            // Add entity to groups
-                            addGroups(prototype_registry, component, entity_id);
-                        } else if (name_str == "_category_") {
-                            if (! component.is_string()) {
-                                spdlog::warn("[scene] Error loading entity: _category_ field must be a string");
-                                continue;
-                            }
-                            const auto& name = component.as_string().str;
-                            std::uint16_t bitfield = world::categoryBitflag(m_context, entt::hashed_string::value(name.c_str()));
-                            prototype_registry.emplace<components::core::Category>(entity_id, bitfield);
-                        } else if (name_str != "_name_") {
-                            SPDLOG_TRACE("[scene] Adding component to prototype entity {}: {}", name, name_str);
-                            toml::value value = component;
-                            loadComponent(m_context, prototype_registry, entt::hashed_string{name_str.c_str()}, entity_id, reinterpret_cast<const void*>(&value));
-                        }
-                    }
-                } else {
-                    spdlog::warn("[scene] Entity prototype without _name_!");
+    if (entity.contains("_name_")) {
+        const auto& name = entity.at("_name_").as_string().str;
+        SPDLOG_TRACE("[scene] Creating new prototype entity: {}", name);
+        auto entity_id = registry.create();
+        registry.emplace<core::EntityPrototypeID>(entity_id, entt::hashed_string::value(name.c_str()));
+        for (const auto& [name_str, component]  : entity.as_table()) {
+            if (name_str == "_groups_") {
+                // Add entity to groups
+                addGroups(registry, component, entity_id);
+            } else if (name_str == "_category_") {
+                if (! component.is_string()) {
+                    spdlog::warn("[scene] Error loading entity: _category_ field must be a string");
+                    continue;
                 }
+                const auto& name = component.as_string().str;
+                std::uint16_t bitfield = world::categoryBitflag(context, entt::hashed_string::value(name.c_str()));
+                registry.emplace<components::core::Category>(entity_id, bitfield);
+            } else if (name_str != "_name_") {
+                SPDLOG_TRACE("[scene] Adding component to prototype entity {}: {}", name, name_str);
+                toml::value value = component;
+                loadComponent(context, registry, entt::hashed_string{name_str.c_str()}, entity_id, reinterpret_cast<const void*>(&value));
             }
         }
+        return entity_id;
+    } else {
+        spdlog::warn("[scene] Entity prototype without _name_!");
+    }
+    return entt::null;
+}
 
-        // Load entities to scene
-        if (config.contains("entity")) {
-            auto& scene_registry = registries.runtime;
-            for (const auto& entity : config.at("entity").as_array()) {
-                auto entity_id = scene_registry.create();
-                SPDLOG_TRACE("[scene] Creating new entity: {}", entt::to_integral(entity_id));
-                for (const auto& [name_str, component]  : entity.as_table()) {
-                    if (name_str == "_groups_") {
-                        // Add entity to groups
-                        SPDLOG_TRACE("[scene] Setting entity {} groups", entt::to_integral(entity_id));
-                        addGroups(scene_registry, component, entity_id);
-                    } else if (name_str == "_name_") {
-                        if (! component.is_string()) {
-                            spdlog::warn("[scene] Error loading entity: _name_ field must be a string");
-                            continue;
-                        }
-                        const auto& name = component.as_string().str;
-                        SPDLOG_TRACE("[scene] Setting entity {} name to: {}", entt::to_integral(entity_id), name);
-                        scene_registry.emplace<components::core::Named>(entity_id, entt::hashed_string{name.c_str()});
-                    } else if (name_str == "_category_") {
-                        if (! component.is_string()) {
-                            spdlog::warn("[scene] Error loading entity: _category_ field must be a string");
-                            continue;
-                        }
-                        const auto& name = component.as_string().str;
-                        SPDLOG_TRACE("[scene] Setting entity {} category to: {}", entt::to_integral(entity_id), name);
-                        std::uint16_t bitfield = world::categoryBitflag(m_context, entt::hashed_string::value(name.c_str()));
-                        scene_registry.emplace<components::core::Category>(entity_id, bitfield);
-                    } else {
-                        SPDLOG_TRACE("[scene] Adding component to entity {}: {}", entt::to_integral(entity_id), name_str);
-                        toml::value value = component;
-                        loadComponent(m_context, scene_registry, entt::hashed_string{name_str.c_str()}, entity_id, reinterpret_cast<const void*>(&value));
-                    }
-                    
-                }
+entt::entity loaders::SceneEntities::createEntity (world::Context* context, entt::registry& registry, const TomlValue& entity)
+{
+    auto entity_id = registry.create();
+    SPDLOG_TRACE("[scene] Creating new entity: {}", entt::to_integral(entity_id));
+    for (const auto& [name_str, component]  : entity.as_table()) {
+        if (name_str == "_groups_") {
+            // Add entity to groups
+            SPDLOG_TRACE("[scene] Setting entity {} groups", entt::to_integral(entity_id));
+            addGroups(registry, component, entity_id);
+        } else if (name_str == "_name_") {
+            if (! component.is_string()) {
+                spdlog::warn("[scene] Error loading entity: _name_ field must be a string");
+                continue;
             }
+            const auto& name = component.as_string().str;
+            SPDLOG_TRACE("[scene] Setting entity {} name to: {}", entt::to_integral(entity_id), name);
+            registry.emplace<components::core::Named>(entity_id, entt::hashed_string{name.c_str()});
+        } else if (name_str == "_category_") {
+            if (! component.is_string()) {
+                spdlog::warn("[scene] Error loading entity: _category_ field must be a string");
+                continue;
+            }
+            const auto& name = component.as_string().str;
+            SPDLOG_TRACE("[scene] Setting entity {} category to: {}", entt::to_integral(entity_id), name);
+            std::uint16_t bitfield = world::categoryBitflag(context, entt::hashed_string::value(name.c_str()));
+            registry.emplace<components::core::Category>(entity_id, bitfield);
+        } else {
+            SPDLOG_TRACE("[scene] Adding component to entity {}: {}", entt::to_integral(entity_id), name_str);
+            toml::value value = component;
+            loadComponent(context, registry, entt::hashed_string{name_str.c_str()}, entity_id, reinterpret_cast<const void*>(&value));
         }
+    }
+    return entity_id;
+}
 
+// Runs on the loader thread: only parse (or map, if baked) the scene, the entities are created by the main thread in batches (see instantiate)
+bool loaders::SceneEntities::load (million::resources::Handle handle, const std::string& filename)
+{
+    EASY_BLOCK("SceneEntities::load", world::COLOR(3));
+    memory::heaps::Scope heap_scope{memory::heaps::Subsystem::World};
+    try {
+        SceneInstantiation parsed;
+        if (std::filesystem::path(filename).extension() == baked::EXTENSION) {
+            parsed.baked = std::make_unique<baked::Scene>(filename);
+        } else {
+            parsed.config = parser::parse_toml(filename);
+        }
+        std::lock_guard<std::mutex> guard(m_context->m_parsed_scenes_mutex);
+        m_context->m_parsed_scenes[handle.handle] = std::move(parsed);
     } catch (const std::invalid_argument& e) {
         spdlog::warn("[resource:scene-entities] '{}' file not found", filename);
         return false;
+    } catch (const std::runtime_error& e) {
+        spdlog::error("[resource:scene-entities] {}", e.what());
+        return false;
     }
 
     return true;
@@ -110,4 +116,61 @@ bool loaders::SceneEntities::load (million::resources::Handle handle, const std:
 void loaders::SceneEntities::unload (million::resources::Handle handle)
 {
     EASY_BLOCK("SceneEntities::unload", world::COLOR(3));
+    std::lock_guard<std::mutex> guard(m_context->m_parsed_scenes_mutex);
+    m_context->m_parsed_scenes.erase(handle.handle);
+}
+
+bool loaders::SceneEntities::prepare (world::Context* context, million::resources::Handle handle, SceneInstantiation& instantiation)
+{
+    std::lock_guard<std::mutex> guard(context->m_parsed_scenes_mutex);
+    auto it = context->m_parsed_scenes.find(handle.handle);
+    if (it == context->m_parsed_scenes.end()) {
+        return false;
+    }
+    instantiation = std::move(it->second);
+    instantiation.handle = handle;
+    context->m_parsed_scenes.erase(it);
+    if (instantiation.baked) {
+        instantiation.prototypes = 0;
+        instantiation.entities = instantiation.baked->numEntities();
+        instantiation.total = instantiation.baked->totalWork();
+    } else {
+        instantiation.prototypes = instantiation.config.contains("prototypes") ? std::uint32_t(instantiation.config.at("prototypes").as_array().size()) : 0;
+        instantiation.entities = instantiation.prototypes + (instantiation.config.contains("entity") ? std::uint32_t(instantiation.config.at("entity").as_array().size()) : 0);
+        instantiation.total = instantiation.entities;
+    }
+    instantiation.next = 0;
+    return true;
+}
+
+std::uint32_t loaders::SceneEntities::instantiate (world::Context* context, SceneInstantiation& instantiation, std::uint32_t budget)
+{
+    EASY_BLOCK("SceneEntities::instantiate", world::COLOR(3));
+    memory::heaps::Scope heap_scope{memory::heaps::Subsystem::World};
+    auto& registries = context->m_registries.background();
+    const std::uint32_t end = instantiation.total - instantiation.next > budget ? instantiation.next + budget : instantiation.total;
+    const std::uint32_t count = end - instantiation.next;
+    if (instantiation.baked) {
+        instantiation.next = instantiation.baked->instantiate(context, registries, instantiation.next, budget);
+        return count;
+    }
+    // Prototypes are created first, so that they exist before any entity could use them
+    for (; instantiation.next < end && instantiation.next < instantiation.prototypes; ++instantiation.next) {
+        createPrototype(context, registries.prototypes, instantiation.config.at("prototypes").as_array()[instantiation.next]);
+        // Its components are added after its EntityPrototypeID
+        registries.prototypesChanged();
+    }
+    for (; instantiation.next < end; ++instantiation.next) {
+        createEntity(context, registries.runtime, instantiation.config.at("entity").as_array()[instantiation.next - instantiation.prototypes]);
+    }
+    return count;
+}
+
+std::uint32_t loaders::SceneEntities::entitiesLoaded (const SceneInstantiation& instantiation)
+{
+    if (instantiation.baked) {
+        // A baked scene creates all of its entities before filling in their components, so count them as created in proportion to the work done
+        return std::uint32_t(std::uint64_t(instantiation.next) * instantiation.entities / std::max(instantiation.total, 1u));
+    }
+    return instantiation.next;
 }
@@ -2,6 +2,9 @@
 
 #include <monkeys.hpp>
 #include "resources/resources.hpp"
+#include "utils/parser.hpp"
+
+struct SceneInstantiation;
 
 namespace loaders {
     class SceneEntities : public million::api::resources::Loader {
@@ -16,6 +19,17 @@ namespace loaders {
         entt::hashed_string name () const final { return Name; }
         static constexpr entt::hashed_string Name = "scene-entities"_hs;
 
+        // Take the parsed scene for a loaded resource, ready to be instantiated. Returns false if there is none.
+        static bool prepare (world::Context* context, million::resources::Handle handle, SceneInstantiation& instantiation);
+        // Create up to `budget` of a parsed scene's prototypes and entities in the background registries, returning how many were created
+        static std::uint32_t instantiate (world::Context* context, SceneInstantiation& instantiation, std::uint32_t budget);
+        // Number of a parsed scene's entities (prototypes included) that count as created so far, for SceneLoadProgress
+        static std::uint32_t entitiesLoaded (const SceneInstantiation& instantiation);
+
+        // Create a prototype or entity from its TOML table, returning it, or entt::null if the table is not a valid prototype
+        static entt::entity createPrototype (world::Context* context, entt::registry& registry, const TomlValue& entity);
+        static entt::entity createEntity (world::Context* context, entt::registry& registry, const TomlValue& entity);
+
     private:
         world::Context* m_context;
     };
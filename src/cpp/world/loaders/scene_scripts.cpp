@@ -2,6 +2,7 @@
 #include "../world.hpp"
 #include "../context.hpp"
 
+#include "../baked_scene.hpp"
 #include "utils/parser.hpp"
 #include "scripting/scripting.hpp"
 
@@ -19,7 +20,8 @@ bool loaders::SceneScripts::load (million::resources::Handle handle, const std::
 {
     EASY_BLOCK("SceneScripts::load", world::COLOR(3));
     try {
-        auto config = parser::parse_toml(filename);
+        // Baked scenes keep everything except their entities in their manifest
+        auto config = std::filesystem::path(filename).extension() == baked::EXTENSION ? baked::parseManifest(filename) : parser::parse_toml(filename);
 
         if (!config.contains("event-map")) {
             spdlog::warn("[resource:scene-scripts] In '{}', missing 'event-map' field", filename);
@@ -1,33 +1,16 @@
 #include "world.hpp"
 #include "context.hpp"
 
-void mergeEntityInternal (entt::registry& source_registry, entt::registry& destination_registry, entt::entity source_entity, entt::entity destination_entity, bool overwrite_components)
-{
-    EASY_FUNCTION(profiler::colors::Yellow200);
-    for(auto [id, source_storage]: source_registry.storage()) {
-        auto it = destination_registry.storage(id);
-        if (it != destination_registry.storage().end() && source_storage.contains(source_entity)) {
-            auto& destination_storage = it->second;
-            if (! destination_storage.contains(destination_entity)) {
-                destination_storage.emplace(destination_entity, source_storage.get(source_entity));
-            } else if (overwrite_components) {
-                destination_storage.erase(destination_entity);
-                destination_storage.emplace(destination_entity, source_storage.get(source_entity));
-            }
-        }
-    }
-}
-
 entt::entity world::loadEntity (world::Context* context, entt::hashed_string prototype_id)
 {
     EASY_FUNCTION(profiler::colors::Yellow100);
-    const auto& prototype_names = context->m_registries.foreground().prototype_names;
-    auto it = prototype_names.find(prototype_id);
-    if (it != prototype_names.end()) {
-        auto& foreground = context->m_registries.foreground();
-        auto& prototypes = foreground.prototypes;
-        auto new_entity = prototypes.create();
-        mergeEntityInternal(prototypes, foreground.runtime, it->second, new_entity, true);
+    auto& foreground = context->m_registries.foreground();
+    const auto* recipe = foreground.prototypeRecipe(prototype_id);
+    if (recipe != nullptr) {
+        auto new_entity = foreground.runtime.create();
+        for (auto& [storage, value] : *recipe) {
+            storage->emplace(new_entity, value);
+        }
         return new_entity;
     } else {
         spdlog::warn("Could not create entity. Prototype does not exist: \"{}\"", prototype_id.data());
@@ -35,13 +18,82 @@ entt::entity world::loadEntity (world::Context* context, entt::hashed_string pro
     return entt::null;
 }
 
+std::uint32_t world::spawnMany (world::Context* context, entt::hashed_string prototype_id, std::uint32_t count, entt::entity* entities)
+{
+    EASY_FUNCTION(profiler::colors::Yellow100);
+    auto& foreground = context->m_registries.foreground();
+    const auto* recipe = foreground.prototypeRecipe(prototype_id);
+    if (recipe == nullptr) {
+        spdlog::warn("Could not create entities. Prototype does not exist: \"{}\"", prototype_id.data());
+        return 0;
+    }
+
+    std::vector<entt::entity> created;
+    if (entities == nullptr) {
+        created.resize(count);
+        entities = created.data();
+    }
+    foreground.runtime.create(entities, entities + count);
+
+    // Fill one storage at a time, so that each is grown at most once and written to contiguously
+    for (auto& [storage, value] : *recipe) {
+        storage->reserve(storage->size() + count);
+        for (std::uint32_t index = 0; index < count; ++index) {
+            storage->emplace(entities[index], value);
+        }
+    }
+    return count;
+}
+
 void world::mergeEntity (world::Context* context, entt::entity entity, entt::hashed_string prototype_id, bool overwrite_components)
 {
     EASY_FUNCTION(profiler::colors::Yellow100);
-    const auto& prototype_names = context->m_registries.foreground().prototype_names;
-    auto it = prototype_names.find(prototype_id);
-    if (it != prototype_names.end()) {
-        auto& foreground = context->m_registries.foreground();
-        mergeEntityInternal(foreground.prototypes, foreground.runtime, it->second, entity, overwrite_components);
+    const auto* recipe = context->m_registries.foreground().prototypeRecipe(prototype_id);
+    if (recipe != nullptr) {
+        for (auto& [storage, value] : *recipe) {
+            if (! storage->contains(entity)) {
+                storage->emplace(entity, value);
+            } else if (overwrite_components) {
+                storage->erase(entity);
+                storage->emplace(entity, value);
+            }
+        }
+    }
+}
+
+namespace {
+    class NullStream final : public million::events::Stream {
+    protected:
+        std::byte* push (entt::hashed_string::hash_type, std::uint32_t) final { return nullptr; }
+    };
+}
+
+SCENARIO("Prototype instances follow changes to their prototype") {
+    GIVEN("A prototype that has been instantiated, with a component the runtime registry has no storage for yet") {
+        NullStream stream;
+        world::Context context{stream, stream, stream};
+        auto& registries = context.m_registries.foreground();
+        const auto prototype = registries.prototypes.create();
+        registries.prototypes.emplace<core::EntityPrototypeID>(prototype, "prototype"_hs.value());
+        registries.prototypes.emplace<components::core::Transform>(prototype);
+        const auto first = world::loadEntity(&context, "prototype"_hs);
+        REQUIRE(first != entt::null);
+        CHECK_FALSE(registries.runtime.all_of<components::core::Transform>(first));
+        WHEN("The component is registered") {
+            world::prepareRegistries(&context, [](entt::registry& registry){ registry.storage<components::core::Transform>(); });
+            const auto entity = world::loadEntity(&context, "prototype"_hs);
+            THEN("New instances have it") {
+                CHECK(registries.runtime.all_of<components::core::Transform>(entity));
+            }
+        }
+        WHEN("A component is added to the prototype") {
+            registries.prototypes.emplace<components::core::Named>(prototype, entt::hashed_string{"instance"});
+            entt::entity entities[2];
+            world::spawnMany(&context, "prototype"_hs, 2, entities);
+            THEN("New instances have it") {
+                CHECK(registries.runtime.all_of<components::core::Named>(entities[0]));
+                CHECK(registries.runtime.all_of<components::core::Named>(entities[1]));
+            }
+        }
     }
 }
@@ -1,6 +1,9 @@
 #include "world.hpp"
 #include "context.hpp"
 
+#include "core/components.hpp"
+#include "memory/heaps.hpp"
+
 void Registries::copyRegistry (const entt::registry& from, entt::registry& to)
 {
     EASY_FUNCTION(profiler::colors::RichYellow);
@@ -17,26 +20,134 @@ void Registries::copyRegistry (const entt::registry& from, entt::registry& to)
     });
 }
 
-void Registries::copyGlobals ()
+void Registries::copyGlobals (entt::registry& from, entt::registry& to)
 {
     // Entity names will be automatically copied by on_construct
     EASY_FUNCTION(profiler::colors::RichYellow);
-    auto& from = background().runtime;
-    auto& to = foreground().runtime;
-    for (const auto&& [source_entity] : from.storage<components::core::Global>().each()) {
-        auto destination_entity = to.create();
-        for(auto [id, source_storage]: from.storage()) {
-            if(source_storage.contains(source_entity)) {
-                auto it = to.storage(id);
-                if (it != to.storage().end()) {
-                    it->second.emplace(destination_entity, source_storage.get(source_entity));
+    const auto& globals = from.storage<components::core::Global>();
+    if (globals.empty()) {
+        return;
+    }
+    // Global entity at index N of the Global storage becomes destinations[N]
+    std::vector<entt::entity> destinations(globals.size());
+    to.create(destinations.begin(), destinations.end());
+    for (auto [id, source_storage]: from.storage()) {
+        if (source_storage.empty()) {
+            continue;
+        }
+        auto it = to.storage(id);
+        entt::sparse_set* destination_storage = nullptr;
+        if (it != to.storage().end()) {
+            destination_storage = &it->second;
+        } else if (source_storage.type() == entt::type_id<core::EntityGroup>()) {
+            // Groups are created on demand, so the destination may not have one that a global entity is in yet
+            destination_storage = &to.storage<core::EntityGroup>(id);
+        } else {
+            continue;
+        }
+        // Walk whichever of the two is smaller, so that the many storages holding few (or no) global entities are cheap
+        if (source_storage.size() < globals.size()) {
+            for (const auto source_entity : source_storage) {
+                if (globals.contains(source_entity)) {
+                    destination_storage->emplace(destinations[globals.index(source_entity)], source_storage.get(source_entity));
+                }
+            }
+        } else {
+            for (std::size_t index = 0; index < globals.size(); ++index) {
+                const auto source_entity = globals.data()[index];
+                if (source_storage.contains(source_entity)) {
+                    destination_storage->emplace(destinations[index], source_storage.get(source_entity));
                 }
             }
         }
     }
 }
 
+void Registries::swap ()
+{
+    EASY_FUNCTION(profiler::colors::RichYellow);
+    // The pair that becomes the background must be done being cleared
+    waitForClear();
+    // Return the memory freed by the last clear to the OS. Memory is returned by the thread that allocated it, so this is done here.
+    memory::heaps::collect();
+    const auto old_foreground = m_foreground_registry;
+    m_foreground_registry = m_background_registry;
+    m_background_registry = m_retired_registry;
+    m_retired_registry = old_foreground;
+    auto& retired = m_registries[m_retired_registry];
+    copyGlobals(retired.runtime, foreground().runtime);
+    if (! m_run_async) {
+        retired.clear();
+        return;
+    }
+    // Nothing else touches the retired pair until the next swap, so it can be destroyed without holding up the main thread
+    auto clearing = std::make_shared<PendingClear>();
+    m_clearing = clearing;
+    m_run_async([clearing, &retired](){
+        if (clearing->claimed.exchange(true)) {
+            return; // Already cleared by waitForClear()
+        }
+        EASY_BLOCK("Registries clearing retired pair", profiler::colors::RichYellow);
+        try {
+            retired.clear();
+            clearing->cleared.set_value();
+        } catch (...) {
+            clearing->cleared.set_exception(std::current_exception());
+        }
+    });
+}
+
+void Registries::waitForClear ()
+{
+    if (m_clearing) {
+        EASY_BLOCK("Registries::waitForClear", profiler::colors::RichYellow);
+        auto clearing = std::move(m_clearing);
+        if (! clearing->claimed.exchange(true)) {
+            // No worker has started on it yet, and the caller may itself be the worker it is queued on, so clear it here rather than wait
+            m_registries[m_retired_registry].clear();
+        } else {
+            clearing->cleared.get_future().get();
+        }
+    }
+}
+
+Registries::~Registries ()
+{
+    waitForClear();
+}
+
 entt::registry& world::registry (world::Context* context)
 {
     return context->m_registries.foreground().runtime;
 }
+
+SCENARIO("Swapped out registries are cleared in the background") {
+    std::vector<std::function<void()>> queued;
+    Registries registries;
+    // Hold on to the background work, so that the test decides when (and if) it runs
+    registries.setRunAsync([&queued](std::function<void()> fn){ queued.push_back(std::move(fn)); });
+
+    GIVEN("a scene that was swapped out") {
+        RegistryPair& old_scene = registries.foreground();
+        const auto entity = old_scene.runtime.create();
+        registries.swap();
+        REQUIRE(queued.size() == 1);
+
+        THEN("it is only cleared once the background work runs") {
+            CHECK(old_scene.runtime.valid(entity));
+            queued.back()();
+            CHECK_FALSE(old_scene.runtime.valid(entity));
+        }
+
+        WHEN("it is needed again before the background work has run") {
+            registries.swap();
+            THEN("it was cleared by the swap, and the background work no longer touches it") {
+                CHECK(&registries.background() == &old_scene);
+                CHECK_FALSE(old_scene.runtime.valid(entity));
+                const auto loading = old_scene.runtime.create();
+                queued.front()();
+                CHECK(old_scene.runtime.valid(loading));
+            }
+        }
+    }
+}
@@ -2,19 +2,56 @@
 
 #include "registry_pair.hpp"
 
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+
+// Three registry pairs that take turns: the foreground holds the current scene, the background receives the scene being loaded, and
+// the third is the scene that was last swapped out, which is cleared on a worker thread so that swapping does not have to wait for it.
 struct Registries {
 public:
+    // Run a function on a worker thread at some later point
+    using RunAsync = std::function<void(std::function<void()>)>;
+
+    ~Registries();
+
+    // Set how the retired pair is cleared in the background (by the scheduler's executor). Until set, swap() clears it before returning.
+    void setRunAsync (RunAsync run_async) { m_run_async = std::move(run_async); }
+
     RegistryPair& foreground() { return m_registries[m_foreground_registry]; }
     const RegistryPair& foreground() const { return m_registries[m_foreground_registry]; }
-    RegistryPair& background() { return m_registries[1 - m_foreground_registry]; }
-    const RegistryPair& background() const { return m_registries[1 - m_foreground_registry]; }
-    void swap () { m_foreground_registry = 1 - m_foreground_registry; }            
+    RegistryPair& background() { return m_registries[m_background_registry]; }
+    const RegistryPair& background() const { return m_registries[m_background_registry]; }
+
+    // Make the background the foreground, carry "global" entities over from the old foreground, then clear the old foreground asynchronously
+    void swap ();
+
+    // Call a function on every registry pair, once the pair being cleared (if any) is done
+    template <typename Fn>
+    void each (Fn&& fn) {
+        waitForClear();
+        for (auto& registries : m_registries) {
+            fn(registries);
+        }
+    }
 
     // Copy all entities from one registry to another
     void copyRegistry (const entt::registry& from, entt::registry& to);
-    // Copy "global" entities from background to foreground
-    void copyGlobals ();
 private:
-    RegistryPair m_registries[2];
+    RegistryPair m_registries[3];
     std::uint32_t m_foreground_registry = 0;
-};
\ No newline at end of file
+    std::uint32_t m_background_registry = 1;
+    std::uint32_t m_retired_registry = 2;
+    // Clearing of the retired registry pair. Whichever of the worker and waitForClear() claims it first does the clearing.
+    struct PendingClear {
+        std::atomic_bool claimed{false};
+        std::promise<void> cleared;
+    };
+    std::shared_ptr<PendingClear> m_clearing;
+    RunAsync m_run_async;
+
+    // Copy "global" entities from one registry to another
+    void copyGlobals (entt::registry& from, entt::registry& to);
+    void waitForClear ();
+};
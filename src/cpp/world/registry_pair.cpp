@@ -4,42 +4,160 @@
 #include "core/components.hpp"
 
 RegistryPair::RegistryPair()
+{
+    connectSignals();
+}
+
+RegistryPair::~RegistryPair()
+{
+    runtime = {};
+    prototypes = {};
+}
+
+void RegistryPair::connectSignals ()
 {
     // Manage Named entities
     runtime.on_construct<components::core::Named>().connect<&RegistryPair::onAddNamedEntity>(this);
     runtime.on_destroy<components::core::Named>().connect<&RegistryPair::onRemoveNamedEntity>(this);
+    runtime.on_update<components::core::Named>().connect<&RegistryPair::onUpdateNamedEntity>(this);
+    prototypes.on_construct<components::core::Named>().connect<&RegistryPair::onAddNamedPrototype>(this);
+    prototypes.on_destroy<components::core::Named>().connect<&RegistryPair::onChangePrototype>(this);
+    prototypes.on_construct<components::core::Category>().connect<&RegistryPair::onChangePrototype>(this);
+    prototypes.on_destroy<components::core::Category>().connect<&RegistryPair::onChangePrototype>(this);
+    // Track runtime entity positions
+    spatial_index.connect(runtime);
     // Manage prototype entities
     prototypes.on_construct<core::EntityPrototypeID>().connect<&RegistryPair::onAddPrototypeEntity>(this);
     prototypes.on_destroy<core::EntityPrototypeID>().connect<&RegistryPair::onRemovePrototypeEntity>(this);
 }
 
-RegistryPair::~RegistryPair()
+void RegistryPair::disconnectSignals ()
 {
-    runtime = {};
-    prototypes = {};
+    runtime.on_construct<components::core::Named>().disconnect(this);
+    runtime.on_destroy<components::core::Named>().disconnect(this);
+    runtime.on_update<components::core::Named>().disconnect(this);
+    prototypes.on_construct<components::core::Named>().disconnect(this);
+    prototypes.on_destroy<components::core::Named>().disconnect(this);
+    prototypes.on_construct<components::core::Category>().disconnect(this);
+    prototypes.on_destroy<components::core::Category>().disconnect(this);
+    spatial_index.disconnect(runtime);
+    prototypes.on_construct<core::EntityPrototypeID>().disconnect(this);
+    prototypes.on_destroy<core::EntityPrototypeID>().disconnect(this);
+}
+
+void RegistryPair::internName (components::core::Named& named)
+{
+    // Named only holds a pointer to its name, which usually belongs to whatever created the component (a TOML value, a baked file, ...).
+    // Instances of prototypes, copied globals and renames to an existing name already point into the arena.
+    const char* name = named.name.data();
+    if (names.owns(name)) {
+        return;
+    }
+    const auto interned = names.intern(name != nullptr ? std::string_view{name, named.name.size()} : std::string_view{});
+    named.name = entt::hashed_string{interned.data(), interned.size()};
 }
 
 void RegistryPair::onAddNamedEntity (entt::registry& registry, entt::entity entity)
 {
     EASY_FUNCTION(profiler::colors::Green500);
-    const auto& named = registry.get<components::core::Named>(entity);
-    entity_names[named.name] = {entity, named.name.data()};
+    auto& named = registry.get<components::core::Named>(entity);
+    internName(named);
+    const NamedEntityInfo info{entity, {named.name.data(), named.name.size()}};
+    entity_names[named.name] = info;
+    const auto index = entt::to_entity(entity);
+    if (index >= entity_names_by_index.size()) {
+        entity_names_by_index.resize(index + 1, {entt::null, {}});
+    }
+    entity_names_by_index[index] = info;
 }
 
-void RegistryPair::onRemoveNamedEntity (entt::registry& registry, entt::entity entity)
+void RegistryPair::onRemoveNamedEntity (entt::registry&, entt::entity entity)
 {
     EASY_FUNCTION(profiler::colors::Green500);
-    const auto& named = registry.get<components::core::Named>(entity);
-    entity_names.erase(named.name);
+    // The component may have been changed without an update signal, so go by the name that was indexed
+    const auto index = entt::to_entity(entity);
+    if (index >= entity_names_by_index.size() || entity_names_by_index[index].entity != entity) {
+        return;
+    }
+    auto& info = entity_names_by_index[index];
+    auto it = entity_names.find(entt::hashed_string::value(info.name.data(), info.name.size()));
+    // Another entity may have taken the name since
+    if (it != entity_names.end() && it->second.entity == entity) {
+        entity_names.erase(it);
+    }
+    info = {entt::null, {}};
+}
+
+void RegistryPair::onUpdateNamedEntity (entt::registry& registry, entt::entity entity)
+{
+    onRemoveNamedEntity(registry, entity);
+    onAddNamedEntity(registry, entity);
+}
+
+void RegistryPair::onAddNamedPrototype (entt::registry& registry, entt::entity entity)
+{
+    internName(registry.get<components::core::Named>(entity));
+    prototype_recipes.clear();
+}
+
+void RegistryPair::onChangePrototype (entt::registry&, entt::entity)
+{
+    prototype_recipes.clear();
+}
+
+std::string_view RegistryPair::entityName (entt::entity entity) const
+{
+    const auto index = entt::to_entity(entity);
+    if (index < entity_names_by_index.size() && entity_names_by_index[index].entity == entity) {
+        return entity_names_by_index[index].name;
+    }
+    return {};
 }
 
 void RegistryPair::clear ()
 {
     EASY_BLOCK("RegistryPair::clear", profiler::colors::Green800);
+    // Everything the signal handlers maintain is cleared wholesale below, so don't have them update it entity by entity while the
+    // registries are emptied. The handlers only touch this pair, which is what allows Registries::swap to clear it on a worker thread.
+    disconnectSignals();
+    group_index.clear(runtime); // Disconnects the group handlers
     runtime.clear();
     prototypes.clear();
     entity_names.clear();
+    entity_names_by_index.clear();
+    names.clear();
     prototype_names.clear();
+    prototype_recipes.clear();
+    entity_sets.clear();
+    spatial_index.clear();
+    connectSignals();
+}
+
+const RegistryPair::PrototypeRecipe* RegistryPair::prototypeRecipe (entt::hashed_string::hash_type prototype_id)
+{
+    auto recipe_it = prototype_recipes.find(prototype_id);
+    if (recipe_it != prototype_recipes.end()) {
+        return &recipe_it->second;
+    }
+    auto it = prototype_names.find(prototype_id);
+    if (it == prototype_names.end()) {
+        return nullptr;
+    }
+    EASY_BLOCK("RegistryPair::prototypeRecipe", profiler::colors::Yellow500);
+    const auto prototype_entity = it->second;
+    auto& recipe = prototype_recipes[prototype_id];
+    for (auto [id, source_storage]: prototypes.storage()) {
+        if (source_storage.contains(prototype_entity)) {
+            auto storage_it = runtime.storage(id);
+            if (storage_it != runtime.storage().end()) {
+                recipe.emplace_back(&storage_it->second, source_storage.get(prototype_entity));
+            } else if (source_storage.type() == entt::type_id<core::EntityGroup>()) {
+                // Groups are created on demand, so the runtime registry may not have one that the prototype is in yet
+                recipe.emplace_back(&runtime.storage<core::EntityGroup>(id), nullptr);
+            }
+        }
+    }
+    return &recipe;
 }
 
 void RegistryPair::onAddPrototypeEntity (entt::registry& registry, entt::entity entity)
@@ -52,6 +170,7 @@ void RegistryPair::onAddPrototypeEntity (entt::registry& registry, entt::entity
         registry.destroy(it->second);
     }
     prototype_names[prototype_id.id] = entity;
+    prototype_recipes.clear();
 }
 
 void RegistryPair::onRemovePrototypeEntity (entt::registry& registry, entt::entity entity)
@@ -59,4 +178,31 @@ void RegistryPair::onRemovePrototypeEntity (entt::registry& registry, entt::enti
     EASY_FUNCTION(profiler::colors::Yellow500);
     const auto& prototype_id = registry.get<core::EntityPrototypeID>(entity);
     prototype_names.erase(prototype_id.id);
+    prototype_recipes.clear();
+}
+
+SCENARIO("Spawning a named prototype does not grow the name arena") {
+    GIVEN("A registry pair with a named prototype") {
+        RegistryPair pair;
+        const auto prototype = pair.prototypes.create();
+        pair.prototypes.emplace<components::core::Named>(prototype, entt::hashed_string{"Spawned"});
+        pair.prototypes.emplace<core::EntityPrototypeID>(prototype, "Spawned"_hs.value());
+        const auto size = pair.namesSize();
+        WHEN("The prototype is instantiated many times, and entities are given a name that was interned already") {
+            const auto* recipe = pair.prototypeRecipe("Spawned"_hs);
+            REQUIRE(recipe != nullptr);
+            for (int index = 0; index < 1000; ++index) {
+                const auto entity = pair.runtime.create();
+                for (auto& [storage, value] : *recipe) {
+                    storage->emplace(entity, value);
+                }
+                const std::string name = "Spawned";
+                pair.runtime.replace<components::core::Named>(entity, entt::hashed_string{name.c_str(), name.size()});
+            }
+            THEN("The names are stored once") {
+                CHECK(pair.runtime.storage<components::core::Named>().size() == 1000);
+                CHECK(pair.namesSize() == size);
+            }
+        }
+    }
 }
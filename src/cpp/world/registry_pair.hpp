@@ -1,6 +1,8 @@
 #pragma once
 
 #include <monkeys.hpp>
+#include "spatial_index.hpp"
+#include "group_index.hpp"
 
 struct RegistryPair {
 public:
@@ -11,21 +13,53 @@ public:
 
     struct NamedEntityInfo {
         entt::entity entity;
-        std::string name;
+        std::string_view name; // Interned in `names`
     };
 
+    // The runtime storage of each of a prototype's components, paired with the prototype's value for it
+    using PrototypeRecipe = std::vector<std::pair<entt::sparse_set*, const void*>>;
+
     RegistryPair();
     ~RegistryPair();
     entt::registry runtime;
     entt::registry prototypes;
     helpers::hashed_string_flat_map<NamedEntityInfo> entity_names;
+    std::vector<NamedEntityInfo> entity_names_by_index; // Indexed by entity index, entity is entt::null for entities without a name
     helpers::hashed_string_flat_map<entt::entity> prototype_names;
+    helpers::hashed_string_flat_map<std::vector<entt::entity>> entity_sets; // Sorted by entity id
+    SpatialIndex spatial_index; // Of the runtime registry
+    GroupIndex group_index; // Of the runtime registry
 
+    // Empty both registries and everything that indexes them. Only touches this pair, so another thread may clear a pair nothing else uses.
     void clear ();
+
+    // Get the recipe for instantiating a prototype, building it on first use. Returns nullptr if there is no such prototype.
+    const PrototypeRecipe* prototypeRecipe (entt::hashed_string::hash_type prototype_id);
+    // Discard the cached recipes. Must be called whenever prototypes' components change or storages are added, other than through the
+    // components the pair follows itself (EntityPrototypeID, Named and Category).
+    void prototypesChanged () { prototype_recipes.clear(); }
+    // Name of a runtime entity, empty if it has none
+    std::string_view entityName (entt::entity entity) const;
+    // Bytes used by the interned names of both registries
+    std::size_t namesSize () const { return names.size(); }
 private:
+    // One copy of every Named name in either registry, so that Named components never point at strings that have gone away
+    helpers::StringArena names;
+
+    // Recipes point into the prototype storages and list the storages each prototype is in, so they are discarded whenever prototypes change
+    helpers::hashed_string_flat_map<PrototypeRecipe> prototype_recipes;
+
+    // Connect or disconnect every signal handler below, and those of the spatial index
+    void connectSignals ();
+    void disconnectSignals ();
+
     // Callbacks to manage Named entities
     void onAddNamedEntity (entt::registry&, entt::entity);
     void onRemoveNamedEntity (entt::registry&, entt::entity);
+    void onUpdateNamedEntity (entt::registry&, entt::entity);
+    void onAddNamedPrototype (entt::registry&, entt::entity);
+    void onChangePrototype (entt::registry&, entt::entity);
+    void internName (components::core::Named& named);
 
     // Callbacks to manage prototype entities
     void onAddPrototypeEntity (entt::registry&, entt::entity);
@@ -34,14 +34,23 @@ void world::loadScene (world::Context* context, entt::hashed_string::hash_type s
         const auto scene_name = it->second;
         const auto filename = (context->m_path / scene_name).replace_extension("toml").string();
 
-        spdlog::info("[world] Loading scene: {}", scene_name);
-        const auto config = parser::parse_toml(filename);
+        // A baked scene takes the place of its TOML file, only its manifest has to be parsed here
+        const auto baked_filename = baked::bakedFilename(filename);
+        bool is_baked = physfs::exists(baked_filename);
+        if (is_baked && ! baked::isCurrent(baked_filename, filename)) {
+            spdlog::warn("[world] Baked scene '{}' was not baked from the current '{}', loading that instead: re-bake it with --bake-scenes", baked_filename, filename);
+            is_baked = false;
+        }
+        const auto& scene_filename = is_baked ? baked_filename : filename;
+
+        spdlog::info("[world] Loading {}scene: {}", is_baked ? "baked " : "", scene_name);
+        const auto config = is_baked ? baked::parseManifest(baked_filename) : parser::parse_toml(filename);
         PendingScene& pending = context->m_pending_scenes[scene];
         pending.auto_swap = auto_swap;
 
         // Load entities and prototypes
-        if (config.contains("entity")) {
-            auto handle = resources::load(context->m_resources_ctx, "scene-entities"_hs, filename, scene);
+        if (is_baked || config.contains("entity")) {
+            auto handle = resources::load(context->m_resources_ctx, "scene-entities"_hs, scene_filename, scene);
             pending.resources.insert(handle.handle);
         }
 
@@ -71,7 +80,7 @@ void world::loadScene (world::Context* context, entt::hashed_string::hash_type s
 
         // Load scripts
         if (config.contains("script-file") && config.contains("event-map")) {
-            auto handle = resources::load(context->m_resources_ctx, "scene-script"_hs, filename, scene);
+            auto handle = resources::load(context->m_resources_ctx, "scene-script"_hs, scene_filename, scene);
             pending.resources.insert(handle.handle);
         }
 
@@ -80,7 +89,22 @@ void world::loadScene (world::Context* context, entt::hashed_string::hash_type s
     }
 }
 
-// Swap foreground and background scenes, and clear the (new) background scene
+void world::bakeScenes (world::Context* context, const std::string& output_path)
+{
+    EASY_FUNCTION(profiler::colors::Pink100);
+    std::uint32_t failed = 0;
+    for (const auto& [scene_id, scene_name] : context->m_scenes) {
+        const auto filename = (context->m_path / scene_name).replace_extension("toml");
+        // Keep the scene's path, so that the baked file is found next to the scene when the output is mounted as game data
+        const auto output_filename = std::filesystem::path(output_path) / std::filesystem::path(baked::bakedFilename(filename.string())).relative_path();
+        if (! baked::bake(context, filename.string(), output_filename.string())) {
+            ++failed;
+        }
+    }
+    spdlog::info("[world] Baked {} of {} scenes into: {}", context->m_scenes.size() - failed, context->m_scenes.size(), output_path);
+}
+
+// Swap foreground and background scenes, and start clearing the old foreground scene
 void world::swapScenes (world::Context* context)
 {
     EASY_FUNCTION(profiler::colors::Amber800);
@@ -98,12 +122,12 @@ void world::swapScenes (world::Context* context)
     context->m_pending.scene = 0;
     context->m_pending.scripts = million::resources::Handle::invalid();
 
-    // Swap newly loaded scene into foreground
+    // Swap newly loaded scene into foreground, copying entities marked as "global" over from the old scene, which is cleared in the background
     context->m_registries.swap();
-    // Copy entities marked as "global" from background to foreground
-    context->m_registries.copyGlobals();
-    // Clear the background registry
-    context->m_registries.background().clear();
+    // Cached message targets refer to entities in the old scene
+    ++context->m_target_generation;
+    // Snapshots of the old scene cannot be restored as deltas against the new one
+    context->m_snapshot_baseline.clear();
     // Set context variables
     context->m_registries.foreground().runtime.ctx().emplace<million::api::Runtime>(context->m_context_data);
 
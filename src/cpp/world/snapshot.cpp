@@ -0,0 +1,638 @@
+#include "world.hpp"
+#include "context.hpp"
+
+#include "core/components.hpp"
+
+// Snapshots of the current scene's runtime registry, stored component-major: one column per storage, holding the entities that have the
+// component and a copy of each entity's component data. Only components that baked scenes can copy bytewise are included, Named names are
+// kept in a string table and components holding resource handles or pointers are left out: restoring leaves them as they are on entities
+// that still exist, and entities that are recreated come back without them.
+// A full snapshot lists every entity. A delta snapshot only lists what changed since the previous snapshot: created and destroyed entities,
+// added or changed component rows and removed component rows. A delta is restored by applying it to its base, which must be the last snapshot
+// taken or restored, and restoring the result as a full snapshot, so changes made to the scene since the base are undone as well.
+namespace {
+    constexpr char MAGIC[8] = {'M', 'M', 'S', 'N', 'A', 'P', '\0', '\0'};
+    constexpr std::uint32_t VERSION = 2;
+
+    enum class Kind : std::uint32_t {
+        Full,
+        Delta,
+    };
+
+    enum class ColumnKind : std::uint32_t {
+        Components, // Component data added or replaced (empty for tag components)
+        Named,      // String table offset of each entity's name
+        Group,      // Entities only, stored in a named group storage
+        Removed,    // Entities only, whose component was removed (delta only)
+    };
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        Kind kind;
+        std::uint32_t id;
+        std::uint32_t base_id;          // Snapshot a delta applies to
+        std::uint32_t num_created;      // All entities, for full snapshots
+        std::uint32_t created_offset;
+        std::uint32_t num_destroyed;
+        std::uint32_t destroyed_offset;
+        std::uint32_t num_columns;
+        std::uint32_t columns_offset;
+        std::uint32_t strings_offset;
+        std::uint32_t strings_size;
+    };
+
+    struct Column {
+        entt::id_type storage_id;
+        ColumnKind kind;
+        std::uint32_t element_size;
+        std::uint32_t count;
+        std::uint32_t entities_offset;
+        std::uint32_t data_offset;
+    };
+
+    // Read access to a snapshot blob, which is validated on construction
+    class Reader {
+    public:
+        Reader (const std::byte* data, std::size_t size) : m_data(data), m_valid(false) {
+            const auto in_bounds = [size](std::size_t offset, std::size_t bytes) { return offset <= size && bytes <= size - offset; };
+            if (size < sizeof(Header) || std::memcmp(header().magic, MAGIC, sizeof(MAGIC)) != 0 || header().version != VERSION) {
+                return;
+            }
+            const auto& head = header();
+            bool valid = in_bounds(head.created_offset, std::size_t(head.num_created) * sizeof(entt::entity))
+                && in_bounds(head.destroyed_offset, std::size_t(head.num_destroyed) * sizeof(entt::entity))
+                && in_bounds(head.columns_offset, std::size_t(head.num_columns) * sizeof(Column))
+                && in_bounds(head.strings_offset, head.strings_size)
+                && (head.strings_size == 0 || string(head.strings_size - 1)[0] == '\0');
+            for (std::uint32_t index = 0; valid && index < head.num_columns; ++index) {
+                const auto& col = column(index);
+                valid = in_bounds(col.entities_offset, std::size_t(col.count) * sizeof(entt::entity))
+                    && in_bounds(col.data_offset, std::size_t(col.count) * col.element_size)
+                    && col.data_offset % helpers::SectionWriter::Alignment == 0
+                    && (col.kind != ColumnKind::Removed || head.kind == Kind::Delta);
+                if (valid && col.kind == ColumnKind::Named) {
+                    valid = col.element_size == sizeof(std::uint32_t);
+                    for (std::uint32_t row = 0; valid && row < col.count; ++row) {
+                        valid = name(col, row) < head.strings_size;
+                    }
+                }
+            }
+            m_valid = valid;
+        }
+
+        bool valid () const { return m_valid; }
+        const Header& header () const { return *reinterpret_cast<const Header*>(m_data); }
+        const Column& column (std::uint32_t index) const { return reinterpret_cast<const Column*>(m_data + header().columns_offset)[index]; }
+        const entt::entity* created () const { return at<entt::entity>(header().created_offset); }
+        const entt::entity* destroyed () const { return at<entt::entity>(header().destroyed_offset); }
+        const entt::entity* entities (const Column& col) const { return at<entt::entity>(col.entities_offset); }
+        const std::byte* row (const Column& col, std::uint32_t index) const { return col.element_size != 0 ? at<std::byte>(col.data_offset) + std::size_t(index) * col.element_size : nullptr; }
+        // String table offset of a row of a Named column
+        std::uint32_t name (const Column& col, std::uint32_t index) const { return at<std::uint32_t>(col.data_offset)[index]; }
+        const char* string (std::uint32_t offset) const { return at<char>(header().strings_offset + offset); }
+
+    private:
+        const std::byte* m_data;
+        bool m_valid;
+
+        template <typename T> const T* at (std::uint32_t offset) const { return reinterpret_cast<const T*>(m_data + offset); }
+    };
+
+    // How a (non-empty) storage is snapshotted, the same way as baked scenes store it. Returns false if it is not.
+    bool describeStorage (world::Context* context, const entt::sparse_set& storage, ColumnKind& kind, std::uint32_t& element_size)
+    {
+        std::size_t size = 0;
+        if (storage.type() == entt::type_id<components::core::Named>()) {
+            kind = ColumnKind::Named;
+            element_size = sizeof(std::uint32_t);
+        } else if (storage.type() == entt::type_id<core::EntityGroup>()) {
+            kind = ColumnKind::Group;
+            element_size = 0;
+        } else if (storage.get(*storage.begin()) == nullptr) {
+            kind = ColumnKind::Components; // Tag component, no data
+            element_size = 0;
+        } else if (rawComponentSize(context, storage.type().hash(), size)) {
+            kind = ColumnKind::Components;
+            element_size = std::uint32_t(size);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Component rows of a snapshot being written
+    struct ColumnData {
+        Column column;
+        std::vector<entt::entity> entities;
+        std::vector<std::byte> data;
+
+        void add (entt::entity entity, const void* value) {
+            entities.push_back(entity);
+            if (column.element_size != 0) {
+                const auto* bytes = reinterpret_cast<const std::byte*>(value);
+                data.insert(data.end(), bytes, bytes + column.element_size);
+            }
+        }
+
+        // Add an entity's row of the storage the column is for, putting names in the string table
+        void add (entt::entity entity, const entt::sparse_set& storage, helpers::StringTable& strings) {
+            if (column.kind == ColumnKind::Named) {
+                const auto& name = static_cast<const components::core::Named*>(storage.get(entity))->name;
+                const auto offset = strings.add(std::string{name.data(), name.size()});
+                add(entity, &offset);
+            } else {
+                add(entity, storage.get(entity));
+            }
+        }
+    };
+
+    // Whether an entity's row of a storage is unchanged from the given row of the base snapshot
+    bool unchanged (const Reader& base, const Column& base_column, std::uint32_t row, const Column& column, const entt::sparse_set& storage, entt::entity entity)
+    {
+        if (base_column.kind != column.kind || base_column.element_size != column.element_size) {
+            return false;
+        } else if (column.kind == ColumnKind::Named) {
+            const auto& name = static_cast<const components::core::Named*>(storage.get(entity))->name;
+            return std::string_view{base.string(base.name(base_column, row))} == std::string_view{name.data(), name.size()};
+        }
+        return column.element_size == 0 || std::memcmp(base.row(base_column, row), storage.get(entity), column.element_size) == 0;
+    }
+
+    std::vector<std::byte> write (Header& head, const std::vector<entt::entity>& created, const std::vector<entt::entity>& destroyed, std::vector<ColumnData>& columns, const helpers::StringTable& strings)
+    {
+        helpers::SectionWriter writer;
+        writer.append(&head, sizeof(Header));
+        std::memcpy(head.magic, MAGIC, sizeof(MAGIC));
+        head.version = VERSION;
+        head.num_created = std::uint32_t(created.size());
+        head.created_offset = writer.append(created);
+        head.num_destroyed = std::uint32_t(destroyed.size());
+        head.destroyed_offset = writer.append(destroyed);
+        std::vector<Column> table;
+        for (auto& data : columns) {
+            data.column.count = std::uint32_t(data.entities.size());
+            data.column.entities_offset = writer.append(data.entities);
+            data.column.data_offset = writer.append(data.data);
+            table.push_back(data.column);
+        }
+        head.num_columns = std::uint32_t(table.size());
+        head.columns_offset = writer.append(table);
+        head.strings_offset = writer.append(strings.chars());
+        head.strings_size = std::uint32_t(strings.chars().size());
+        std::memcpy(writer.bytes().data(), &head, sizeof(Header));
+        return std::move(writer.bytes());
+    }
+
+    std::vector<std::byte> writeFull (world::Context* context, entt::registry& registry, std::uint32_t id)
+    {
+        std::vector<entt::entity> entities;
+        registry.each([&entities](const auto entity){
+            entities.push_back(entity);
+        });
+        helpers::StringTable strings;
+        std::vector<ColumnData> columns;
+        for (auto [storage_id, storage] : registry.storage()) {
+            ColumnData data{};
+            if (storage.empty() || ! describeStorage(context, storage, data.column.kind, data.column.element_size)) {
+                continue;
+            }
+            data.column.storage_id = storage_id;
+            data.entities.reserve(storage.size());
+            data.data.reserve(storage.size() * data.column.element_size);
+            for (const auto entity : storage) {
+                data.add(entity, storage, strings);
+            }
+            columns.push_back(std::move(data));
+        }
+        Header head{};
+        head.kind = Kind::Full;
+        head.id = id;
+        return write(head, entities, {}, columns, strings);
+    }
+
+    // Difference between the registry and a full snapshot of its previous state. The full snapshot of the current state, which the next delta
+    // is relative to, is written to `full` in the same pass over the registry.
+    std::vector<std::byte> writeDelta (world::Context* context, entt::registry& registry, const Reader& base, std::uint32_t id, std::vector<std::byte>& full)
+    {
+        const auto& base_head = base.header();
+        phmap::flat_hash_set<entt::entity> base_entities(base.created(), base.created() + base_head.num_created);
+        std::vector<entt::entity> entities;
+        std::vector<entt::entity> created;
+        registry.each([&](const auto entity){
+            entities.push_back(entity);
+            if (! base_entities.contains(entity)) {
+                created.push_back(entity);
+            }
+        });
+        std::vector<entt::entity> destroyed;
+        for (const auto entity : base_entities) {
+            if (! registry.valid(entity)) {
+                destroyed.push_back(entity);
+            }
+        }
+
+        // Index the base's rows by storage and entity
+        phmap::flat_hash_map<entt::id_type, phmap::flat_hash_map<entt::entity, std::uint32_t>> base_rows;
+        phmap::flat_hash_map<entt::id_type, const Column*> base_columns;
+        for (std::uint32_t index = 0; index < base_head.num_columns; ++index) {
+            const auto& col = base.column(index);
+            auto& rows = base_rows[col.storage_id];
+            const auto* entities = base.entities(col);
+            for (std::uint32_t row = 0; row < col.count; ++row) {
+                rows[entities[row]] = row;
+            }
+            base_columns[col.storage_id] = &col;
+        }
+
+        helpers::StringTable strings;
+        std::vector<ColumnData> columns;
+        helpers::StringTable full_strings;
+        std::vector<ColumnData> full_columns;
+        for (auto [storage_id, storage] : registry.storage()) {
+            ColumnData data{};
+            auto base_it = base_columns.find(storage_id);
+            if (storage.empty() || ! describeStorage(context, storage, data.column.kind, data.column.element_size)) {
+                if (base_it == base_columns.end()) {
+                    continue;
+                }
+                // Emptied since the base, every row is removed below
+            } else {
+                data.column.storage_id = storage_id;
+                ColumnData& whole = full_columns.emplace_back(ColumnData{data.column, {}, {}});
+                whole.entities.reserve(storage.size());
+                whole.data.reserve(storage.size() * whole.column.element_size);
+                const auto* rows = base_it != base_columns.end() ? &base_rows[storage_id] : nullptr;
+                for (const auto entity : storage) {
+                    whole.add(entity, storage, full_strings);
+                    if (rows != nullptr) {
+                        auto row_it = rows->find(entity);
+                        if (row_it != rows->end() && unchanged(base, *base_it->second, row_it->second, data.column, storage, entity)) {
+                            continue;
+                        }
+                    }
+                    data.add(entity, storage, strings);
+                }
+                if (! data.entities.empty()) {
+                    columns.push_back(std::move(data));
+                }
+            }
+            if (base_it != base_columns.end()) {
+                // Rows of entities that still exist, but no longer have the component
+                ColumnData removed{};
+                removed.column.storage_id = storage_id;
+                removed.column.kind = ColumnKind::Removed;
+                const auto* entities = base.entities(*base_it->second);
+                for (std::uint32_t row = 0; row < base_it->second->count; ++row) {
+                    if (registry.valid(entities[row]) && ! storage.contains(entities[row])) {
+                        removed.add(entities[row], nullptr);
+                    }
+                }
+                if (! removed.entities.empty()) {
+                    columns.push_back(std::move(removed));
+                }
+            }
+        }
+        Header head{};
+        head.kind = Kind::Delta;
+        head.id = id;
+        head.base_id = base_head.id;
+        Header full_head{};
+        full_head.kind = Kind::Full;
+        full_head.id = id;
+        full = write(full_head, entities, {}, full_columns, full_strings);
+        return write(head, created, destroyed, columns, strings);
+    }
+
+    // Full snapshot of the state a delta snapshot describes, from its base
+    std::vector<std::byte> applyDelta (const Reader& base, const Reader& delta)
+    {
+        const auto& base_head = base.header();
+        const auto& delta_head = delta.header();
+        const phmap::flat_hash_set<entt::entity> destroyed(delta.destroyed(), delta.destroyed() + delta_head.num_destroyed);
+        std::vector<entt::entity> entities;
+        for (std::uint32_t index = 0; index < base_head.num_created; ++index) {
+            if (! destroyed.contains(base.created()[index])) {
+                entities.push_back(base.created()[index]);
+            }
+        }
+        entities.insert(entities.end(), delta.created(), delta.created() + delta_head.num_created);
+
+        // Rows of each storage, pointing into the snapshot they come from (dropped rows have no source)
+        struct Row {
+            entt::entity entity;
+            const Reader* source;
+            const Column* column;
+            std::uint32_t index;
+        };
+        struct Rows {
+            Column column;
+            std::vector<Row> rows;
+            phmap::flat_hash_map<entt::entity, std::uint32_t> index;
+        };
+        phmap::flat_hash_map<entt::id_type, Rows> storages;
+        std::vector<entt::id_type> order;
+        const auto rows_of = [&](const Column& col) -> Rows& {
+            auto [it, inserted] = storages.try_emplace(col.storage_id);
+            if (inserted) {
+                it->second.column = col;
+                order.push_back(col.storage_id);
+            }
+            return it->second;
+        };
+        for (std::uint32_t index = 0; index < base_head.num_columns; ++index) {
+            const auto& col = base.column(index);
+            auto& rows = rows_of(col);
+            const auto* col_entities = base.entities(col);
+            for (std::uint32_t row = 0; row < col.count; ++row) {
+                if (! destroyed.contains(col_entities[row])) {
+                    rows.index[col_entities[row]] = std::uint32_t(rows.rows.size());
+                    rows.rows.push_back({col_entities[row], &base, &col, row});
+                }
+            }
+        }
+        for (std::uint32_t index = 0; index < delta_head.num_columns; ++index) {
+            const auto& col = delta.column(index);
+            auto& rows = rows_of(col);
+            if (col.kind != ColumnKind::Removed && (rows.column.kind != col.kind || rows.column.element_size != col.element_size)) {
+                // The component's layout changed since the base, so the delta has all of its rows
+                rows.column = col;
+                rows.rows.clear();
+                rows.index.clear();
+            }
+            const auto* col_entities = delta.entities(col);
+            for (std::uint32_t row = 0; row < col.count; ++row) {
+                auto it = rows.index.find(col_entities[row]);
+                if (col.kind == ColumnKind::Removed) {
+                    if (it != rows.index.end()) {
+                        rows.rows[it->second].source = nullptr;
+                        rows.index.erase(it);
+                    }
+                } else if (it != rows.index.end()) {
+                    rows.rows[it->second] = {col_entities[row], &delta, &col, row};
+                } else {
+                    rows.index[col_entities[row]] = std::uint32_t(rows.rows.size());
+                    rows.rows.push_back({col_entities[row], &delta, &col, row});
+                }
+            }
+        }
+
+        helpers::StringTable strings;
+        std::vector<ColumnData> columns;
+        for (const auto storage_id : order) {
+            const auto& rows = storages[storage_id];
+            if (rows.index.empty() || rows.column.kind == ColumnKind::Removed) {
+                continue;
+            }
+            ColumnData data{};
+            data.column.storage_id = storage_id;
+            data.column.kind = rows.column.kind;
+            data.column.element_size = rows.column.element_size;
+            for (const auto& row : rows.rows) {
+                if (row.source == nullptr) {
+                    continue;
+                } else if (data.column.kind == ColumnKind::Named) {
+                    const auto offset = strings.add(row.source->string(row.source->name(*row.column, row.index)));
+                    data.add(row.entity, &offset);
+                } else {
+                    data.add(row.entity, row.source->row(*row.column, row.index));
+                }
+            }
+            columns.push_back(std::move(data));
+        }
+        Header head{};
+        head.kind = Kind::Full;
+        head.id = delta_head.id;
+        return write(head, entities, {}, columns, strings);
+    }
+
+    void restoreColumns (world::Context* context, entt::registry& registry, const Reader& snapshot)
+    {
+        for (std::uint32_t index = 0; index < snapshot.header().num_columns; ++index) {
+            const auto& col = snapshot.column(index);
+            const auto* entities = snapshot.entities(col);
+            entt::sparse_set* storage = nullptr;
+            if (col.kind == ColumnKind::Group) {
+                storage = &registry.storage<core::EntityGroup>(col.storage_id);
+            } else {
+                auto it = registry.storage(col.storage_id);
+                if (it == registry.storage().end()) {
+                    spdlog::error("[world] Snapshot has data for a component that does not exist: {:x}", col.storage_id);
+                    continue;
+                }
+                storage = &it->second;
+                std::size_t size = 0;
+                if (col.kind == ColumnKind::Components && col.element_size != 0 && (! rawComponentSize(context, storage->type().hash(), size) || size != col.element_size)) {
+                    spdlog::error("[world] Snapshot data for component {:x} does not match the component", col.storage_id);
+                    continue;
+                }
+            }
+            // The storages have been emptied, so every row is added
+            if (col.kind == ColumnKind::Named) {
+                // Names are interned by the registry when the component is added, so they outlive the snapshot
+                for (std::uint32_t row = 0; row < col.count; ++row) {
+                    registry.emplace<components::core::Named>(entities[row], entt::hashed_string{snapshot.string(snapshot.name(col, row))});
+                }
+            } else {
+                storage->reserve(storage->size() + col.count);
+                for (std::uint32_t row = 0; row < col.count; ++row) {
+                    storage->emplace(entities[row], snapshot.row(col, row));
+                }
+            }
+        }
+    }
+}
+
+std::vector<std::byte> world::saveSnapshot (world::Context* context, bool delta)
+{
+    EASY_FUNCTION(world::COLOR(2));
+    auto& registry = context->m_registries.foreground().runtime;
+    const auto id = ++context->m_snapshot_ids;
+    std::vector<std::byte> full;
+    std::vector<std::byte> result;
+    if (delta && ! context->m_snapshot_baseline.empty()) {
+        result = writeDelta(context, registry, Reader{context->m_snapshot_baseline.data(), context->m_snapshot_baseline.size()}, id, full);
+    } else {
+        full = writeFull(context, registry, id);
+        result = full;
+    }
+    // The next delta is relative to this snapshot
+    context->m_snapshot_baseline = std::move(full);
+    return result;
+}
+
+bool world::restoreSnapshot (world::Context* context, const std::byte* data, std::size_t size)
+{
+    EASY_FUNCTION(world::COLOR(2));
+    Reader snapshot{data, size};
+    if (! snapshot.valid()) {
+        spdlog::error("[world] Could not restore snapshot: not a snapshot, or taken by a different version");
+        return false;
+    }
+    const auto& head = snapshot.header();
+    if (head.kind == Kind::Delta) {
+        // The scene may have changed since the base was taken, so the delta can't be applied to it directly
+        const auto baseline_id = context->m_snapshot_baseline.empty() ? 0 : Reader{context->m_snapshot_baseline.data(), context->m_snapshot_baseline.size()}.header().id;
+        if (head.base_id != baseline_id) {
+            spdlog::error("[world] Could not restore snapshot {}: it applies to snapshot {}, but the last snapshot is {}", head.id, head.base_id, baseline_id);
+            return false;
+        }
+        const auto full = applyDelta(Reader{context->m_snapshot_baseline.data(), context->m_snapshot_baseline.size()}, snapshot);
+        return restoreSnapshot(context, full.data(), full.size());
+    }
+
+    auto& foreground = context->m_registries.foreground();
+    auto& registry = foreground.runtime;
+    // Destroy the entities that the snapshot doesn't have and empty the storages it covers. Components that snapshots leave out stay on the
+    // entities that remain.
+    const phmap::flat_hash_set<entt::entity> kept(snapshot.created(), snapshot.created() + head.num_created);
+    std::vector<entt::entity> destroyed;
+    registry.each([&](const auto entity){
+        if (! kept.contains(entity)) {
+            destroyed.push_back(entity);
+        }
+    });
+    registry.destroy(destroyed.begin(), destroyed.end());
+    ColumnKind kind;
+    std::uint32_t element_size;
+    for (auto [storage_id, storage] : registry.storage()) {
+        if (! storage.empty() && describeStorage(context, storage, kind, element_size)) {
+            storage.clear();
+        }
+    }
+    // Entities are recreated with the same ids, so that references to them remain valid
+    std::uint32_t remapped = 0;
+    for (std::uint32_t index = 0; index < head.num_created; ++index) {
+        const auto entity = snapshot.created()[index];
+        if (! registry.valid(entity)) {
+            remapped += registry.create(entity) != entity;
+        }
+    }
+    if (remapped > 0) {
+        spdlog::warn("[world] {} entities could not be restored with their snapshot ids, references to them will be wrong", remapped);
+    }
+    restoreColumns(context, registry, snapshot);
+
+    // Entity sets are not part of snapshots, so drop members that no longer exist
+    for (auto& [name, entities] : foreground.entity_sets) {
+        entities.erase(std::remove_if(entities.begin(), entities.end(), [&registry](auto entity){ return ! registry.valid(entity); }), entities.end());
+    }
+    ++context->m_target_generation;
+
+    // The next delta is relative to the restored state
+    if (data != context->m_snapshot_baseline.data()) {
+        context->m_snapshot_baseline.assign(data, data + size);
+    }
+    return true;
+}
+
+namespace {
+    class NullStream final : public million::events::Stream {
+    protected:
+        std::byte* push (entt::hashed_string::hash_type, std::uint32_t) final { return nullptr; }
+    };
+
+    struct SnapshotFixture {
+        NullStream stream;
+        world::Context context{stream, stream, stream};
+        entt::registry& registry = context.m_registries.foreground().runtime;
+        entt::entity a;
+        entt::entity b;
+
+        SnapshotFixture () {
+            context.m_component_info[entt::type_hash<components::core::Position>::value()] = {"position", sizeof(components::core::Position), true};
+            a = registry.create();
+            b = registry.create();
+            registry.emplace<components::core::Position>(a, 1.0f, 2.0f, 3.0f);
+            registry.emplace<components::core::Position>(b, 4.0f, 5.0f, 6.0f);
+            registry.emplace<components::core::Named>(a, entt::hashed_string{"a"});
+            registry.storage<core::EntityGroup>("group"_hs).emplace(b);
+        }
+
+        std::string name (entt::entity entity) const {
+            const auto& named = registry.get<components::core::Named>(entity);
+            return {named.name.data(), named.name.size()};
+        }
+        float x (entt::entity entity) const { return registry.get<components::core::Position>(entity).x; }
+    };
+}
+
+SCENARIO("Restoring snapshots") {
+    GIVEN("A scene with a few entities") {
+        SnapshotFixture fixture;
+        auto& registry = fixture.registry;
+        const auto a = fixture.a;
+        const auto b = fixture.b;
+        WHEN("A full snapshot is restored after the scene changed") {
+            const auto full = world::saveSnapshot(&fixture.context, false);
+            registry.patch<components::core::Position>(a, [](auto& position){ position.x = 10.0f; });
+            registry.replace<components::core::Named>(a, entt::hashed_string{"renamed"});
+            registry.storage<core::EntityGroup>("group"_hs).remove(b);
+            registry.destroy(b);
+            const auto c = registry.create();
+            registry.emplace<components::core::Position>(c, 0.0f, 0.0f, 0.0f);
+            REQUIRE(world::restoreSnapshot(&fixture.context, full.data(), full.size()));
+            THEN("The scene is as it was") {
+                CHECK(registry.valid(a));
+                CHECK(registry.valid(b));
+                CHECK_FALSE(registry.valid(c));
+                CHECK(fixture.x(a) == 1.0f);
+                CHECK(fixture.x(b) == 4.0f);
+                CHECK(fixture.name(a) == "a");
+                CHECK_FALSE(registry.all_of<components::core::Named>(b));
+                CHECK(registry.storage<core::EntityGroup>("group"_hs).contains(b));
+                CHECK_FALSE(registry.storage<core::EntityGroup>("group"_hs).contains(a));
+            }
+        }
+        WHEN("A delta snapshot is restored after the scene changed again") {
+            world::saveSnapshot(&fixture.context, false);
+            registry.patch<components::core::Position>(a, [](auto& position){ position.x = 10.0f; });
+            registry.remove<components::core::Named>(a);
+            const auto c = registry.create();
+            registry.emplace<components::core::Named>(c, entt::hashed_string{"c"});
+            const auto delta = world::saveSnapshot(&fixture.context, true);
+            registry.patch<components::core::Position>(a, [](auto& position){ position.x = 20.0f; });
+            registry.patch<components::core::Position>(b, [](auto& position){ position.x = 20.0f; });
+            registry.destroy(c);
+            REQUIRE(world::restoreSnapshot(&fixture.context, delta.data(), delta.size()));
+            THEN("The scene is as it was when the delta was taken") {
+                REQUIRE(registry.valid(c));
+                CHECK(fixture.x(a) == 10.0f);
+                CHECK(fixture.x(b) == 4.0f);
+                CHECK_FALSE(registry.all_of<components::core::Named>(a));
+                CHECK(fixture.name(c) == "c");
+                CHECK(registry.storage<core::EntityGroup>("group"_hs).contains(b));
+            }
+        }
+        WHEN("A delta snapshot is restored when its base is not the last snapshot") {
+            world::saveSnapshot(&fixture.context, false);
+            registry.patch<components::core::Position>(a, [](auto& position){ position.x = 10.0f; });
+            const auto delta = world::saveSnapshot(&fixture.context, true);
+            world::saveSnapshot(&fixture.context, false);
+            registry.patch<components::core::Position>(a, [](auto& position){ position.x = 20.0f; });
+            THEN("It is rejected and the scene is left as it is") {
+                CHECK_FALSE(world::restoreSnapshot(&fixture.context, delta.data(), delta.size()));
+                CHECK(fixture.x(a) == 20.0f);
+            }
+        }
+        WHEN("A truncated or corrupt snapshot is restored") {
+            auto full = world::saveSnapshot(&fixture.context, false);
+            registry.patch<components::core::Position>(a, [](auto& position){ position.x = 10.0f; });
+            THEN("It is rejected and the scene is left as it is") {
+                CHECK_FALSE(world::restoreSnapshot(&fixture.context, full.data(), full.size() - 1));
+                CHECK_FALSE(world::restoreSnapshot(&fixture.context, full.data(), sizeof(Header) - 1));
+                auto corrupt = full;
+                reinterpret_cast<Header*>(corrupt.data())->magic[0] = 'X';
+                CHECK_FALSE(world::restoreSnapshot(&fixture.context, corrupt.data(), corrupt.size()));
+                corrupt = full;
+                reinterpret_cast<Header*>(corrupt.data())->columns_offset = std::uint32_t(corrupt.size());
+                CHECK_FALSE(world::restoreSnapshot(&fixture.context, corrupt.data(), corrupt.size()));
+                corrupt = full;
+                const auto& head = *reinterpret_cast<const Header*>(corrupt.data());
+                reinterpret_cast<Column*>(corrupt.data() + head.columns_offset)->count = std::uint32_t(corrupt.size());
+                CHECK_FALSE(world::restoreSnapshot(&fixture.context, corrupt.data(), corrupt.size()));
+                CHECK(fixture.x(a) == 10.0f);
+            }
+        }
+    }
+}
@@ -0,0 +1,330 @@
+#include "spatial_index.hpp"
+
+#include <queue>
+
+namespace {
+    // Cell coordinates are packed into 21 bits each
+    constexpr std::int32_t CELL_BIAS = 1 << 20;
+    constexpr std::int32_t CELL_MIN = -CELL_BIAS;
+    constexpr std::int32_t CELL_MAX = CELL_BIAS - 1;
+
+    inline glm::vec3 toVec3 (const components::core::Position& position)
+    {
+        return {position.x, position.y, position.z};
+    }
+
+    inline float distanceSquared (const glm::vec3& a, const glm::vec3& b)
+    {
+        const auto delta = a - b;
+        return glm::dot(delta, delta);
+    }
+}
+
+void SpatialIndex::connect (entt::registry& registry)
+{
+    registry.on_construct<components::core::Position>().connect<&SpatialIndex::onChanged>(this);
+    registry.on_update<components::core::Position>().connect<&SpatialIndex::onChanged>(this);
+    registry.on_destroy<components::core::Position>().connect<&SpatialIndex::onRemoved>(this);
+}
+
+void SpatialIndex::disconnect (entt::registry& registry)
+{
+    registry.on_construct<components::core::Position>().disconnect(this);
+    registry.on_update<components::core::Position>().disconnect(this);
+    registry.on_destroy<components::core::Position>().disconnect(this);
+}
+
+void SpatialIndex::clear ()
+{
+    m_cells.clear();
+    m_locations.clear();
+    m_changed.clear();
+    m_removed.clear();
+    m_min_cell = glm::ivec3{0};
+    m_max_cell = glm::ivec3{0};
+}
+
+void SpatialIndex::onChanged (entt::registry&, entt::entity entity)
+{
+    std::lock_guard<std::mutex> guard(m_changes_mutex);
+    m_changed.push_back(entity);
+}
+
+void SpatialIndex::onRemoved (entt::registry&, entt::entity entity)
+{
+    std::lock_guard<std::mutex> guard(m_changes_mutex);
+    m_removed.push_back(entity);
+}
+
+glm::ivec3 SpatialIndex::cellOf (const glm::vec3& position) const
+{
+    const auto cell = glm::clamp(glm::floor(position / m_cell_size), glm::vec3(float(CELL_MIN)), glm::vec3(float(CELL_MAX)));
+    return glm::ivec3(cell);
+}
+
+SpatialIndex::CellKey SpatialIndex::keyOf (const glm::ivec3& cell)
+{
+    return (CellKey(cell.x + CELL_BIAS) << 42) | (CellKey(cell.y + CELL_BIAS) << 21) | CellKey(cell.z + CELL_BIAS);
+}
+
+void SpatialIndex::place (entt::entity entity, const glm::vec3& position)
+{
+    const auto cell = cellOf(position);
+    const auto key = keyOf(cell);
+    auto it = m_locations.find(entity);
+    if (it != m_locations.end()) {
+        if (it->second.cell == key) {
+            m_cells[key][it->second.index].position = position;
+            return;
+        }
+        remove(entity);
+    }
+    if (m_locations.empty()) {
+        m_min_cell = m_max_cell = cell;
+    }
+    auto& entries = m_cells[key];
+    m_locations[entity] = {key, std::uint32_t(entries.size())};
+    entries.push_back({entity, position});
+    m_min_cell = glm::min(m_min_cell, cell);
+    m_max_cell = glm::max(m_max_cell, cell);
+}
+
+void SpatialIndex::remove (entt::entity entity)
+{
+    auto it = m_locations.find(entity);
+    if (it == m_locations.end()) {
+        return;
+    }
+    auto cell_it = m_cells.find(it->second.cell);
+    auto& entries = cell_it->second;
+    const auto index = it->second.index;
+    if (index != entries.size() - 1) {
+        entries[index] = entries.back();
+        m_locations[entries[index].entity].index = index;
+    }
+    entries.pop_back();
+    if (entries.empty()) {
+        m_cells.erase(cell_it);
+    }
+    m_locations.erase(it);
+}
+
+void SpatialIndex::update (entt::registry& registry, float cell_size, const ParallelFor& parallel_for)
+{
+    EASY_FUNCTION(profiler::colors::Green300);
+    if (cell_size <= 0.0f) {
+        cell_size = DefaultCellSize;
+    }
+    // Rebuilding visits every Position once, which beats applying a large share of the index as individual changes
+    const std::size_t changes = m_changed.size() + m_removed.size();
+    if (cell_size != m_cell_size || changes > std::max<std::size_t>(1024, m_locations.size() / 4)) {
+        m_cell_size = cell_size;
+        rebuild(registry, parallel_for);
+    } else if (changes > 0) {
+        for (const auto entity : m_removed) {
+            remove(entity);
+        }
+        const auto& positions = registry.storage<components::core::Position>();
+        for (const auto entity : m_changed) {
+            // The entity may have lost its Position (or been destroyed) after it changed
+            if (positions.contains(entity)) {
+                place(entity, toVec3(positions.get(entity)));
+            }
+        }
+    }
+    m_changed.clear();
+    m_removed.clear();
+}
+
+void SpatialIndex::rebuild (entt::registry& registry, const ParallelFor& parallel_for)
+{
+    EASY_FUNCTION(profiler::colors::Green500);
+    const auto& positions = registry.storage<components::core::Position>();
+    const auto count = std::uint32_t(positions.size());
+    const auto* entities = positions.data();
+    std::vector<Entry> entries(count);
+    std::vector<glm::ivec3> cells(count);
+    parallel_for(count, [&](std::uint32_t begin, std::uint32_t end){
+        for (auto index = begin; index < end; ++index) {
+            entries[index] = {entities[index], toVec3(positions.get(entities[index]))};
+            cells[index] = cellOf(entries[index].position);
+        }
+    });
+
+    // Keep the cells' memory, most of them will be filled again
+    for (auto& [key, cell_entries] : m_cells) {
+        cell_entries.clear();
+    }
+    m_locations.clear();
+    m_locations.reserve(count);
+    m_min_cell = glm::ivec3{CELL_MAX};
+    m_max_cell = glm::ivec3{CELL_MIN};
+    for (std::uint32_t index = 0; index < count; ++index) {
+        const auto key = keyOf(cells[index]);
+        auto& cell_entries = m_cells[key];
+        m_locations[entries[index].entity] = {key, std::uint32_t(cell_entries.size())};
+        cell_entries.push_back(entries[index]);
+        m_min_cell = glm::min(m_min_cell, cells[index]);
+        m_max_cell = glm::max(m_max_cell, cells[index]);
+    }
+    phmap::erase_if(m_cells, [](const auto& item){ return item.second.empty(); });
+}
+
+template <typename Fn>
+void SpatialIndex::forEachInCells (const glm::ivec3& min, const glm::ivec3& max, Fn&& fn) const
+{
+    const auto span = glm::i64vec3(max) - glm::i64vec3(min) + glm::i64vec3(1);
+    if (glm::any(glm::lessThanEqual(span, glm::i64vec3(0)))) {
+        return;
+    }
+    if (std::uint64_t(span.x) * std::uint64_t(span.y) * std::uint64_t(span.z) > m_cells.size()) {
+        // Fewer occupied cells than cells in range, so visit those instead
+        for (const auto& [key, entries] : m_cells) {
+            const glm::ivec3 cell{std::int32_t((key >> 42) & 0x1FFFFF) - CELL_BIAS, std::int32_t((key >> 21) & 0x1FFFFF) - CELL_BIAS, std::int32_t(key & 0x1FFFFF) - CELL_BIAS};
+            if (glm::all(glm::greaterThanEqual(cell, min)) && glm::all(glm::lessThanEqual(cell, max))) {
+                for (const auto& entry : entries) {
+                    fn(entry);
+                }
+            }
+        }
+        return;
+    }
+    for (auto x = min.x; x <= max.x; ++x) {
+        for (auto y = min.y; y <= max.y; ++y) {
+            for (auto z = min.z; z <= max.z; ++z) {
+                auto it = m_cells.find(keyOf({x, y, z}));
+                if (it != m_cells.end()) {
+                    for (const auto& entry : it->second) {
+                        fn(entry);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SpatialIndex::radius (const glm::vec3& center, float radius, std::vector<entt::entity>& entities) const
+{
+    EASY_FUNCTION(profiler::colors::Green300);
+    entities.clear();
+    const float radius_squared = radius * radius;
+    forEachInCells(cellOf(center - radius), cellOf(center + radius), [&](const Entry& entry){
+        if (distanceSquared(entry.position, center) <= radius_squared) {
+            entities.push_back(entry.entity);
+        }
+    });
+}
+
+void SpatialIndex::box (const glm::vec3& min, const glm::vec3& max, std::vector<entt::entity>& entities) const
+{
+    EASY_FUNCTION(profiler::colors::Green300);
+    entities.clear();
+    forEachInCells(cellOf(min), cellOf(max), [&](const Entry& entry){
+        if (glm::all(glm::greaterThanEqual(entry.position, min)) && glm::all(glm::lessThanEqual(entry.position, max))) {
+            entities.push_back(entry.entity);
+        }
+    });
+}
+
+void SpatialIndex::nearest (const glm::vec3& point, std::uint32_t count, std::vector<entt::entity>& entities) const
+{
+    EASY_FUNCTION(profiler::colors::Green300);
+    entities.clear();
+    if (count == 0 || m_locations.empty()) {
+        return;
+    }
+    // Search shells of cells around the point's cell, keeping the closest `count` entries found in a max heap
+    using Candidate = std::pair<float, entt::entity>;
+    std::priority_queue<Candidate> closest;
+    std::size_t visited = 0;
+    const auto visit = [&](const Entry& entry){
+        ++visited;
+        const auto distance = distanceSquared(entry.position, point);
+        if (closest.size() < count) {
+            closest.emplace(distance, entry.entity);
+        } else if (distance < closest.top().first) {
+            closest.pop();
+            closest.emplace(distance, entry.entity);
+        }
+    };
+    // Only cells within the occupied bounds can hold entries, so start at the first shell that reaches them and clip each face to them,
+    // rather than walking the empty shells between a far away point and the entities
+    const auto center = cellOf(point);
+    const auto gap = glm::max(glm::max(m_min_cell - center, center - m_max_cell), glm::ivec3{0});
+    const auto first_shell = std::max({gap.x, gap.y, gap.z});
+    const auto extent = glm::max(glm::abs(m_min_cell - center), glm::abs(m_max_cell - center));
+    const auto last_shell = std::max({extent.x, extent.y, extent.z});
+    const auto visit_cells = [&](const glm::ivec3& min, const glm::ivec3& max){
+        forEachInCells(glm::max(min, m_min_cell), glm::min(max, m_max_cell), visit);
+    };
+    for (std::int32_t shell = first_shell; shell <= last_shell; ++shell) {
+        // Everything in the shells still to come is at least this far away: the point can be anywhere in its own cell, so only the shells
+        // between it and the next shell count towards the distance
+        const float bound = float(std::max(shell - 1, 0)) * m_cell_size;
+        if ((closest.size() == count && closest.top().first <= bound * bound) || visited == m_locations.size()) {
+            break;
+        }
+        const auto shell_min = center - shell;
+        const auto shell_max = center + shell;
+        if (shell == 0) {
+            visit_cells(center, center);
+            continue;
+        }
+        // The two faces perpendicular to x, then y without those, then z without either
+        visit_cells({shell_min.x, shell_min.y, shell_min.z}, {shell_min.x, shell_max.y, shell_max.z});
+        visit_cells({shell_max.x, shell_min.y, shell_min.z}, {shell_max.x, shell_max.y, shell_max.z});
+        visit_cells({shell_min.x + 1, shell_min.y, shell_min.z}, {shell_max.x - 1, shell_min.y, shell_max.z});
+        visit_cells({shell_min.x + 1, shell_max.y, shell_min.z}, {shell_max.x - 1, shell_max.y, shell_max.z});
+        visit_cells({shell_min.x + 1, shell_min.y + 1, shell_min.z}, {shell_max.x - 1, shell_max.y - 1, shell_min.z});
+        visit_cells({shell_min.x + 1, shell_min.y + 1, shell_max.z}, {shell_max.x - 1, shell_max.y - 1, shell_max.z});
+    }
+    entities.resize(closest.size());
+    for (auto index = entities.size(); index > 0; --index) {
+        entities[index - 1] = closest.top().second;
+        closest.pop();
+    }
+}
+
+SCENARIO("Nearest entities across a cell boundary") {
+    GIVEN("A spatial index with 16 unit cells") {
+        entt::registry registry;
+        SpatialIndex index;
+        index.connect(registry);
+        const auto serial = [](std::uint32_t count, const auto& fn){ fn(0, count); };
+        const auto a = registry.create();
+        const auto b = registry.create();
+        registry.emplace<components::core::Position>(a, 0.1f, 0.0f, 0.0f);
+        registry.emplace<components::core::Position>(b, 16.1f, 0.0f, 0.0f);
+        index.update(registry, 16.0f, serial);
+        WHEN("Querying near the edge of a cell whose own entity is further away than the neighbouring cell's") {
+            std::vector<entt::entity> entities;
+            index.nearest({15.9f, 0.0f, 0.0f}, 1, entities);
+            THEN("The entity in the neighbouring cell is found") {
+                REQUIRE(entities.size() == 1);
+                CHECK(entities[0] == b);
+            }
+        }
+        WHEN("Querying for more entities than there are") {
+            std::vector<entt::entity> entities;
+            index.nearest({15.9f, 0.0f, 0.0f}, 3, entities);
+            THEN("All of them are found, closest first") {
+                REQUIRE(entities.size() == 2);
+                CHECK(entities[0] == b);
+                CHECK(entities[1] == a);
+            }
+        }
+        WHEN("Querying from far outside the occupied cells") {
+            std::vector<entt::entity> entities;
+            index.nearest({1.0e6f, 0.0f, 0.0f}, 1, entities);
+            std::vector<entt::entity> opposite;
+            index.nearest({-1.0e6f, -1.0e6f, 0.0f}, 2, opposite);
+            THEN("The closest entities are still found") {
+                REQUIRE(entities.size() == 1);
+                CHECK(entities[0] == b);
+                REQUIRE(opposite.size() == 2);
+                CHECK(opposite[0] == a);
+                CHECK(opposite[1] == b);
+            }
+        }
+    }
+}
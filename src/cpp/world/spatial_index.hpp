@@ -0,0 +1,73 @@
+#pragma once
+
+#include <monkeys.hpp>
+
+#include <functional>
+#include <mutex>
+
+// Uniform grid over the Position of a registry's entities, to find entities near a point without scanning every Position.
+// Changes are recorded from Position signals (emplace, patch, replace, remove and destroy) and applied by update(), once per frame after the
+// update systems, so queries see positions as of the end of the previous frame. Positions written directly through a view or get() send no
+// signal: systems that move entities should patch (or replace) their Position for the index to see it.
+// Position may be written by the systems of any stage that runs before the index is updated (GameLogic, Update, Actions and AIExecute, which
+// run concurrently with each other) and by entity commands. Recording a change is thread safe, the registry itself is not: systems running
+// concurrently may patch the Position of different entities, but only one of them at a time may emplace or remove Position.
+// If a large part of the index changed, update() rebuilds it from scratch instead, computing cells in parallel.
+class SpatialIndex {
+public:
+    // Call fn over [0, count) split into ranges, possibly from multiple threads, returning once all calls are done
+    using ParallelFor = std::function<void(std::uint32_t count, const std::function<void(std::uint32_t begin, std::uint32_t end)>& fn)>;
+
+    static constexpr float DefaultCellSize = 16.0f;
+
+    // Start tracking the Position components of a registry
+    void connect (entt::registry& registry);
+    // Stop tracking them
+    void disconnect (entt::registry& registry);
+    void clear ();
+
+    // Apply the changes recorded since the last update. Nothing may write Position while it runs.
+    void update (entt::registry& registry, float cell_size, const ParallelFor& parallel_for);
+
+    // Replace `entities` with the entities within `radius` of `center`
+    void radius (const glm::vec3& center, float radius, std::vector<entt::entity>& entities) const;
+    // Replace `entities` with the entities inside the box between `min` and `max`, inclusive
+    void box (const glm::vec3& min, const glm::vec3& max, std::vector<entt::entity>& entities) const;
+    // Replace `entities` with the (up to) `count` entities closest to `point`, closest first
+    void nearest (const glm::vec3& point, std::uint32_t count, std::vector<entt::entity>& entities) const;
+
+    std::size_t size () const { return m_locations.size(); }
+
+private:
+    using CellKey = std::uint64_t;
+    struct Entry {
+        entt::entity entity;
+        glm::vec3 position;
+    };
+    struct Location {
+        CellKey cell;
+        std::uint32_t index;
+    };
+
+    float m_cell_size = DefaultCellSize;
+    phmap::flat_hash_map<CellKey, std::vector<Entry>> m_cells;
+    phmap::flat_hash_map<entt::entity, Location> m_locations;
+    glm::ivec3 m_min_cell{0};
+    glm::ivec3 m_max_cell{0}; // Bounds of the cells occupied since the index was last empty or rebuilt, to know when nearest() has searched everything
+    std::mutex m_changes_mutex; // Signals may come from systems in any stage that runs concurrently with others
+    std::vector<entt::entity> m_changed;
+    std::vector<entt::entity> m_removed;
+
+    void onChanged (entt::registry&, entt::entity entity);
+    void onRemoved (entt::registry&, entt::entity entity);
+
+    glm::ivec3 cellOf (const glm::vec3& position) const;
+    static CellKey keyOf (const glm::ivec3& cell);
+
+    void place (entt::entity entity, const glm::vec3& position);
+    void remove (entt::entity entity);
+    void rebuild (entt::registry& registry, const ParallelFor& parallel_for);
+
+    // Call fn for each entry in the cells between min and max, inclusive
+    template <typename Fn> void forEachInCells (const glm::ivec3& min, const glm::ivec3& max, Fn&& fn) const;
+};
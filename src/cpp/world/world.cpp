@@ -5,8 +5,69 @@
 #include "events/events.hpp"
 #include "messages/messages.hpp"
 
+#include "loaders/scene_entities.hpp"
+
+#include <limits>
+
+// A resource needed by a pending scene is ready, completing the scene if it was the last one
+void resourceReady (world::Context* context, entt::hashed_string::hash_type scene, million::resources::Handle handle)
+{
+    auto it = context->m_pending_scenes.find(scene);
+    if (it == context->m_pending_scenes.end()) {
+        return;
+    }
+    PendingScene& pending = it->second;
+    pending.resources.erase(handle.handle);
+    if (pending.resources.empty()) {
+        SPDLOG_DEBUG("[world] Scene fully loaded");
+        // Scene fully loaded
+        context->m_pending.scene = scene;
+        context->m_world_stream.emit<events::world::SceneLoaded>([scene](auto& loaded){
+            loaded.id = scene;
+        });
+        if (pending.auto_swap) {
+            world::swapScenes(context);
+        }
+        context->m_pending_scenes.erase(it);
+    } else {
+        SPDLOG_DEBUG("[world] Waiting for scene to load: {} resources pending", pending.resources.size());
+    }
+}
+
+// Create the entities of parsed scenes, up to the configured number of entities per frame
+void instantiateScenes (world::Context* context)
+{
+    const std::uint32_t& entities_per_frame = entt::monostate<"scenes/entities-per-frame"_hs>();
+    std::uint32_t budget = entities_per_frame > 0 ? entities_per_frame : std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::pair<entt::hashed_string::hash_type, million::resources::Handle>> finished;
+    for (auto& [scene, pending] : context->m_pending_scenes) {
+        auto& instantiations = pending.instantiations;
+        while (! instantiations.empty() && budget > 0) {
+            EASY_BLOCK("SceneManager instantiating scene entities", profiler::colors::Amber500);
+            auto& instantiation = instantiations.back();
+            budget -= loaders::SceneEntities::instantiate(context, instantiation, budget);
+            context->m_world_stream.emit<events::world::SceneLoadProgress>([scene=scene, &instantiation](auto& progress){
+                progress.id = scene;
+                progress.loaded = loaders::SceneEntities::entitiesLoaded(instantiation);
+                progress.total = instantiation.entities;
+            });
+            if (instantiation.next == instantiation.total) {
+                finished.emplace_back(scene, instantiation.handle);
+                instantiations.pop_back();
+            }
+        }
+    }
+    for (const auto& [scene, handle] : finished) {
+        resourceReady(context, scene, handle);
+    }
+}
+
 void world::update (world::Context* context)
 {
+    // Group, entity set and composite target caches are only valid for a single frame
+    ++context->m_target_generation;
+    // Entity sets are not told when their members are destroyed, so drop them before this frame's targets are resolved
+    purgeEntitySets(context);
     if (! context->m_pending_scenes.empty()) {
         auto iter = events::events(context->m_events_ctx, "resources"_hs);
         if (iter.size() > 0) {
@@ -20,24 +81,18 @@ void world::update (world::Context* context)
                         if (it != context->m_pending_scenes.end()) {
                             EASY_BLOCK("SceneManager handling loaded event", profiler::colors::Amber500);
                             PendingScene& pending = it->second;
-                            pending.resources.erase(loaded.handle.handle);
                             if (loaded.type == "scene-script"_hs) {
                                 context->m_pending.scripts = loaded.handle;
                             }
-                            if (pending.resources.empty()) {
-                                SPDLOG_DEBUG("[world] Scene fully loaded");
-                                // Scene fully loaded
-                                context->m_pending.scene = loaded.name;
-                                context->m_world_stream.emit<events::world::SceneLoaded>([&loaded](auto& scene){
-                                    scene.id = loaded.name;
-                                });
-                                if (pending.auto_swap) {
-                                    world::swapScenes(context);
+                            if (loaded.type == loaders::SceneEntities::Name) {
+                                // Only parsed so far, the resource is ready once all of its entities have been created
+                                SceneInstantiation instantiation;
+                                if (loaders::SceneEntities::prepare(context, loaded.handle, instantiation)) {
+                                    pending.instantiations.push_back(std::move(instantiation));
+                                    break;
                                 }
-                                context->m_pending_scenes.erase(it);
-                            } else {
-                                SPDLOG_DEBUG("[world] Waiting for scene to load: {} resources pending", pending.resources.size());
                             }
+                            resourceReady(context, loaded.name, loaded.handle);
                         }
                         break;
                     }
@@ -46,6 +101,7 @@ void world::update (world::Context* context)
                 };
             }
         }
+        instantiateScenes(context);
     }
 }
 
@@ -1,25 +1,50 @@
 #pragma once
 
 #include <monkeys.hpp>
+#include "spatial_index.hpp"
 
 namespace world {
     Context* init (events::Context* events_ctx, messages::Context* messages_ctx, resources::Context* resources_ctx, scripting::Context* scripting_ctx, modules::Context* modules_ctx);
     void term (Context* context);
 
     void setContextData (Context* context, million::api::EngineRuntime* runtime);
+    // Set how background work, such as clearing a swapped out scene, is run on a worker thread
+    void setRunAsync (Context* context, std::function<void(std::function<void()>)> run_async);
     void prepareRegistries (Context* context, million::api::definitions::PrepareFn prepareFn);
     void installComponent (Context* context, const million::api::definitions::Component& component, million::api::definitions::PrepareFn prepareFn);
     void setEntityCategories (Context* context, const std::vector<entt::hashed_string::hash_type>& entity_categories);
     void registerHandler (Context* context, entt::hashed_string scene, entt::hashed_string::hash_type events, million::SceneHandler handler);
 
     entt::entity loadEntity (Context* context, entt::hashed_string prototype_id);
+    std::uint32_t spawnMany (Context* context, entt::hashed_string prototype_id, std::uint32_t count, entt::entity* entities);
     void mergeEntity (Context* context, entt::entity entity, entt::hashed_string prototype_id, bool overwrite_components);
     entt::entity findEntity (Context* context, entt::hashed_string name);
-    const std::string& findEntityName (Context* context, const components::core::Named& named);
-    const std::string& findEntityName (Context* context, entt::entity entity);
+    std::string_view findEntityName (Context* context, const components::core::Named& named);
+    std::string_view findEntityName (Context* context, entt::entity entity);
     bool isInGroup (Context* context, entt::entity entity, entt::hashed_string::hash_type group_name);
     std::uint16_t categoryBitflag (Context* context, entt::hashed_string::hash_type category_name);
 
+    void setInEntitySet (Context* context, entt::hashed_string::hash_type set_name, entt::entity entity, bool in_set);
+    const std::vector<entt::entity>& entitySet (Context* context, entt::hashed_string::hash_type set_name);
+    // Returns the composite's id, or uint32_t(-1) if an operand is an entity or a composite that does not exist
+    std::uint32_t defineComposite (Context* context, million::events::CompositeOp op, million::events::Target lhs, million::events::Target rhs);
+    const std::vector<entt::entity>& entityComposite (Context* context, std::uint32_t composite_id);
+
+    // Apply this frame's Position changes to the current scene's spatial index. parallel_for may be used to spread a rebuild over threads.
+    void updateSpatialIndex (Context* context, const SpatialIndex::ParallelFor& parallel_for);
+    void entitiesInRadius (Context* context, const glm::vec3& center, float radius, std::vector<entt::entity>& entities);
+    void entitiesInBox (Context* context, const glm::vec3& min, const glm::vec3& max, std::vector<entt::entity>& entities);
+    void nearestEntities (Context* context, const glm::vec3& point, std::uint32_t count, std::vector<entt::entity>& entities);
+
+    // The calling thread's entity command buffer
+    million::EntityCommands& entityCommands (Context* context);
+    // Set the position in the command application order of the commands that the calling thread records from now on
+    void setCommandOrder (std::uint32_t order);
+    // Order of threads that are not running a system or an ordered engine task. Their commands are rejected.
+    constexpr std::uint32_t UNORDERED_COMMANDS = ~std::uint32_t(0);
+    // Apply every thread's recorded entity commands to the current scene. Must not be called while any thread may be recording.
+    void applyEntityCommands (Context* context);
+
     void update (Context* context);
     void swapScenes (Context* context);
     void processEvents (Context* context);
@@ -27,6 +52,15 @@ namespace world {
 
     void loadSceneList (Context* context, const std::string& path);
     void loadScene (Context* context, entt::hashed_string::hash_type scene, bool auto_swap);
+    // Convert every scene in the scene list into a baked scene, written under `output_path` on the real filesystem
+    void bakeScenes (Context* context, const std::string& output_path);
 
     entt::registry& registry (Context* context);
+
+    // Serialize the current scene's entities and components. A delta snapshot only holds the changes since the previous snapshot taken or
+    // restored in the current scene, a full snapshot is saved instead if there is none.
+    std::vector<std::byte> saveSnapshot (Context* context, bool delta);
+    // Restore a snapshot into the current scene. Returns false if the snapshot is invalid, or is a delta whose base is not the last snapshot
+    // taken or restored. Changes made to the scene since that snapshot are undone as well.
+    bool restoreSnapshot (Context* context, const std::byte* data, std::size_t size);
 }
@@ -9,6 +9,7 @@ ffi.cdef[[
 
     struct Event_NameOnly {};
     struct Event_IDOnly {uint32_t id;};
+    struct Event_Progress {uint32_t id; uint32_t loaded; uint32_t total;};
 ]]
 local C = ffi.C
 
@@ -89,6 +90,7 @@ obj:register_events({
     {name="engine/exit", type="Event_NameOnly"},
     {name="scene/loaded", type="Event_IDOnly"},
     {name="scene/activated", type="Event_IDOnly"},
+    {name="scene/load-progress", type="Event_Progress"},
 })
 
 return obj
\ No newline at end of file
@@ -5,16 +5,23 @@ ffi.cdef [[
     uint32_t null_entity_value ();
     uint32_t entity_create (void*);
     uint32_t entity_create_from_prototype (void*, const char*);
+    uint32_t entity_spawn_many (void*, const char*, uint32_t, uint32_t*);
+    uint32_t spatial_query_radius (void*, float, float, float, float, uint32_t*, uint32_t);
+    uint32_t spatial_query_box (void*, float, float, float, float, float, float, uint32_t*, uint32_t);
+    uint32_t spatial_query_nearest (void*, float, float, float, uint32_t, uint32_t*);
     void entity_destroy (void*, uint32_t);
     uint32_t entity_lookup_by_name (void*, const char*);
     bool entity_has_component (void*, uint32_t, const char*);
     void entity_set_group (void*, uint32_t, const char*, bool);
+    void entity_set_update (void*, uint32_t, const char*, bool);
+    uint32_t define_composite (void*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
     void* component_get_for_entity (void*, uint32_t, const char*);
     void* component_add_to_entity (void*, uint32_t, const char*);
     void component_tag_entity (void*, uint32_t, const char*);
     void component_remove_from_entity (void*, uint32_t, const char*);
     void output_log (void*, uint32_t, const char*);
-    void* allocate_message (void*, const char*, uint32_t, uint16_t, uint16_t);
+    void* allocate_message (void*, const char*, uint32_t, uint32_t, uint32_t);
+    void set_message_coalescing (void*, const char*);
     void* allocate_command (void*, const char*, uint8_t);
     void* allocate_event (void*, const char*, uint8_t);
     uint32_t load_resource (void*, const char*, const char*, const char*);
@@ -24,6 +31,20 @@ ffi.cdef [[
 local C = ffi.C
 
 local NULL_ENTITY = C.null_entity_value()
+local INVALID_COMPOSITE = 0xffffffff -- Returned by define_composite if an operand is invalid
+
+local TARGET_TYPES = {
+    ENTITY = 0,
+    GROUP = 1,
+    ENTITY_SET = 2,
+    COMPOSITE = 3,
+}
+
+local COMPOSITE_OPS = {
+    union = 0,
+    intersection = 1,
+    difference = 2,
+}
 
 local LOG_LEVELS = {
     CRITICAL = 0,
@@ -87,16 +108,23 @@ local function get_or_set_in_group(self, group_name, in_group)
     end
 end
 
+local function set_in_entity_set(self, set_name, in_set)
+    C.entity_set_update(MM_CONTEXT, self.id, set_name, in_set ~= false)
+end
+
 local function post_message(target, message_name, categories)
     local message_info = core.types_by_name[message_name]
     if message_info then
         if target == nil then
             C.output_log(MM_CONTEXT, LOG_LEVELS.WARNING, 'Message "'..message_name..'" sent without target')
         else
-            local flags = 0 -- 0bTTFxxxxxCCCCCCCCCCCCCCCC T = Target (0=entity, 1=group), F = Filtered (0=no category, 1=cateogry), C = Category bit flags
+            local flags = 0 -- 0bTTFxxxxxCCCCCCCCCCCCCCCC T = Target (0=entity, 1=group, 2=entity set, 3=composite), F = Filtered (0=no category, 1=cateogry), C = Category bit flags
             if type(target) == 'string' then
                 flags = 0x400000           -- target = group
                 target = C.get_ref(target) -- convert string to int hash
+            elseif type(target) == 'table' then
+                flags = bit.lshift(target.type, 22) -- target = group, entity set or composite (see mm.target)
+                target = target.id
             end
             if categories ~= nil then
                 flags = bit.bor(flags, 0x200000) -- filtered by category = true
@@ -111,24 +139,20 @@ local function post_message(target, message_name, categories)
     end
 end
 
-local function post_message_to_composite(target, message_name, categories)
-    local message_info = core.types_by_name[message_name]
-    if message_info then
-        if target == nil then
-            C.output_log(MM_CONTEXT, LOG_LEVELS.WARNING, 'Message "'..message_name..'" sent without target')
-        else
-            local flags = 0 -- 0bTTFxxxxxCCCCCCCCCCCCCCCC T = Target (0=entity, 1=group), F = Filtered (0=no category, 1=cateogry), C = Category bit flags
-            if categories ~= nil then
-                flags = bit.bor(flags, 0x4000) -- filtered by category = true
-                for i, category in ipairs(categories) do
-                    flags = bit.bor(flags, C.get_category(MM_CONTEXT, category)) -- add category to lower 14 bits
-                end
-            end
-            return ffi.cast(message_info.type, C.allocate_message(MM_CONTEXT, message_name, target, flags, message_info.size))
-        end
-    else
-        C.output_log(MM_CONTEXT, LOG_LEVELS.WARNING, 'Message "'..message_name..'" not found')
+local function define_composite(op, lhs, rhs)
+    local op_id = COMPOSITE_OPS[op]
+    if op_id == nil then
+        C.output_log(MM_CONTEXT, LOG_LEVELS.WARNING, 'Invalid composite operation "'..tostring(op)..'"')
+        return nil
+    end
+    local id = C.define_composite(MM_CONTEXT, op_id, lhs.type, lhs.id, rhs.type, rhs.id)
+    if id == INVALID_COMPOSITE then
+        return nil -- The engine has logged which operand is invalid
     end
+    return {
+        type = TARGET_TYPES.COMPOSITE,
+        id = id,
+    }
 end
 
 local function emit_command(command_name)
@@ -158,6 +182,7 @@ local function get_entity_by_id(self, entity_id)
             add = add_component,
             tag = add_tag_component,
             group = get_or_set_in_group,
+            set = set_in_entity_set,
             post = function(entity, message_name) return post_message(entity.id, message_name) end,
             remove = remove_component,
             destroy = destroy_entity
@@ -183,6 +208,42 @@ local function create_entity(self, prototype)
     return get_entity_by_id(self, id)
 end
 
+-- Returns a zero-indexed array of the new entity IDs and the number of entities created
+local function spawn_entities(self, prototype, count)
+    local ids = ffi.new('uint32_t[?]', count)
+    local created = C.entity_spawn_many(MM_CONTEXT, prototype, count, ids)
+    return ids, created
+end
+
+-- Spatial queries return a zero-indexed array of entity IDs and the number of entities found, using positions as of the end of the previous frame
+local SPATIAL_QUERY_SIZE = 64
+
+local function entities_near(self, x, y, z, radius)
+    local ids = ffi.new('uint32_t[?]', SPATIAL_QUERY_SIZE)
+    local found = C.spatial_query_radius(MM_CONTEXT, x, y, z, radius, ids, SPATIAL_QUERY_SIZE)
+    if found > SPATIAL_QUERY_SIZE then
+        ids = ffi.new('uint32_t[?]', found)
+        found = C.spatial_query_radius(MM_CONTEXT, x, y, z, radius, ids, found)
+    end
+    return ids, found
+end
+
+local function entities_within(self, min_x, min_y, min_z, max_x, max_y, max_z)
+    local ids = ffi.new('uint32_t[?]', SPATIAL_QUERY_SIZE)
+    local found = C.spatial_query_box(MM_CONTEXT, min_x, min_y, min_z, max_x, max_y, max_z, ids, SPATIAL_QUERY_SIZE)
+    if found > SPATIAL_QUERY_SIZE then
+        ids = ffi.new('uint32_t[?]', found)
+        found = C.spatial_query_box(MM_CONTEXT, min_x, min_y, min_z, max_x, max_y, max_z, ids, found)
+    end
+    return ids, found
+end
+
+local function nearest_entities(self, x, y, z, count)
+    local ids = ffi.new('uint32_t[?]', count)
+    local found = C.spatial_query_nearest(MM_CONTEXT, x, y, z, count, ids)
+    return ids, found
+end
+
 return {
     -- Set by engine whenever game state changes
     game_state = '',
@@ -201,6 +262,14 @@ return {
         find = get_entity_by_name,
         -- Create a new entity
         create = create_entity,
+        -- Create many entities from a prototype at once
+        spawn = spawn_entities,
+        -- Find entities within a radius of a point
+        near = entities_near,
+        -- Find entities inside an axis aligned box, given its min and max corners
+        within = entities_within,
+        -- Find the closest entities to a point, closest first
+        nearest = nearest_entities,
         -- Check if an ID is valid
         valid  = function(id) return id ~= NULL_ENTITY end
     },
@@ -217,8 +286,19 @@ return {
     },
     -- Convert a string into a hashed integer reference
     ref = function(string) C.get_ref(string) end,
+    -- Message targets that address many entities at once, for use with post
+    target = {
+        -- All entities in a group
+        group = function(name) return {type = TARGET_TYPES.GROUP, id = C.get_ref(name)} end,
+        -- All entities in an entity set (see entity:set)
+        set = function(name) return {type = TARGET_TYPES.ENTITY_SET, id = C.get_ref(name)} end,
+        -- Combine two targets with 'union', 'intersection' or 'difference'. Membership is computed by the engine, once per frame
+        composite = define_composite,
+    },
     -- Communicate through messages, commands and events
     post=post_message,
+    -- Declare a message type as last-writer-wins: only the last one posted to each target is delivered
+    coalesce = function(message_name) C.set_message_coalescing(MM_CONTEXT, message_name) end,
 
     command=emit_command,
     emit=emit_event,
@@ -7,6 +7,10 @@ struct MessageEnvelope {
     uint32_t target;
     uint32_t metadata;
 };
+struct MessageBlob {
+    uint32_t offset;
+    uint32_t size;
+};
 struct BehaviorIterator* setup_scripted_behavior_iterator (void*);
 uint32_t get_next_scripted_behavior (void*, struct BehaviorIterator*, const struct Component_Core_ScriptedBehavior**);
 bool is_in_group (void*, uint32_t, uint32_t);
@@ -14,6 +18,7 @@ uint32_t get_group (void*, uint32_t, const uint32_t**);
 uint32_t get_entity_set (void*, uint32_t, const uint32_t**);
 uint32_t get_entity_composite (void*, uint32_t, const uint32_t**);
 uint32_t get_messages (void*, const char**);
+const char* get_message_blobs (void*);
 ]]
 local C = ffi.C
 local core = require('mm_core')
@@ -44,7 +49,7 @@ local function gather_entities ()
     end
 end
 
-local function handle_message (message_type, entity_info, ptr)
+local function handle_message (message_type, entity_info, payload)
     -- Get the entities message map and the handler for this message, if any
     local message_map = entity_info.message_map
     local handler = message_map[message_type]
@@ -54,7 +59,7 @@ local function handle_message (message_type, entity_info, ptr)
         local ctype = core.types_by_id[message_type]
         -- If the message type is registered, then extract the message data and call the handler
         if ctype then
-            local msg = ffi.cast(ctype, ptr + ffi.sizeof("struct MessageEnvelope"))
+            local msg = ffi.cast(ctype, payload)
             handler(entity, msg, mm)
         else
             -- Message not registered, assume its a body-less signal
@@ -63,26 +68,33 @@ local function handle_message (message_type, entity_info, ptr)
     end
 end
 
-local function process_messages (entities, message_buffer, buffer_size)
+local function process_messages (entities, message_buffer, buffer_size, message_blobs)
     local entity_ids = ffi.new('const uint32_t*[1]')
     local ptr = 0
+    local payload = 0
     local index = 0
     while index < buffer_size do
         ptr = message_buffer + index
         -- Get envelope for next message
         local envelope = ffi.cast("struct MessageEnvelope*", ptr)
-        -- MessageEnvelope.metadata: 0bTTFxxxxxCCCCCCCCCCCCCCCCSSSSSSSS
-        -- T = 2bits flag, Mask: 0xd0000000, Target type. 00 => target entity, 01 => target group, 10 => target entity set, 11 => target composite
+        -- MessageEnvelope.metadata: 0bTTFExxxxCCCCCCCCCCCCCCCCSSSSSSSS
+        -- T = 2bits flag, Mask: 0xc0000000, Target type. 00 => target entity, 01 => target group, 10 => target entity set, 11 => target composite
         -- F = 1bit flag, Mask: 0x20000000, Filter. 0 => not filtered by category, 1 => filtered by category (only target entities with specified category will receive message)
+        -- E = 1bit flag, Mask: 0x10000000, Extended payload. 0 => payload is inline, 1 => inline payload is a MessageBlob referencing the payload in the blob arena
         -- x = reserved
         -- C = 16bit bitfield, Mask: 0x00ffff00, Category bitfield, each bit represents one of 14 total possible categories. 0 => Category not filtered by, 1 => category filtered by
-        -- S = 8bit number, Mask: 0x000000ff, Size of payload in bytes
+        -- S = 8bit number, Mask: 0x000000ff, Size of inline payload in bytes
 
         local size =  bit.band(envelope.metadata, 0x000000ff)
         index = index + size + ffi.sizeof("struct MessageEnvelope")
+        payload = ptr + ffi.sizeof("struct MessageEnvelope")
+        if bit.band(envelope.metadata, 0x10000000) ~= 0 then
+            -- Payload too large to store inline, so it lives in the blob arena
+            payload = message_blobs + ffi.cast("struct MessageBlob*", payload).offset
+        end
 
         -- Check target flag, 1 = group, 0 = entity
-        local target_type = bit.rshift(bit.band(envelope.metadata, 0xd0000000), 30)
+        local target_type = bit.rshift(bit.band(envelope.metadata, 0xc0000000), 30)
         local is_filtered = bit.band(envelope.metadata, 0x20000000)
         local categories = bit.rshift(bit.band(envelope.metadata, 0x00ffff00), 8)
         if target_type == 0 then
@@ -91,7 +103,7 @@ local function process_messages (entities, message_buffer, buffer_size)
             local entity_info = entities[envelope.target]
             -- If the message is not filtered or the entity has one of the required categories
             if entity_info and (is_filtered == 0 or (entity_info.entity:has('category') and bit.band(entity_info.entity.category.id, categories) ~= 0)) then
-                handle_message(envelope.type, entity_info, ptr)
+                handle_message(envelope.type, entity_info, payload)
             end
         else
             -- Group target or Entity Set target
@@ -107,13 +119,15 @@ local function process_messages (entities, message_buffer, buffer_size)
                 num_entities = C.get_entity_composite(MM_CONTEXT, envelope.target, entity_ids)
             end
             local entity_id_ptr = entity_ids[0]
-            if is_filtered == 0 then
+            if num_entities == 0 then
+                -- Empty audience, nothing to deliver
+            elseif is_filtered == 0 then
                 -- Every entity that is in the group
                 repeat
                     num_entities = num_entities - 1
                     local entity_info = entities[entity_id_ptr[num_entities]]
                     if entity_info then
-                        handle_message(envelope.type, entity_info, ptr)
+                        handle_message(envelope.type, entity_info, payload)
                     end
                 until num_entities == 0
             else
@@ -122,7 +136,7 @@ local function process_messages (entities, message_buffer, buffer_size)
                     num_entities = num_entities - 1
                     local entity_info = entities[entity_id_ptr[num_entities]]
                     if entity_info and entity_info.entity:has('category') and bit.band(entity_info.entity.category.id, categories) ~= 0 then
-                        handle_message(envelope.type, entity_info, ptr)
+                        handle_message(envelope.type, entity_info, payload)
                     end
                 until num_entities == 0
             end
@@ -144,7 +158,7 @@ return function ()
             break
         end
         -- Process current buffer of messages
-        process_messages(entity_message_maps, message_buffer[0], buffer_size)
+        process_messages(entity_message_maps, message_buffer[0], buffer_size, C.get_message_blobs(MM_CONTEXT))
         -- Increment iteration count and stop if MAX_ITERATIONS has been reached
         iteration = iteration + 1
     until iteration >= max_iterations